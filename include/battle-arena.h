@@ -2,6 +2,8 @@
 #define BATTLE_ARENA_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <ncurses.h>
 
@@ -12,10 +14,26 @@
 #define BATTLE_HEIGHT 20
 #define BATTLE_WIDTH 80
 
+// Window dimensions
+#define GAME_WIDTH 100
+#define GAME_HEIGHT 40
+
+// Color pairs
+#define COLOR_TITLE 1
+#define COLOR_MENU 2
+#define COLOR_SELECTED 3
+#define COLOR_HP_GOOD 4
+#define COLOR_HP_MID 5
+#define COLOR_HP_LOW 6
+#define COLOR_BATTLE_INFO 7
+#define COLOR_ARMY1 8
+#define COLOR_ARMY2 9
+
 #define NUMBER_OF_ITEMS 16
 #define MAX_NAME 100
 #define MIN_ARMY 1
 #define MAX_ARMY 5
+#define UNIT_HP 100
 
 #define ERR_UNIT_COUNT "ERR_UNIT_COUNT"
 #define ERR_ITEM_COUNT "ERR_ITEM_COUNT"
@@ -31,6 +49,10 @@
 
 #define ERR_MEMORY "ERR_MEMORY"
 
+#define ERR_SOCKET "ERR_SOCKET"
+#define ERR_DB_LOCKED "ERR_DB_LOCKED"
+#define ERR_DB_FULL "ERR_DB_FULL"
+
 typedef struct item {
     char name[MAX_NAME + 1];
     unsigned int att;
@@ -73,6 +95,8 @@ typedef struct {
 
 extern ITEM_LIST item_list;
 
+void parse_items(FILE *json, ITEM_LIST *list);
+
 void load_items(FILE *json);
 
 ITEM* find(const char* name);
@@ -129,4 +153,499 @@ void apply_damage(ARMY *target_army, int position, int damage);
 void attack(ARMY *attacking_army, ARMY *defending_army);
 void shift_positions(ARMY *army1, ARMY *army2);
 int battle_round(ARMY *army1, ARMY *army2);
+int simulate_battle(ARMY *army1, ARMY *army2, int *rounds);
+
+typedef enum {
+    COMBAT_HIT,
+    COMBAT_ATTACK_END,
+    COMBAT_DEATH,
+    COMBAT_ROUND_END,
+} COMBAT_EVENT_TYPE;
+
+typedef struct {
+    COMBAT_EVENT_TYPE type;
+    int round;
+    int side;
+    int attacker;
+    const ITEM *item;
+    int defender;
+    int damage;
+    int hp;
+    int result;
+} COMBAT_EVENT;
+
+typedef enum {
+    STEP_ATTACK_1,
+    STEP_ATTACK_2,
+    STEP_CHECK_1,
+    STEP_CHECK_2,
+    STEP_ROUND_END,
+    STEP_DONE,
+} STEP_PHASE;
+
+typedef struct {
+    int attacker;
+    int item;
+    int defender;
+} HIT_CURSOR;
+
+typedef struct {
+    ARMY *army1;
+    ARMY *army2;
+    int round;
+    STEP_PHASE phase;
+    HIT_CURSOR cursor;
+} BATTLE_STEP;
+
+void battle_step_init(BATTLE_STEP *step, ARMY *army1, ARMY *army2);
+bool battle_step(BATTLE_STEP *step, COMBAT_EVENT *event);
+int export_events(const char *roster_path, const char *output_path);
+
+
+#define WIRE_NO_ITEM 0xFF
+#define WIRE_UNIT_SIZE 4
+#define WIRE_ARMY_MAX (1 + MAX_ARMY * WIRE_UNIT_SIZE)
+
+#define REQ_RESOLVE 1
+#define REQ_TOURNAMENT 2
+#define REQ_STATS 3
+
+#define RESP_OK 0
+#define RESP_BAD_REQUEST 1
+
+void wire_put_u16(uint8_t *p, uint16_t v);
+void wire_put_u32(uint8_t *p, uint32_t v);
+uint16_t wire_get_u16(const uint8_t *p);
+uint32_t wire_get_u32(const uint8_t *p);
+
+size_t encode_army(const ARMY *army, uint8_t *buf);
+int decode_army(const uint8_t *buf, size_t len, ARMY *army);
+
+int run_server(const char *socket_path, int workers, int queue_limit, double latency_target);
+
+
+#define CITEM_NONE 0xFF
+#define SCRATCH_UNITS 64
+
+typedef struct {
+    int att;
+    int def;
+    int range;
+    int radius;
+    int slots;
+} CITEM;
+
+typedef struct duel_table DUEL_TABLE;
+
+typedef struct {
+    CITEM items[NUMBER_OF_ITEMS];
+    int count;
+    int max_range;
+    int max_radius;
+    const DUEL_TABLE *duels;
+} CCATALOG;
+
+extern CCATALOG combat_catalog;
+
+
+#define ARENA_DEFAULT_BLOCK (64 * 1024)
+
+typedef struct arena_block ARENA_BLOCK;
+
+typedef struct {
+    size_t allocations;
+    size_t resets;
+    size_t blocks;
+    size_t reserved;
+    size_t peak;
+    size_t reused;
+    size_t carved;
+} ALLOC_STATS;
+
+typedef struct {
+    ARENA_BLOCK *first;
+    ARENA_BLOCK *current;
+    size_t block_size;
+    size_t in_use;
+    ALLOC_STATS stats;
+} ARENA;
+
+typedef struct {
+    ARENA *arena;
+    size_t block_size;
+    void *free_list;
+    ALLOC_STATS stats;
+} BLOCK_POOL;
+
+void arena_init(ARENA *arena, size_t block_size);
+void *arena_alloc(ARENA *arena, size_t size);
+void arena_reset(ARENA *arena);
+void arena_free(ARENA *arena);
+void pool_init(BLOCK_POOL *pool, ARENA *arena, size_t block_size);
+void *pool_get(BLOCK_POOL *pool);
+void pool_put(BLOCK_POOL *pool, void *block);
+void alloc_stats_add(ALLOC_STATS *total, const ARENA *arena, const BLOCK_POOL *pool);
+void print_alloc_stats(const ALLOC_STATS *stats, FILE *out);
+
+
+typedef struct {
+    uint8_t item1;
+    uint8_t item2;
+    int16_t hp;
+    uint16_t name;
+} CUNIT;
+
+typedef struct {
+    uint16_t count;
+    CUNIT units[];
+} CARMY;
+
+typedef struct {
+    int winner;
+    int rounds;
+    int survivors1;
+    int survivors2;
+    int hp1;
+    int hp2;
+} CRESULT;
+
+#define RESULT_TIMEOUT 3
+
+typedef struct {
+    int max_rounds;
+    bool decide_early;
+} BATTLE_LIMITS;
+
+uint16_t intern_name(const char *name);
+const char *interned_name(uint16_t id);
+size_t intern_memory(int *count);
+
+void compile_catalog(const ITEM_LIST *list, CCATALOG *catalog);
+size_t carmy_size(int count);
+CARMY *carmy_new(int count);
+void compact_army(const ARMY *army, CARMY *out);
+bool expand_army(const CARMY *army, ARMY *out);
+uint64_t mix64(uint64_t x);
+uint64_t carmy_hash(const CARMY *army, uint64_t seed);
+
+void cattack(const CUNIT *attackers, int attack_count, CUNIT *defenders, int defend_count, const CCATALOG *catalog);
+int ccheck_front(CUNIT *units, int count, int window);
+int cbattle_round(CUNIT **army1, int *count1, CUNIT **army2, int *count2, const CCATALOG *catalog);
+void fill_result(CRESULT *result, int winner, int rounds, const CUNIT *a, int count1, const CUNIT *b, int count2);
+CUNIT *copy_armies(const CARMY *army1, const CARMY *army2, CUNIT *scratch, ARENA *arena);
+int csimulate(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result, ARENA *arena);
+typedef void (*ROUND_OBSERVER)(void *context, int round, int winner, const CUNIT *a, int count1, const CUNIT *b,
+                               int count2);
+int csimulate_observed(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result,
+                       ARENA *arena, const BATTLE_LIMITS *limits, ROUND_OBSERVER observer, void *context);
+int decide_outcome(const CUNIT *a, int count1, const CUNIT *b, int count2, const CCATALOG *catalog, int budget);
+const DUEL_TABLE *duel_table_get(const CCATALOG *catalog);
+int duel_finish(const DUEL_TABLE *table, CUNIT *a, CUNIT *b, int *rounds, int max_rounds);
+int duel_outcome(const DUEL_TABLE *table, const CUNIT *a, const CUNIT *b, int budget);
+void report_army_memory(int armies, FILE *out);
+
+
+typedef struct {
+    CARMY **armies;
+    int count;
+    int capacity;
+    ARENA arena;
+} ROSTER;
+
+void load_roster(FILE *file, ROSTER *roster);
+void free_roster(ROSTER *roster);
+uint64_t roster_hash(const ROSTER *roster);
+
+#define IMPORT_MAX_ARMIES 2
+#define IMPORT_MAX_ERRORS 16
+#define IMPORT_ERROR_TEXT 160
+
+typedef struct {
+    ARMY armies[IMPORT_MAX_ARMIES];
+    int count;
+    int error_count;
+    char errors[IMPORT_MAX_ERRORS][IMPORT_ERROR_TEXT];
+} ARMY_IMPORT;
+
+bool import_armies(FILE *file, ARMY_IMPORT *import);
+
+
+typedef struct {
+    CUNIT units[2][MAX_ARMY];
+    uint8_t count[2];
+} PREDICT_STATE;
+
+typedef struct {
+    CUNIT army[2][MAX_ARMY];
+    int count[2];
+    PREDICT_STATE *states;
+    int state_count;
+    int capacity;
+    CRESULT result;
+    bool valid;
+    int replayed;
+    double elapsed;
+} PREDICTOR;
+
+void predictor_init(PREDICTOR *p);
+void predictor_free(PREDICTOR *p);
+void predictor_set_army(PREDICTOR *p, int side, const ARMY *army);
+void predictor_set_unit(PREDICTOR *p, int side, int index, const UNIT *unit);
+void predictor_truncate(PREDICTOR *p, int side, int count);
+
+
+typedef struct engine_pool ENGINE_POOL;
+
+ENGINE_POOL *engine_pool_new(int threads, const CCATALOG *catalog);
+void engine_pool_free(ENGINE_POOL *pool);
+int cparallel_round(ENGINE_POOL *pool, CUNIT **army1, int *count1, CUNIT **army2, int *count2,
+                    const CCATALOG *catalog, int min_hits);
+int csimulate_parallel(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result,
+                       ENGINE_POOL *pool);
+int run_mass_battle(const char *roster_path, int threads);
+
+
+typedef struct {
+    int references;
+    int misses;
+    int error;
+} CACHE_COUNTERS;
+
+typedef struct {
+    uint64_t references;
+    uint64_t misses;
+    int error;
+} CACHE_STATS;
+
+bool cache_counters_open(CACHE_COUNTERS *counters);
+void cache_counters_close(CACHE_COUNTERS *counters, CACHE_STATS *total);
+void print_cache_stats(const CACHE_STATS *stats, uint64_t battles, FILE *out);
+
+void trace_open(const char *path);
+void trace_close(void);
+void trace_thread_name(const char *name);
+uint64_t trace_begin(void);
+void trace_end(const char *name, uint64_t start);
+
+
+#define OUTCOME_DB_DEFAULT_SLOTS (1u << 22)
+
+typedef struct outcome_db OUTCOME_DB;
+
+uint64_t catalog_version(const ITEM_LIST *list);
+OUTCOME_DB *outcome_db_open(const char *path, uint64_t version, uint64_t capacity, bool writable);
+bool outcome_db_lookup(OUTCOME_DB *db, const CARMY *a, const CARMY *b, CRESULT *result);
+void outcome_db_store(OUTCOME_DB *db, const CARMY *a, const CARMY *b, const CRESULT *result);
+bool lookup_outcome(OUTCOME_DB *db, const BATTLE_LIMITS *limits, const CARMY *a, const CARMY *b, CRESULT *result);
+void store_outcome(OUTCOME_DB *db, const BATTLE_LIMITS *limits, const CARMY *a, const CARMY *b,
+                   const CRESULT *result);
+void outcome_db_report(OUTCOME_DB *db, FILE *out);
+void outcome_db_close(OUTCOME_DB *db);
+
+
+typedef enum {
+    RESULT_CSV,
+    RESULT_COLUMNAR,
+} RESULT_FORMAT;
+
+typedef struct result_writer RESULT_WRITER;
+
+RESULT_WRITER *result_writer_open(const char *path, RESULT_FORMAT format, int armies);
+void result_writer_add(RESULT_WRITER *writer, uint64_t matchup, const CRESULT *result);
+void result_writer_close(RESULT_WRITER *writer);
+typedef struct result_reader RESULT_READER;
+
+RESULT_READER *result_reader_open(const char *path);
+int result_reader_armies(const RESULT_READER *reader);
+bool result_reader_next(RESULT_READER *reader, uint64_t *matchup, int *a, int *b, CRESULT *result);
+void result_reader_close(RESULT_READER *reader);
+RESULT_WRITER *result_writer_resume(const char *path, RESULT_FORMAT format, int armies, uint64_t offset,
+                                    uint64_t rows);
+uint64_t result_writer_sync(RESULT_WRITER *writer, uint64_t *rows);
+uint64_t dump_results(const char *path, FILE *out);
+uint64_t merge_results(const char *const *inputs, int count, const char *output_path, RESULT_FORMAT format);
+
+
+typedef struct {
+    uint64_t roster_hash;
+    uint64_t catalog_version;
+    uint64_t first;
+    uint64_t total;
+    uint64_t chunks;
+    uint64_t output_offset;
+    uint64_t output_rows;
+    int armies;
+    uint32_t (*score)[3];
+    uint8_t *done;
+} CHECKPOINT;
+
+size_t checkpoint_bitmap_size(uint64_t chunks);
+bool checkpoint_save(const char *path, const CHECKPOINT *cp);
+bool checkpoint_load(const char *path, CHECKPOINT *cp);
+void checkpoint_free(CHECKPOINT *cp);
+
+
+#define RENDER_PAIRS 16
+#define RENDER_PAIR_MASK 0xFF
+#define RENDER_BOLD 0x100
+#define RENDER_HLINE 0x2500
+#define RENDER_VLINE 0x2502
+#define RENDER_ULCORNER 0x250C
+#define RENDER_URCORNER 0x2510
+#define RENDER_LLCORNER 0x2514
+#define RENDER_LRCORNER 0x2518
+
+typedef struct render RENDER;
+
+struct render {
+    void (*clear_screen)(RENDER *r);
+    void (*draw_border)(RENDER *r);
+    void (*draw_text)(RENDER *r, int y, int x, const char *text);
+    void (*draw_glyph)(RENDER *r, int y, int x, uint32_t glyph);
+    void (*present)(RENDER *r);
+    void (*pause)(RENDER *r, unsigned int usec);
+    int (*wait_key)(RENDER *r);
+    int attr;
+};
+
+typedef struct {
+    uint32_t ch;
+    uint16_t attr;
+} RENDER_CELL;
+
+typedef struct render_buffer RENDER_BUFFER;
+
+struct render_buffer {
+    RENDER base;
+    int rows;
+    int cols;
+    RENDER_CELL *cells;
+    double clock;
+    double key_delay;
+    uint64_t frames;
+    void (*on_present)(RENDER_BUFFER *buffer, void *context);
+    void *context;
+};
+
+extern const short render_palette[RENDER_PAIRS][2];
+
+RENDER *render_curses(void);
+RENDER *render_use(RENDER *r);
+void render_clear(void);
+void render_border(void);
+void render_attron(int attr);
+void render_attroff(int attr);
+void render_printw(int y, int x, const char *format, ...);
+void render_glyph(int y, int x, uint32_t glyph);
+void render_present(void);
+void render_pause(unsigned int usec);
+int render_wait_key(void);
+void render_buffer_init(RENDER_BUFFER *buffer, int rows, int cols);
+void render_buffer_free(RENDER_BUFFER *buffer);
+void battle_loop(ARMY *army1, ARMY *army2);
+int export_cast(const char *roster_path, const char *output_path);
+
+
+#define DASHBOARD_TILES 64
+
+typedef struct dashboard DASHBOARD;
+
+void init_gui();
+void cleanup_gui();
+void draw_hp_gauge(int y, int x, int hp, int width);
+DASHBOARD *dashboard_new(int tiles, int threads, uint64_t total);
+void dashboard_free(DASHBOARD *dash);
+void *dashboard_claim(DASHBOARD *dash, int worker, int *cursor, int a, int b);
+void dashboard_observe(void *context, int round, int winner, const CUNIT *a, int count1, const CUNIT *b, int count2);
+void dashboard_progress(DASHBOARD *dash, uint64_t battles);
+void dashboard_watch(DASHBOARD *dash);
+
+
+typedef struct {
+    const char *roster_path;
+    const char *output_path;
+    RESULT_FORMAT format;
+    const char *db_path;
+    uint64_t db_slots;
+    int threads;
+    bool watch;
+    int shard;
+    int shards;
+    const char *checkpoint_path;
+    double checkpoint_interval;
+    bool resume;
+    int tile;
+    BATTLE_LIMITS limits;
+} TOURNAMENT_CONFIG;
+
+uint64_t matchup_count(int n);
+void matchup_pair(uint64_t id, int n, int *a, int *b);
+uint64_t matchup_id(int a, int b, int n);
+void record_score(uint32_t (*score)[3], int a, int b, int winner);
+double now_seconds(void);
+void print_standings(const ROSTER *roster, uint32_t (*score)[3], FILE *out);
+int run_tournament(const TOURNAMENT_CONFIG *config);
+
+
+typedef struct {
+    const char *roster_path;
+    const char *matchups_path;
+    const char *output_path;
+    RESULT_FORMAT format;
+    const char *db_path;
+    uint64_t db_slots;
+    int threads;
+    BATTLE_LIMITS limits;
+} BATCH_CONFIG;
+
+int run_batch(const BATCH_CONFIG *config);
+
+
+int run_sensitivity(const char *roster_path, const char *const *specs, int count, int threads);
+
+int run_compare(const char *roster_path, const char *const *paths, int count, int threads);
+
+
+typedef struct {
+    const char *roster_path;
+    const char *output_path;
+    RESULT_FORMAT format;
+    uint64_t battles;
+    double target_rd;
+    int threads;
+    BATTLE_LIMITS limits;
+} LADDER_CONFIG;
+
+int run_ladder(const LADDER_CONFIG *config);
+
+
+typedef struct {
+    const char *pool_path;
+    const char *output_path;
+    int units;
+    int generations;
+    int population;
+    int islands;
+    uint64_t seed;
+    int threads;
+} EVOLVE_CONFIG;
+
+int run_evolve(const EVOLVE_CONFIG *config);
+
+
+typedef struct {
+    const char *roster_path;
+    const char *engine;
+    uint64_t scenarios;
+    uint64_t seed;
+    int max_rounds;
+    int threads;
+} VERIFY_CONFIG;
+
+uint64_t unit_checksum(int item1, int item2, int hp, int from_back);
+uint64_t army_checksum(const CUNIT *units, int count);
+uint64_t army_checksum_update(uint64_t sum, const CUNIT *front, int front_count, int count_before,
+                              const CUNIT *units, int count);
+uint64_t round_checksum(uint64_t army1, uint64_t army2);
+int run_verify(const VERIFY_CONFIG *config);
 #endif
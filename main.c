@@ -19,20 +19,8 @@
 
 #define JSON_PATH "./json/items.json"
 
-// Window dimensions
-#define GAME_WIDTH 100
-#define GAME_HEIGHT 40
-
-// Color pairs
-#define COLOR_TITLE 1
-#define COLOR_MENU 2
-#define COLOR_SELECTED 3
-#define COLOR_HP_GOOD 4
-#define COLOR_HP_MID 5
-#define COLOR_HP_LOW 6
-#define COLOR_BATTLE_INFO 7
-#define COLOR_ARMY1 8
-#define COLOR_ARMY2 9
+// Prediction shown on the builder screens while an army is being created
+static PREDICTOR *prediction = NULL;
 
 /**
  * Initializes the ncurses GUI with color pairs and displays a welcome screen
@@ -51,15 +39,9 @@ void init_gui() {
     start_color();
 
     // Define color pairs
-    init_pair(COLOR_TITLE, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(COLOR_MENU, COLOR_WHITE, COLOR_BLUE);
-    init_pair(COLOR_SELECTED, COLOR_BLACK, COLOR_CYAN);
-    init_pair(COLOR_HP_GOOD, COLOR_GREEN, COLOR_BLACK);
-    init_pair(COLOR_HP_MID, COLOR_YELLOW, COLOR_BLACK);
-    init_pair(COLOR_HP_LOW, COLOR_RED, COLOR_BLACK);
-    init_pair(COLOR_BATTLE_INFO, COLOR_CYAN, COLOR_BLACK);
-    init_pair(COLOR_ARMY1, COLOR_BLUE, COLOR_BLACK);
-    init_pair(COLOR_ARMY2, COLOR_RED, COLOR_BLACK);
+    for (int pair = COLOR_TITLE; pair <= COLOR_ARMY2; pair++) {
+        init_pair(pair, render_palette[pair][0], render_palette[pair][1]);
+    }
 
     // Display a welcome message
     clear();
@@ -87,20 +69,55 @@ void cleanup_gui() {
  * @param width Width of the box
  */
 void draw_fancy_box(int y, int x, int height, int width) {
-    mvaddch(y, x, ACS_ULCORNER);
-    mvaddch(y, x + width - 1, ACS_URCORNER);
-    mvaddch(y + height - 1, x, ACS_LLCORNER);
-    mvaddch(y + height - 1, x + width - 1, ACS_LRCORNER);
+    render_glyph(y, x, RENDER_ULCORNER);
+    render_glyph(y, x + width - 1, RENDER_URCORNER);
+    render_glyph(y + height - 1, x, RENDER_LLCORNER);
+    render_glyph(y + height - 1, x + width - 1, RENDER_LRCORNER);
 
     for (int i = 1; i < width - 1; i++) {
-        mvaddch(y, x + i, ACS_HLINE);
-        mvaddch(y + height - 1, x + i, ACS_HLINE);
+        render_glyph(y, x + i, RENDER_HLINE);
+        render_glyph(y + height - 1, x + i, RENDER_HLINE);
     }
 
     for (int i = 1; i < height - 1; i++) {
-        mvaddch(y + i, x, ACS_VLINE);
-        mvaddch(y + i, x + width - 1, ACS_VLINE);
+        render_glyph(y + i, x, RENDER_VLINE);
+        render_glyph(y + i, x + width - 1, RENDER_VLINE);
+    }
+}
+
+/**
+ * Draws the predicted outcome of the battle between the army being built and
+ * the other army, if an army is being built
+ */
+void draw_prediction() {
+    if (!prediction) return;
+
+    const int y = GAME_HEIGHT - 9;
+    draw_fancy_box(y, 4, 7, 70);
+    attron(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+    mvprintw(y, 7, " PREDICTED OUTCOME ");
+    attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+
+    if (!prediction->valid) {
+        mvprintw(y + 2, 7, "Both armies need at least one unit for a prediction.");
+        return;
+    }
+
+    const CRESULT *r = &prediction->result;
+    attron(COLOR_PAIR(r->winner == 1 ? COLOR_ARMY1 : r->winner == 2 ? COLOR_ARMY2 : COLOR_TITLE) | A_BOLD);
+    if (r->winner == 0) {
+        mvprintw(y + 2, 7, "Draw after %d rounds", r->rounds);
+    } else {
+        mvprintw(y + 2, 7, "Army %d wins after %d rounds", r->winner, r->rounds);
     }
+    attroff(COLOR_PAIR(r->winner == 1 ? COLOR_ARMY1 : r->winner == 2 ? COLOR_ARMY2 : COLOR_TITLE) | A_BOLD);
+
+    mvprintw(y + 3, 7, "Survivors: army 1 %d (%d HP), army 2 %d (%d HP)",
+             r->survivors1, r->hp1, r->survivors2, r->hp2);
+    attron(COLOR_PAIR(COLOR_BATTLE_INFO));
+    mvprintw(y + 4, 7, "Updated in %.0f us, re-simulated %d of %d rounds",
+             prediction->elapsed * 1e6, prediction->replayed, r->rounds);
+    attroff(COLOR_PAIR(COLOR_BATTLE_INFO));
 }
 
 /**
@@ -133,6 +150,7 @@ int select_item(bool is_second) {
     }
 
     mvprintw(8 + item_list.count, 7, "Enter item number (or 0 to cancel): ");
+    draw_prediction();
     refresh();
 
     char input[8];
@@ -164,23 +182,25 @@ int select_item(bool is_second) {
 /**
  * Gets a string input from the user with a specified prompt
  *
+ * @param title Title of the screen
  * @param prompt Text to display as the input prompt
  * @param buffer Buffer to store the input string
  * @param maxlen Maximum length of the input string
  */
-void get_string_input(const char *prompt, char *buffer, int maxlen) {
+void get_string_input(const char *title, const char *prompt, char *buffer, int maxlen) {
     clear();
     box(stdscr, 0, 0);
 
     // Draw title box
     draw_fancy_box(1, 4, 3, 70);
     attron(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
-    mvprintw(2, 7, "CREATE UNIT");
+    mvprintw(2, 7, "%s", title);
     attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
 
     // Draw input box
     draw_fancy_box(5, 4, 5, 70);
     mvprintw(7, 7, "%s", prompt);
+    draw_prediction();
 
     echo();
     curs_set(1);
@@ -194,15 +214,24 @@ void get_string_input(const char *prompt, char *buffer, int maxlen) {
 /**
  * Creates an army by prompting the user to input unit details
  * Units can have up to 2 items which must not exceed slot limits
+ * The predicted outcome against the other army is updated after every item
+ * choice and shown on the builder screens
  *
  * @param army Pointer to the ARMY structure to populate
  * @param army_num Army number (1 or 2) for display purposes
+ * @param opponent The other army, or NULL if it has not been created
  */
-void create_army(ARMY *army, int army_num) {
+void create_army(ARMY *army, int army_num, const ARMY *opponent) {
     army->top = -1;
     int unit_count = 0;
     char name[32];
 
+    const int side = army_num - 1;
+    PREDICTOR predictor;
+    predictor_init(&predictor);
+    predictor_set_army(&predictor, 1 - side, opponent);
+    prediction = &predictor;
+
     while (unit_count < 5) {
         clear();
         box(stdscr, 0, 0);
@@ -213,17 +242,22 @@ void create_army(ARMY *army, int army_num) {
         mvprintw(2, 7, "CREATE ARMY %d - %d/5 UNITS", army_num, unit_count);
         attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
 
-        get_string_input("Enter unit name (or leave empty to finish):", name, sizeof(name));
+        get_string_input("CREATE UNIT", "Enter unit name (or leave empty to finish):", name, sizeof(name));
         if (name[0] == '\0') break;
 
         UNIT unit;
         strncpy(unit.name, name, sizeof(unit.name));
+        unit.hp = UNIT_HP;
 
         // Keep asking for valid item combinations until slots check passes
         bool valid_items = false;
         while (!valid_items) {
             int item1_idx = select_item(false);
             unit.item1 = &item_list.items[item1_idx];
+            unit.item2 = NULL;
+            if (check_slots(unit)) {
+                predictor_set_unit(&predictor, side, unit_count, &unit);
+            }
 
             int item2_idx = select_item(true);
             if (item2_idx == -1) {
@@ -235,7 +269,9 @@ void create_army(ARMY *army, int army_num) {
             // Check if the selected items exceed slot limit
             if (check_slots(unit)) {
                 valid_items = true;
+                predictor_set_unit(&predictor, side, unit_count, &unit);
             } else {
+                predictor_truncate(&predictor, side, unit_count);
                 // Display error message
                 clear();
                 box(stdscr, 0, 0);
@@ -248,7 +284,6 @@ void create_army(ARMY *army, int army_num) {
             }
         }
 
-        unit.hp = 100;
         push(army, unit);
         unit_count++;
 
@@ -259,14 +294,101 @@ void create_army(ARMY *army, int army_num) {
         attron(COLOR_PAIR(COLOR_HP_GOOD));
         mvprintw(10, 25, "UNIT '%s' ADDED TO ARMY %d!", name, army_num);
         attroff(COLOR_PAIR(COLOR_HP_GOOD));
+        draw_prediction();
         refresh();
         usleep(800000); // Show confirmation for 0.8 seconds
     }
+
+    prediction = NULL;
+    predictor_free(&predictor);
+}
+
+/**
+ * Reads armies from a file for the interactive game. All problems in the
+ * file are collected in one pass and reported together.
+ *
+ * @param path Path of the army file (roster format, up to two armies)
+ * @param import Destination
+ * @return true if the file was read and is valid
+ */
+bool load_army_file(const char *path, ARMY_IMPORT *import) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        memset(import, 0, sizeof(*import));
+        snprintf(import->errors[0], IMPORT_ERROR_TEXT, "cannot open %s (%s)", path, ERR_FILE);
+        import->error_count = 1;
+        return false;
+    }
+    const bool valid = import_armies(file, import);
+    fclose(file);
+    return valid;
+}
+
+/**
+ * Asks for an army file and loads its armies into army 1 and army 2.
+ * A file with one army only replaces army 1. On errors every problem is
+ * listed at once and both armies are left unchanged.
+ *
+ * @param army1 First army
+ * @param army2 Second army
+ * @return Number of armies loaded (0 on errors or when cancelled)
+ */
+int load_armies(ARMY *army1, ARMY *army2) {
+    char path[256];
+    get_string_input("LOAD ARMIES", "Army file (empty to cancel):", path, sizeof(path));
+    if (path[0] == '\0') return 0;
+
+    ARMY_IMPORT import;
+    const bool valid = load_army_file(path, &import);
+
+    clear();
+    box(stdscr, 0, 0);
+    draw_fancy_box(1, 4, 3, GAME_WIDTH - 8);
+    attron(COLOR_PAIR(valid ? COLOR_HP_GOOD : COLOR_HP_LOW) | A_BOLD);
+    if (valid) {
+        mvprintw(2, 7, "LOADED %d ARM%s FROM %.60s", import.count, import.count == 1 ? "Y" : "IES", path);
+    } else {
+        mvprintw(2, 7, "%d PROBLEM%s IN %.60s", import.error_count, import.error_count == 1 ? "" : "S", path);
+    }
+    attroff(COLOR_PAIR(valid ? COLOR_HP_GOOD : COLOR_HP_LOW) | A_BOLD);
+
+    int y = 5;
+    if (valid) {
+        *army1 = import.armies[0];
+        if (import.count > 1) {
+            *army2 = import.armies[1];
+        }
+        for (int a = 0; a < import.count; a++) {
+            const ARMY *army = &import.armies[a];
+            attron(COLOR_PAIR(a == 0 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
+            mvprintw(y++, 7, "ARMY %d", a + 1);
+            attroff(COLOR_PAIR(a == 0 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
+            for (int i = 0; i <= army->top; i++) {
+                mvprintw(y++, 9, "%-20.20s %s%s%s", army->units[i].name, army->units[i].item1->name,
+                         army->units[i].item2 ? ", " : "", army->units[i].item2 ? army->units[i].item2->name : "");
+            }
+            y++;
+        }
+    } else {
+        for (int i = 0; i < import.error_count && i < IMPORT_MAX_ERRORS; i++) {
+            mvprintw(y++, 7, "%.*s", GAME_WIDTH - 10, import.errors[i]);
+        }
+        if (import.error_count > IMPORT_MAX_ERRORS) {
+            mvprintw(y++, 7, "... and %d more", import.error_count - IMPORT_MAX_ERRORS);
+        }
+    }
+
+    attron(COLOR_PAIR(COLOR_BATTLE_INFO));
+    mvprintw(GAME_HEIGHT - 2, GAME_WIDTH / 2 - 15, "Press any key to continue...");
+    attroff(COLOR_PAIR(COLOR_BATTLE_INFO));
+    refresh();
+    getch();
+    return valid ? import.count : 0;
 }
 
 /**
  * Displays the main menu of the game
- * Shows options to create armies, start battle, or exit
+ * Shows options to create or load armies, start battle, or exit
  */
 void display_menu() {
     clear();
@@ -282,10 +404,11 @@ void display_menu() {
     draw_fancy_box(12, 30, 14, 40);
 
     attron(COLOR_PAIR(COLOR_MENU));
-    mvprintw(15, 40, "1. Create Army 1");
-    mvprintw(18, 40, "2. Create Army 2");
-    mvprintw(21, 40, "3. Start Battle");
-    mvprintw(24, 40, "4. Exit");
+    mvprintw(14, 40, "1. Create Army 1");
+    mvprintw(16, 40, "2. Create Army 2");
+    mvprintw(18, 40, "3. Start Battle");
+    mvprintw(20, 40, "4. Exit");
+    mvprintw(22, 40, "5. Load Armies From File");
     attroff(COLOR_PAIR(COLOR_MENU));
 
     // Draw version info
@@ -295,33 +418,58 @@ void display_menu() {
 }
 
 /**
- * Draws an HP bar with color coding based on remaining health
+ * Draws the filled part of an HP bar, without brackets or label, with color
+ * coding based on remaining health
  *
- * @param y Y-coordinate to draw the bar
- * @param x X-coordinate to draw the bar
+ * @param y Y-coordinate to draw the gauge
+ * @param x X-coordinate to draw the gauge
  * @param hp Health points (0-100) to represent
+ * @param width Width of the gauge in characters
  */
-void draw_hp_bar(int y, int x, int hp) {
+void draw_hp_gauge(int y, int x, int hp, int width) {
     int color;
     if (hp > 70) color = COLOR_HP_GOOD;
     else if (hp > 30) color = COLOR_HP_MID;
     else color = COLOR_HP_LOW;
 
-    attron(COLOR_PAIR(color));
+    render_attron(color);
 
-    int bar_width = 20;
-    int filled = (hp * bar_width) / 100;
+    int filled = (hp * width) / 100;
+    if (filled < 0) filled = 0;
+    if (filled > width) filled = width;
 
-    mvprintw(y, x, "[");
     for (int i = 0; i < filled; i++) {
-        mvaddch(y, x + 1 + i, '|');
+        render_glyph(y, x + i, '|');
     }
-    for (int i = filled; i < bar_width; i++) {
-        mvaddch(y, x + 1 + i, ' ');
+    for (int i = filled; i < width; i++) {
+        render_glyph(y, x + i, ' ');
     }
-    mvprintw(y, x + bar_width + 1, "] %d%%", hp);
 
-    attroff(COLOR_PAIR(color));
+    render_attroff(color);
+}
+
+/**
+ * Draws an HP bar with color coding based on remaining health
+ *
+ * @param y Y-coordinate to draw the bar
+ * @param x X-coordinate to draw the bar
+ * @param hp Health points (0-100) to represent
+ */
+void draw_hp_bar(int y, int x, int hp) {
+    int color;
+    if (hp > 70) color = COLOR_HP_GOOD;
+    else if (hp > 30) color = COLOR_HP_MID;
+    else color = COLOR_HP_LOW;
+
+    int bar_width = 20;
+
+    render_attron(color);
+    render_printw(y, x, "[");
+    render_attroff(color);
+    draw_hp_gauge(y, x + 1, hp, bar_width);
+    render_attron(color);
+    render_printw(y, x + bar_width + 1, "] %d%%", hp);
+    render_attroff(color);
 }
 
 /**
@@ -332,28 +480,29 @@ void draw_hp_bar(int y, int x, int hp) {
  * @param round Current battle round number (0 to hide round number)
  */
 void display_battlefield(ARMY *army1, ARMY *army2, int round) {
-    clear();
+    const uint64_t span = trace_begin();
+    render_clear();
 
     // Draw battlefield border
-    box(stdscr, 0, 0);
+    render_border();
 
     // Draw title
-    attron(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
-    mvprintw(2, GAME_WIDTH/2 - 10, "BATTLEFIELD - ROUND %d", round);
-    attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+    render_attron(COLOR_TITLE | RENDER_BOLD);
+    render_printw(2, GAME_WIDTH/2 - 10, "BATTLEFIELD - ROUND %d", round);
+    render_attroff(COLOR_TITLE | RENDER_BOLD);
 
     // Draw army headers
-    attron(COLOR_PAIR(COLOR_ARMY1) | A_BOLD);
-    mvprintw(4, 5, "ARMY 1");
-    attroff(COLOR_PAIR(COLOR_ARMY1) | A_BOLD);
+    render_attron(COLOR_ARMY1 | RENDER_BOLD);
+    render_printw(4, 5, "ARMY 1");
+    render_attroff(COLOR_ARMY1 | RENDER_BOLD);
 
-    attron(COLOR_PAIR(COLOR_ARMY2) | A_BOLD);
-    mvprintw(4, GAME_WIDTH - 15, "ARMY 2");
-    attroff(COLOR_PAIR(COLOR_ARMY2) | A_BOLD);
+    render_attron(COLOR_ARMY2 | RENDER_BOLD);
+    render_printw(4, GAME_WIDTH - 15, "ARMY 2");
+    render_attroff(COLOR_ARMY2 | RENDER_BOLD);
 
     // Draw middle line
     for (int i = 5; i < GAME_HEIGHT-5; i++) {
-        mvaddch(i, GAME_WIDTH/2, ACS_VLINE);
+        render_glyph(i, GAME_WIDTH/2, RENDER_VLINE);
     }
 
     // Draw units for army 1
@@ -364,9 +513,9 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
         draw_fancy_box(y, 3, 4, GAME_WIDTH/2 - 6);
 
         // Unit info
-        attron(COLOR_PAIR(COLOR_ARMY1));
-        mvprintw(y+1, 5, "%-15s", army1->units[i].name);
-        attroff(COLOR_PAIR(COLOR_ARMY1));
+        render_attron(COLOR_ARMY1);
+        render_printw(y+1, 5, "%-15s", army1->units[i].name);
+        render_attroff(COLOR_ARMY1);
 
         char items[60] = "";
         if (army1->units[i].item1) {
@@ -376,7 +525,7 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
             strcat(items, " & ");
             strcat(items, army1->units[i].item2->name);
         }
-        mvprintw(y+1, 21, "Items: %s", items);
+        render_printw(y+1, 21, "Items: %s", items);
 
         // Draw symbol based on weapon type (using ASCII)
         char symbol[11] = "";
@@ -385,7 +534,7 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
         else
             strcpy(symbol, "XXmeleeXX");  // Melee unit
 
-        mvprintw(y+2, 5, "%s", symbol);
+        render_printw(y+2, 5, "%s", symbol);
 
         draw_hp_bar(y+2, GAME_WIDTH/2 - 30, army1->units[i].hp);
     }
@@ -398,9 +547,9 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
         draw_fancy_box(y, GAME_WIDTH/2 + 3, 4, GAME_WIDTH/2 - 6);
 
         // Unit info
-        attron(COLOR_PAIR(COLOR_ARMY2));
-        mvprintw(y+1, GAME_WIDTH/2 + 5, "%-15s", army2->units[i].name);
-        attroff(COLOR_PAIR(COLOR_ARMY2));
+        render_attron(COLOR_ARMY2);
+        render_printw(y+1, GAME_WIDTH/2 + 5, "%-15s", army2->units[i].name);
+        render_attroff(COLOR_ARMY2);
 
         char items[60] = "";
         if (army2->units[i].item1) {
@@ -410,7 +559,7 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
             strcat(items, " & ");
             strcat(items, army2->units[i].item2->name);
         }
-        mvprintw(y+1, GAME_WIDTH/2 + 21, "Items: %s", items);
+        render_printw(y+1, GAME_WIDTH/2 + 21, "Items: %s", items);
 
         // Draw symbol based on weapon type (using ASCII)
         char symbol[11] = "";
@@ -419,143 +568,537 @@ void display_battlefield(ARMY *army1, ARMY *army2, int round) {
         else
             strcpy(symbol, "XXmeleeXX");  // Melee unit
 
-        mvprintw(y+2, GAME_WIDTH/2 + 5, "%s", symbol);
+        render_printw(y+2, GAME_WIDTH/2 + 5, "%s", symbol);
 
         draw_hp_bar(y+2, GAME_WIDTH - 35, army2->units[i].hp);
     }
 
     // Draw controls
-    attron(COLOR_PAIR(COLOR_BATTLE_INFO));
-    mvprintw(GAME_HEIGHT-2, GAME_WIDTH/2 - 15, "Press any key for next round...");
-    attroff(COLOR_PAIR(COLOR_BATTLE_INFO));
+    render_attron(COLOR_BATTLE_INFO);
+    render_printw(GAME_HEIGHT-2, GAME_WIDTH/2 - 15, "Press any key for next round...");
+    render_attroff(COLOR_BATTLE_INFO);
 
-    refresh();
+    render_present();
+    trace_end("display_battlefield", span);
 }
 
 /**
- * Animates an attack between armies with moving projectiles
+ * Animates one side's hits of a round: a projectile flies from each
+ * attacking unit to each unit it hits, then the damage taken is shown next
+ * to every defender hit.
  *
  * @param army1 Pointer to the first ARMY structure
  * @param army2 Pointer to the second ARMY structure
- * @param attacker_side The side that is attacking (1 for army1, 2 for army2)
+ * @param hits COMBAT_HIT events of one side, in engine order
+ * @param count Number of hits
  */
-void animate_attack(ARMY *army1, ARMY *army2, int attacker_side) {
-    // Simple animation for attack
+void animate_attack(ARMY *army1, ARMY *army2, const COMBAT_EVENT *hits, int count) {
+    const int attacker_side = hits[0].side;
     int start_x = attacker_side == 1 ? GAME_WIDTH/2 - 10 : GAME_WIDTH/2 + 10;
     int end_x = attacker_side == 1 ? GAME_WIDTH/2 + 5 : GAME_WIDTH/2 - 5;
-    const char* projectiles[3] = {"*", "**", "***"};
+    int taken[MAX_ARMY] = {0};
+    const uint64_t span = trace_begin();
+
+    for (int k = 0; k < count; k++) {
+        taken[hits[k].defender] += hits[k].damage;
+    }
 
     for (int i = 0; i < 5; i++) {
-        clear();
+        render_clear();
         // Always display armies in the same order (army1 first, army2 second)
         display_battlefield(army1, army2, 0); // 0 will not show round number
 
-        // Draw projectile
-        int x = attacker_side == 1 ?
-                start_x + (i * (end_x - start_x) / 4) :
-                end_x + (i * (start_x - end_x) / 4);
-
-        attron(COLOR_PAIR(attacker_side == 1 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
-
-        // Choose projectile based on attack type
-        const char* projectile;
-        if (i < 3) {
-            projectile = projectiles[i];
+        render_attron((attacker_side == 1 ? COLOR_ARMY1 : COLOR_ARMY2) | RENDER_BOLD);
+        if (i < 4) {
+            // Draw one projectile per hit, from the attacker's row to the defender's
+            for (int k = 0; k < count; k++) {
+                const int from_y = 8 + hits[k].attacker * 5;
+                const int to_y = 8 + hits[k].defender * 5;
+                render_printw(from_y + i * (to_y - from_y) / 3, start_x + i * (end_x - start_x) / 3, "%s",
+                              attacker_side == 1 ? "==>" : "<==");
+            }
         } else {
-            projectile = projectiles[5-i-1];  // Fade out
+            for (int j = 0; j < MAX_ARMY; j++) {
+                if (taken[j] > 0) {
+                    render_printw(8 + j * 5, end_x, "-%d", taken[j]);
+                }
+            }
         }
+        render_attroff((attacker_side == 1 ? COLOR_ARMY1 : COLOR_ARMY2) | RENDER_BOLD);
 
-        mvprintw(GAME_HEIGHT/2, x, "%s", attacker_side == 1 ?
-                 "==>" : "<==");
-        attroff(COLOR_PAIR(attacker_side == 1 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
-
-        refresh();
-        usleep(100000); // 0.1 second delay
+        render_present();
+        render_pause(100000); // 0.1 second delay
     }
+    trace_end(attacker_side == 1 ? "animate_attack 1->2" : "animate_attack 2->1", span);
 }
 
 /**
  * Main battle loop that runs the battle between two armies
- * Handles animations, battle rounds, and displays the final result
+ * Steps through the engine's combat events, animates each side's hits
+ * when its attack ends (before any dead unit is removed), and displays the
+ * final result
  *
  * @param army1 Pointer to the first ARMY structure
  * @param army2 Pointer to the second ARMY structure
  */
 void battle_loop(ARMY *army1, ARMY *army2) {
-    int round = 1;
+    BATTLE_STEP step;
+    COMBAT_EVENT event;
+    COMBAT_EVENT volley[MAX_ARMY * 2 * MAX_ARMY];
+    int count = 0;
     int result = -1;
 
-    while (result == -1) {
-        display_battlefield(army1, army2, round);
-        getch();
-
-        // Animate Army 1 attacking
-        animate_attack(army1, army2, 1);
-
-        // Animate Army 2 attacking
-        animate_attack(army1, army2, 2);
-
-        result = battle_round(army1, army2);
-        round++;
+    battle_step_init(&step, army1, army2);
+    display_battlefield(army1, army2, step.round);
+    render_wait_key();
+
+    while (battle_step(&step, &event)) {
+        if (event.type == COMBAT_HIT && count < (int) (sizeof(volley) / sizeof(volley[0]))) {
+            volley[count++] = event;
+        } else if (event.type == COMBAT_ATTACK_END) {
+            // Dead units are only removed after both attacks, so every row is still in place
+            if (count > 0) {
+                animate_attack(army1, army2, volley, count);
+            }
+            count = 0;
+        } else if (event.type == COMBAT_ROUND_END) {
+            result = event.result;
+            if (result == -1) {
+                display_battlefield(army1, army2, step.round);
+                render_wait_key();
+            }
+        }
     }
 
-    display_battlefield(army1, army2, round-1);
+    display_battlefield(army1, army2, step.round);
 
     draw_fancy_box(GAME_HEIGHT/2-5, GAME_WIDTH/2-25, 10, 50);
 
     if (result == 0) {
-        attron(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
-        mvprintw(GAME_HEIGHT/2-3, GAME_WIDTH/2-6, "IT'S A DRAW!");
-        attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+        render_attron(COLOR_TITLE | RENDER_BOLD);
+        render_printw(GAME_HEIGHT/2-3, GAME_WIDTH/2-6, "IT'S A DRAW!");
+        render_attroff(COLOR_TITLE | RENDER_BOLD);
     } else if (result == 1) {
-        attron(COLOR_PAIR(COLOR_ARMY1) | A_BOLD);
-        mvprintw(GAME_HEIGHT/2-3, GAME_WIDTH/2-11, "ARMY 1 IS VICTORIOUS!");
-        attroff(COLOR_PAIR(COLOR_ARMY1) | A_BOLD);
+        render_attron(COLOR_ARMY1 | RENDER_BOLD);
+        render_printw(GAME_HEIGHT/2-3, GAME_WIDTH/2-11, "ARMY 1 IS VICTORIOUS!");
+        render_attroff(COLOR_ARMY1 | RENDER_BOLD);
     } else {
-        attron(COLOR_PAIR(COLOR_ARMY2) | A_BOLD);
-        mvprintw(GAME_HEIGHT/2-3, GAME_WIDTH/2-11, "ARMY 2 IS VICTORIOUS!");
-        attroff(COLOR_PAIR(COLOR_ARMY2) | A_BOLD);
+        render_attron(COLOR_ARMY2 | RENDER_BOLD);
+        render_printw(GAME_HEIGHT/2-3, GAME_WIDTH/2-11, "ARMY 2 IS VICTORIOUS!");
+        render_attroff(COLOR_ARMY2 | RENDER_BOLD);
     }
 
-    mvprintw(GAME_HEIGHT/2, GAME_WIDTH/2-14, "Press any key to return to menu...");
-    refresh();
-    getch();
+    render_printw(GAME_HEIGHT/2, GAME_WIDTH/2-14, "Press any key to return to menu...");
+    render_present();
+    render_wait_key();
 }
 
 /**
- * Main function - entry point of the program
- * Initializes the game, loads items, and runs the main game loop
+ * Loads the item catalog from JSON_PATH into the global item list
  *
- * @return 0 on success, non-zero on failure
+ * @param gui Whether ncurses is active and must be shut down before reporting an error
  */
-int main() {
-    init_gui();
-
+void load_catalog(bool gui) {
     FILE *json = fopen(JSON_PATH, "r");
     if (!json) {
-        endwin();
+        if (gui) {
+            endwin();
+        }
         printf("Error: Could not open file %s\n", JSON_PATH);
         error(ERR_FILE);
     }
 
     load_items(json);
     fclose(json);
+}
+
+/**
+ * Prints command-line usage to stdout
+ */
+void print_usage() {
+    printf("Usage: battle_arena [options]\n");
+    printf("  (no options)          Start the interactive game\n");
+    printf("  --serve PATH          Run the battle-resolution daemon on a Unix socket\n");
+    printf("  --tournament ROSTER   Run a round-robin tournament over the armies in a roster file\n");
+    printf("  --battle ROSTER       Fight the first two (mass) armies of a roster with the parallel engine\n");
+    printf("  --batch ROSTER        Play the matchups listed in --matchups between armies of ROSTER as a pipeline\n");
+    printf("  --matchups FILE       Matchups for --batch, one \"A,B\" pair of 0-based roster indices per line\n");
+    printf("  --cast ROSTER         Record the battle of the first two armies of ROSTER as an asciicast in --out\n");
+    printf("  --events ROSTER       Log the combat events of the first two armies of ROSTER as CSV in --out\n");
+    printf("  --armies FILE         Start the interactive game with the armies of FILE loaded\n");
+    printf("  --out FILE            Write one result line per battle to FILE\n");
+    printf("  --format FORMAT       Result file format: csv (default) or columnar\n");
+    printf("  --shard I/N           Play only shard I (0-based) of N of the tournament matchups\n");
+    printf("  --merge A,B,...       Merge shard result files into the --out file, in matchup order\n");
+    printf("  --dump FILE           Print a columnar result file as CSV\n");
+    printf("  --db FILE             Consult and extend a persistent outcome database\n");
+    printf("  --db-slots N          Slot count when creating the outcome database (default: 4194304)\n");
+    printf("  --sensitivity ROSTER  Show how item tweaks shift the results of a round robin over ROSTER\n");
+    printf("  --tweak I.S=V[,...]   A tweak for --sensitivity, e.g. spear.att=7 (repeatable)\n");
+    printf("  --compare ROSTER      Play a round robin over ROSTER under the live and candidate catalogs side by side\n");
+    printf("  --catalog FILE        A candidate item catalog for --compare (repeatable)\n");
+    printf("  --ladder ROSTER       Rank the armies of ROSTER by rating from adaptively chosen battles\n");
+    printf("  --battles N           Battle budget for --ladder (default: 16 per army)\n");
+    printf("  --target-rd R         Stop --ladder once the mean rating deviation is at most R\n");
+    printf("  --evolve POOL         Evolve a strong army against the armies of a roster (result in --out)\n");
+    printf("  --units N             Army size for --evolve (default: 5)\n");
+    printf("  --generations N       Generations for --evolve (default: 100)\n");
+    printf("  --population N        Armies per island for --evolve (default: 64)\n");
+    printf("  --islands N           Islands for --evolve (default: 8)\n");
+    printf("  --seed N              Random seed for --evolve and --fuzz (default: 1)\n");
+    printf("  --verify ROSTER       Check an engine against battle_round() round by round on every matchup\n");
+    printf("  --fuzz N              Check an engine against battle_round() on N generated scenarios\n");
+    printf("  --engine NAME         Engine for --verify and --fuzz: compact (default), parallel, or decide\n");
+    printf("                        (decide: capped battles with and without --decide-early, cap from --max-rounds)\n");
+    printf("  --max-rounds N        End tournament, batch and ladder battles undecided after N rounds as timeouts (3)\n");
+    printf("  --decide-early        Stop tournament, batch and ladder battles once their winner is certain\n");
+    printf("  --tile N|auto         Play the tournament in tiles of N x N armies (auto: sized for the cache)\n");
+    printf("  --checkpoint FILE     Periodically save tournament progress to FILE\n");
+    printf("  --checkpoint-every S  Seconds between checkpoints (default: 60)\n");
+    printf("  --resume              Continue the tournament from the --checkpoint file\n");
+    printf("  --watch               Show a live dashboard of the running tournament battles\n");
+    printf("  --trace FILE          Record a Chrome trace-event timeline of the run to FILE\n");
+    printf("  --workers N           Worker threads for server and batch modes (default: one per CPU)\n");
+    printf("  --queue N             Outstanding requests per lane before clients are throttled (default: 1024)\n");
+    printf("  --latency-target MS   Latency goal reported for interactive server requests (default: 5)\n");
+    printf("  --memory-report N     Measure memory per army for N armies in each representation\n");
+}
+
+/**
+ * Main function - entry point of the program
+ * Parses command-line options, then either runs one of the non-interactive
+ * modes or initializes the game, loads items, and runs the main game loop
+ *
+ * @param argc Number of command-line arguments
+ * @param argv Command-line arguments
+ * @return 0 on success, non-zero on failure
+ */
+int main(int argc, char *argv[]) {
+    const char *socket_path = NULL;
+    int workers = 0;
+    int queue_limit = 0;
+    double latency_target = 0;
+    int memory_armies = 0;
+    TOURNAMENT_CONFIG tournament = {0};
+    const char *battle_path = NULL;
+    const char *cast_path = NULL;
+    const char *events_path = NULL;
+    const char *armies_path = NULL;
+    const char *dump_path = NULL;
+    const char *merge_list = NULL;
+    const char *sensitivity_path = NULL;
+    const char **tweaks = NULL;
+    int tweak_count = 0;
+    const char *compare_path = NULL;
+    BATCH_CONFIG batch = {0};
+    LADDER_CONFIG ladder = {0};
+    const char **catalogs = NULL;
+    int catalog_count = 0;
+    EVOLVE_CONFIG evolve = {NULL, NULL, MAX_ARMY, 100, 64, 8, 1, 0};
+    VERIFY_CONFIG verify = {NULL, "compact", 0, 1, 0, 0};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "--tournament") == 0 && i + 1 < argc) {
+            tournament.roster_path = argv[++i];
+        } else if (strcmp(argv[i], "--battle") == 0 && i + 1 < argc) {
+            battle_path = argv[++i];
+        } else if (strcmp(argv[i], "--armies") == 0 && i + 1 < argc) {
+            armies_path = argv[++i];
+        } else if (strcmp(argv[i], "--cast") == 0 && i + 1 < argc) {
+            cast_path = argv[++i];
+        } else if (strcmp(argv[i], "--events") == 0 && i + 1 < argc) {
+            events_path = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            tournament.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0) {
+                tournament.format = RESULT_CSV;
+            } else if (strcmp(argv[i], "columnar") == 0) {
+                tournament.format = RESULT_COLUMNAR;
+            } else {
+                print_usage();
+                error(ERR_CMD);
+            }
+        } else if (strcmp(argv[i], "--shard") == 0 && i + 1 < argc) {
+            i++;
+            if (sscanf(argv[i], "%d/%d", &tournament.shard, &tournament.shards) != 2 ||
+                tournament.shards < 1 || tournament.shard < 0 || tournament.shard >= tournament.shards) {
+                print_usage();
+                error(ERR_CMD);
+            }
+        } else if (strcmp(argv[i], "--merge") == 0 && i + 1 < argc) {
+            merge_list = argv[++i];
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dump_path = argv[++i];
+        } else if (strcmp(argv[i], "--db") == 0 && i + 1 < argc) {
+            tournament.db_path = argv[++i];
+        } else if (strcmp(argv[i], "--db-slots") == 0 && i + 1 < argc) {
+            tournament.db_slots = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--sensitivity") == 0 && i + 1 < argc) {
+            sensitivity_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            batch.roster_path = argv[++i];
+        } else if (strcmp(argv[i], "--matchups") == 0 && i + 1 < argc) {
+            batch.matchups_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else if (strcmp(argv[i], "--catalog") == 0 && i + 1 < argc) {
+            const char **grown = realloc(catalogs, sizeof(char *) * (catalog_count + 1));
+            if (!grown) {
+                error(ERR_MEMORY);
+            }
+            catalogs = grown;
+            catalogs[catalog_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--tweak") == 0 && i + 1 < argc) {
+            const char **grown = realloc(tweaks, sizeof(char *) * (tweak_count + 1));
+            if (!grown) {
+                error(ERR_MEMORY);
+            }
+            tweaks = grown;
+            tweaks[tweak_count++] = argv[++i];
+        } else if (strcmp(argv[i], "--evolve") == 0 && i + 1 < argc) {
+            evolve.pool_path = argv[++i];
+        } else if (strcmp(argv[i], "--ladder") == 0 && i + 1 < argc) {
+            ladder.roster_path = argv[++i];
+        } else if (strcmp(argv[i], "--battles") == 0 && i + 1 < argc) {
+            ladder.battles = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--target-rd") == 0 && i + 1 < argc) {
+            ladder.target_rd = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--units") == 0 && i + 1 < argc) {
+            evolve.units = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--generations") == 0 && i + 1 < argc) {
+            evolve.generations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--population") == 0 && i + 1 < argc) {
+            evolve.population = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--islands") == 0 && i + 1 < argc) {
+            evolve.islands = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            evolve.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+            verify.roster_path = argv[++i];
+        } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+            verify.scenarios = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            verify.engine = argv[++i];
+        } else if (strcmp(argv[i], "--max-rounds") == 0 && i + 1 < argc) {
+            tournament.limits.max_rounds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--decide-early") == 0) {
+            tournament.limits.decide_early = true;
+        } else if (strcmp(argv[i], "--tile") == 0 && i + 1 < argc) {
+            i++;
+            tournament.tile = strcmp(argv[i], "auto") == 0 ? -1 : atoi(argv[i]);
+            if (tournament.tile == 0 || (tournament.tile < 0 && strcmp(argv[i], "auto") != 0)) {
+                print_usage();
+                error(ERR_CMD);
+            }
+        } else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+            tournament.checkpoint_path = argv[++i];
+        } else if (strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+            tournament.checkpoint_interval = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--resume") == 0) {
+            tournament.resume = true;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            tournament.watch = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_open(argv[++i]);
+            trace_thread_name("main");
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) {
+            queue_limit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency-target") == 0 && i + 1 < argc) {
+            latency_target = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc) {
+            memory_armies = atoi(argv[++i]);
+        } else {
+            print_usage();
+            error(ERR_CMD);
+        }
+    }
+
+    if (merge_list) {
+        if (!tournament.output_path) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        char *list = strdup(merge_list);
+        const char **inputs = malloc(sizeof(char *) * (strlen(merge_list) + 1));
+        if (!list || !inputs) {
+            error(ERR_MEMORY);
+        }
+        int count = 0;
+        for (char *path = strtok(list, ","); path; path = strtok(NULL, ",")) {
+            inputs[count++] = path;
+        }
+        const uint64_t merged = merge_results(inputs, count, tournament.output_path, tournament.format);
+        printf("Merged %llu results from %d files into %s\n", (unsigned long long) merged, count,
+               tournament.output_path);
+        free(inputs);
+        free(list);
+        return 0;
+    }
+
+    if (dump_path) {
+        dump_results(dump_path, stdout);
+        return 0;
+    }
+
+    if (memory_armies > 0) {
+        load_catalog(false);
+        report_army_memory(memory_armies, stdout);
+        return 0;
+    }
+
+    if (cast_path) {
+        if (!tournament.output_path) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        load_catalog(false);
+        return export_cast(cast_path, tournament.output_path);
+    }
+
+    if (events_path) {
+        if (!tournament.output_path) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        load_catalog(false);
+        return export_events(events_path, tournament.output_path);
+    }
+
+    if (battle_path) {
+        load_catalog(false);
+        return run_mass_battle(battle_path, workers);
+    }
+
+    if (verify.roster_path || verify.scenarios > 0) {
+        load_catalog(false);
+        verify.seed = evolve.seed;
+        verify.max_rounds = tournament.limits.max_rounds;
+        verify.threads = workers;
+        return run_verify(&verify);
+    }
+
+    if (evolve.pool_path) {
+        load_catalog(false);
+        evolve.output_path = tournament.output_path;
+        evolve.threads = workers;
+        return run_evolve(&evolve);
+    }
+
+    if (sensitivity_path) {
+        if (tweak_count == 0) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        load_catalog(false);
+        const int status = run_sensitivity(sensitivity_path, tweaks, tweak_count, workers);
+        free(tweaks);
+        return status;
+    }
+
+    if (batch.roster_path) {
+        if (!batch.matchups_path) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        load_catalog(false);
+        batch.output_path = tournament.output_path;
+        batch.format = tournament.format;
+        batch.db_path = tournament.db_path;
+        batch.db_slots = tournament.db_slots;
+        batch.limits = tournament.limits;
+        batch.threads = workers;
+        return run_batch(&batch);
+    }
+
+    if (ladder.roster_path) {
+        load_catalog(false);
+        ladder.output_path = tournament.output_path;
+        ladder.format = tournament.format;
+        ladder.limits = tournament.limits;
+        ladder.threads = workers;
+        return run_ladder(&ladder);
+    }
+
+    if (compare_path) {
+        if (catalog_count == 0) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        load_catalog(false);
+        const int status = run_compare(compare_path, catalogs, catalog_count, workers);
+        free(catalogs);
+        return status;
+    }
+
+    if (tournament.roster_path) {
+        load_catalog(false);
+        if (tournament.watch) {
+            init_gui();
+        }
+        if (tournament.resume && !tournament.checkpoint_path) {
+            print_usage();
+            error(ERR_CMD);
+        }
+        if (tournament.checkpoint_interval <= 0) {
+            tournament.checkpoint_interval = 60;
+        }
+        tournament.threads = workers;
+        return run_tournament(&tournament);
+    }
+
+    if (socket_path) {
+        load_catalog(false);
+        return run_server(socket_path, workers, queue_limit, latency_target);
+    }
+
+    // Armies from --armies are checked before the screen is taken over, so
+    // every problem can be printed to the terminal
+    ARMY_IMPORT import = {0};
+    if (armies_path) {
+        load_catalog(false);
+        if (!load_army_file(armies_path, &import)) {
+            for (int i = 0; i < import.error_count && i < IMPORT_MAX_ERRORS; i++) {
+                fprintf(stderr, "%s: %s\n", armies_path, import.errors[i]);
+            }
+            if (import.error_count > IMPORT_MAX_ERRORS) {
+                fprintf(stderr, "%s: ... and %d more\n", armies_path, import.error_count - IMPORT_MAX_ERRORS);
+            }
+            error(ERR_BAD_VALUE);
+        }
+    }
+
+    init_gui();
+    if (!armies_path) {
+        load_catalog(true);
+    }
 
     ARMY army1;
     ARMY army2;
     init_army(&army1);
     init_army(&army2);
-    bool army1_created = false;
-    bool army2_created = false;
+    bool army1_created = import.count > 0;
+    bool army2_created = import.count > 1;
+    if (army1_created) {
+        army1 = import.armies[0];
+    }
+    if (army2_created) {
+        army2 = import.armies[1];
+    }
 
     while (1) {
         display_menu();
         int ch = getch();
         if (ch == '1') {
-            create_army(&army1, 1);
+            create_army(&army1, 1, army2_created ? &army2 : NULL);
             army1_created = true;
         } else if (ch == '2') {
-            create_army(&army2, 2);
+            create_army(&army2, 2, army1_created ? &army1 : NULL);
             army2_created = true;
         } else if (ch == '3') {
             if (army1_created && army2_created) {
@@ -578,6 +1121,10 @@ int main() {
             }
         } else if (ch == '4') {
             break;
+        } else if (ch == '5') {
+            const int loaded = load_armies(&army1, &army2);
+            army1_created |= loaded > 0;
+            army2_created |= loaded > 1;
         }
     }
 
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "../include/battle-arena.h"
+
+#define ARENA_ALIGN 16
+
+/**
+ * A chunk of memory owned by an arena. Blocks are kept after a reset and
+ * reused in order, so a warmed-up arena never calls malloc() again.
+ */
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) uint8_t data[];
+};
+
+/**
+ * Allocates a new arena block with at least the given capacity.
+ *
+ * @param size Minimum usable size in bytes
+ * @return The new block
+ */
+static ARENA_BLOCK *new_block(size_t size) {
+    ARENA_BLOCK *block = malloc(sizeof(ARENA_BLOCK) + size);
+    if (!block) {
+        error(ERR_MEMORY);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+/**
+ * Initializes an empty arena. No memory is allocated until the first request.
+ *
+ * @param arena The arena to initialize
+ * @param block_size Default size of each block in bytes (0 selects ARENA_DEFAULT_BLOCK)
+ */
+void arena_init(ARENA *arena, size_t block_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->block_size = block_size ? block_size : ARENA_DEFAULT_BLOCK;
+}
+
+/**
+ * Allocates memory from an arena by bumping a pointer.
+ * Memory is 16-byte aligned and lives until the next arena_reset() or arena_free().
+ *
+ * @param arena The arena to allocate from
+ * @param size Number of bytes
+ * @return Pointer to the allocated memory
+ */
+void *arena_alloc(ARENA *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    ARENA_BLOCK *block = arena->current;
+    while (block && block->used + size > block->size) {
+        // Reuse blocks left over from before the last reset, in order
+        block = block->next;
+        if (block) {
+            block->used = 0;
+        }
+    }
+
+    if (!block) {
+        block = new_block(size > arena->block_size ? size : arena->block_size);
+        if (arena->current) {
+            // Splice in after the current block so later blocks stay reachable
+            block->next = arena->current->next;
+            arena->current->next = block;
+        } else {
+            block->next = arena->first;
+            arena->first = block;
+        }
+        arena->stats.blocks++;
+        arena->stats.reserved += block->size;
+    }
+    arena->current = block;
+
+    void *p = block->data + block->used;
+    block->used += size;
+
+    arena->in_use += size;
+    if (arena->in_use > arena->stats.peak) {
+        arena->stats.peak = arena->in_use;
+    }
+    arena->stats.allocations++;
+    return p;
+}
+
+/**
+ * Releases everything allocated from an arena in O(1).
+ * Blocks are retained; their usage counters are cleared lazily when the
+ * arena advances into them again.
+ *
+ * @param arena The arena to reset
+ */
+void arena_reset(ARENA *arena) {
+    arena->current = arena->first;
+    if (arena->current) {
+        arena->current->used = 0;
+    }
+    arena->in_use = 0;
+    arena->stats.resets++;
+}
+
+/**
+ * Returns all blocks of an arena to the system.
+ *
+ * @param arena The arena to free
+ */
+void arena_free(ARENA *arena) {
+    ARENA_BLOCK *block = arena->first;
+    while (block) {
+        ARENA_BLOCK *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->first = arena->current = NULL;
+    arena->in_use = 0;
+}
+
+/**
+ * Initializes a pool of fixed-size blocks carved out of an arena.
+ * Released blocks are kept on a free list and handed out again before the
+ * arena is asked for more memory.
+ *
+ * @param pool The pool to initialize
+ * @param arena Arena backing the pool; must outlive it and must not be reset while blocks are in use
+ * @param block_size Size of every block in bytes
+ */
+void pool_init(BLOCK_POOL *pool, ARENA *arena, size_t block_size) {
+    memset(pool, 0, sizeof(*pool));
+    pool->arena = arena;
+    pool->block_size = block_size < sizeof(void *) ? sizeof(void *) : block_size;
+}
+
+/**
+ * Takes a block from a pool.
+ *
+ * @param pool The pool
+ * @return Pointer to a block of pool->block_size bytes
+ */
+void *pool_get(BLOCK_POOL *pool) {
+    if (pool->free_list) {
+        void *block = pool->free_list;
+        pool->free_list = *(void **) block;
+        pool->stats.reused++;
+        return block;
+    }
+    pool->stats.carved++;
+    return arena_alloc(pool->arena, pool->block_size);
+}
+
+/**
+ * Returns a block to its pool for reuse.
+ *
+ * @param pool The pool the block was taken from
+ * @param block The block
+ */
+void pool_put(BLOCK_POOL *pool, void *block) {
+    *(void **) block = pool->free_list;
+    pool->free_list = block;
+}
+
+/**
+ * Adds the counters of one arena and optional pool to a running total.
+ *
+ * @param total Accumulated counters
+ * @param arena Arena whose counters to add
+ * @param pool Optional pool whose counters to add (may be NULL)
+ */
+void alloc_stats_add(ALLOC_STATS *total, const ARENA *arena, const BLOCK_POOL *pool) {
+    total->allocations += arena->stats.allocations;
+    total->resets += arena->stats.resets;
+    total->blocks += arena->stats.blocks;
+    total->reserved += arena->stats.reserved;
+    total->peak += arena->stats.peak;
+    if (pool) {
+        total->reused += pool->stats.reused;
+        total->carved += pool->stats.carved;
+    }
+}
+
+/**
+ * Prints allocation counters: how many requests were served without malloc()
+ * and the peak resident memory of the process.
+ *
+ * @param stats Accumulated counters
+ * @param out Stream to print to
+ */
+void print_alloc_stats(const ALLOC_STATS *stats, FILE *out) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const size_t served = stats->allocations + stats->reused;
+    fprintf(out, "Allocations: %zu served from arenas/pools, %zu mallocs (%zu avoided), %zu resets\n",
+            served, stats->blocks, served > stats->blocks ? served - stats->blocks : 0, stats->resets);
+    fprintf(out, "Arena memory: %zu KiB reserved, %zu KiB peak in use, pool blocks %zu reused / %zu carved\n",
+            stats->reserved / 1024, stats->peak / 1024, stats->reused, stats->carved);
+    fprintf(out, "Peak resident memory: %ld KiB\n", usage.ru_maxrss);
+}
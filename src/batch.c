@@ -0,0 +1,488 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define BATCH_SIZE 4096
+#define BATCHES_PER_WORKER 4
+
+/**
+ * A batch of matchups travelling through the pipeline: filled by the
+ * reader, played by one worker and written out by the writer, then reused.
+ */
+typedef struct {
+    uint64_t seq;
+    int count;
+    uint64_t matchup[BATCH_SIZE];
+    CRESULT results[BATCH_SIZE];
+} BATCH;
+
+/**
+ * Counters of one pipeline stage. `busy` is time spent doing the stage's
+ * work, `stalled` is time spent blocked on a neighbouring stage.
+ */
+typedef struct {
+    uint64_t items;
+    double busy;
+    double stalled;
+} STAGE;
+
+/**
+ * Shared pipeline state. The batches form a fixed pool: the reader blocks
+ * when every batch is in flight, so memory use does not grow with the
+ * input. Finished batches are parked in `done` at their sequence number
+ * modulo the pool size (unique, since at most `capacity` are in flight)
+ * until the writer reaches them.
+ */
+typedef struct {
+    const ROSTER *roster;
+    const BATTLE_LIMITS *limits;
+    OUTCOME_DB *db;
+    RESULT_WRITER *output;
+    uint32_t (*score)[3];
+
+    BATCH *pool;
+    int capacity;
+    BATCH **free_list;
+    int free_count;
+    BATCH **queue;
+    int queue_head;
+    int queue_count;
+    BATCH **done;
+    uint64_t produced;
+    bool finished;
+    int in_flight;
+    int peak_in_flight;
+
+    pthread_mutex_t lock;
+    pthread_cond_t free_cond;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+
+    STAGE reader;
+    STAGE workers;
+    STAGE writer;
+} PIPELINE;
+
+/**
+ * Memory-mapped matchup file, parsed in place.
+ */
+typedef struct {
+    const char *path;
+    const char *data;
+    size_t size;
+    size_t pos;
+    size_t released;
+    uint64_t line;
+} MATCHUP_FILE;
+
+/**
+ * Reports a malformed matchup line and exits.
+ *
+ * @param file The matchup file
+ * @param message What is wrong with the line
+ */
+static void bad_line(const MATCHUP_FILE *file, const char *message) {
+    fprintf(stderr, "%s:%llu: %s\n", file->path, (unsigned long long) file->line, message);
+    error(ERR_BAD_VALUE);
+}
+
+/**
+ * Parses a non-negative decimal army index at the current position.
+ *
+ * @param file The matchup file
+ * @param value Output index
+ * @return true if at least one digit was read
+ */
+static bool parse_index(MATCHUP_FILE *file, int *value) {
+    const size_t start = file->pos;
+    long long v = 0;
+    while (file->pos < file->size && file->data[file->pos] >= '0' && file->data[file->pos] <= '9') {
+        if (v <= 1000000000) v = v * 10 + (file->data[file->pos] - '0');
+        file->pos++;
+    }
+    *value = v > 1000000000 ? -1 : (int) v;
+    return file->pos > start;
+}
+
+/**
+ * Skips spaces and tabs.
+ *
+ * @param file The matchup file
+ */
+static void skip_blanks(MATCHUP_FILE *file) {
+    while (file->pos < file->size && (file->data[file->pos] == ' ' || file->data[file->pos] == '\t')) {
+        file->pos++;
+    }
+}
+
+/**
+ * Reads the next matchup record straight from the mapping. A record is a
+ * line "A,B" (or "A B") of 0-based roster indices; blank lines and lines
+ * starting with '#' are skipped. The pair is stored as the round-robin
+ * matchup id, so A and B may come in either order.
+ *
+ * @param file The matchup file
+ * @param armies Number of armies in the roster
+ * @param matchup Output matchup id
+ * @return false at the end of the file
+ */
+static bool next_matchup(MATCHUP_FILE *file, int armies, uint64_t *matchup) {
+    while (file->pos < file->size) {
+        file->line++;
+        skip_blanks(file);
+        const char c = file->pos < file->size ? file->data[file->pos] : '\n';
+        if (c == '\n' || c == '\r' || c == '#') {
+            const char *end = memchr(file->data + file->pos, '\n', file->size - file->pos);
+            file->pos = end ? (size_t) (end - file->data) + 1 : file->size;
+            continue;
+        }
+
+        int a, b;
+        if (!parse_index(file, &a)) bad_line(file, "expected an army index");
+        skip_blanks(file);
+        if (file->pos < file->size && file->data[file->pos] == ',') {
+            file->pos++;
+            skip_blanks(file);
+        }
+        if (!parse_index(file, &b)) bad_line(file, "expected a second army index");
+        skip_blanks(file);
+        if (file->pos < file->size && file->data[file->pos] == '\r') file->pos++;
+        if (file->pos < file->size) {
+            if (file->data[file->pos] != '\n') bad_line(file, "unexpected text after the matchup");
+            file->pos++;
+        }
+
+        if (a < 0 || b < 0 || a >= armies || b >= armies) bad_line(file, "army index out of range");
+        if (a == b) bad_line(file, "an army cannot fight itself");
+        *matchup = a < b ? matchup_id(a, b, armies) : matchup_id(b, a, armies);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Returns the pages the reader has moved past to the kernel, so a large
+ * input does not stay resident after it has been parsed.
+ *
+ * @param file The matchup file
+ */
+static void release_parsed(MATCHUP_FILE *file) {
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t end = file->pos / page * page;
+    if (end > file->released) {
+        madvise((void *) (file->data + file->released), end - file->released, MADV_DONTNEED);
+        file->released = end;
+    }
+}
+
+/**
+ * Simulation stage: takes filled batches off the queue and plays them.
+ *
+ * @param arg Pointer to the PIPELINE structure
+ * @return Always NULL
+ */
+static void *batch_worker(void *arg) {
+    PIPELINE *pipeline = arg;
+    const ROSTER *roster = pipeline->roster;
+    trace_thread_name("batch worker");
+
+    ARENA scratch;
+    arena_init(&scratch, 0);
+    STAGE stage = {0};
+    while (1) {
+        double started = now_seconds();
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->queue_count == 0 && !pipeline->finished) {
+            pthread_cond_wait(&pipeline->work_cond, &pipeline->lock);
+        }
+        if (pipeline->queue_count == 0) {
+            pthread_mutex_unlock(&pipeline->lock);
+            break;
+        }
+        BATCH *batch = pipeline->queue[pipeline->queue_head];
+        pipeline->queue_head = (pipeline->queue_head + 1) % pipeline->capacity;
+        pipeline->queue_count--;
+        pthread_mutex_unlock(&pipeline->lock);
+        stage.stalled += now_seconds() - started;
+
+        started = now_seconds();
+        const uint64_t span = trace_begin();
+        for (int i = 0; i < batch->count; i++) {
+            int a, b;
+            matchup_pair(batch->matchup[i], roster->count, &a, &b);
+            const CARMY *first = roster->armies[a], *second = roster->armies[b];
+            if (!lookup_outcome(pipeline->db, pipeline->limits, first, second, &batch->results[i])) {
+                csimulate_observed(first, second, &combat_catalog, &batch->results[i], &scratch, pipeline->limits,
+                                   NULL, NULL);
+                store_outcome(pipeline->db, pipeline->limits, first, second, &batch->results[i]);
+            }
+        }
+        arena_reset(&scratch);
+        trace_end("simulate batch", span);
+        stage.items += batch->count;
+        stage.busy += now_seconds() - started;
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->done[batch->seq % pipeline->capacity] = batch;
+        pthread_cond_signal(&pipeline->done_cond);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+
+    pthread_mutex_lock(&pipeline->lock);
+    pipeline->workers.items += stage.items;
+    pipeline->workers.busy += stage.busy;
+    pipeline->workers.stalled += stage.stalled;
+    pthread_mutex_unlock(&pipeline->lock);
+    arena_free(&scratch);
+    return NULL;
+}
+
+/**
+ * Output stage: writes finished batches strictly in input order, updates
+ * the standings and hands each batch back to the reader.
+ *
+ * @param arg Pointer to the PIPELINE structure
+ * @return Always NULL
+ */
+static void *batch_writer(void *arg) {
+    PIPELINE *pipeline = arg;
+    trace_thread_name("batch writer");
+
+    for (uint64_t next = 0;; next++) {
+        double started = now_seconds();
+        BATCH **slot = &pipeline->done[next % pipeline->capacity];
+        pthread_mutex_lock(&pipeline->lock);
+        while (!*slot && !(pipeline->finished && next == pipeline->produced)) {
+            pthread_cond_wait(&pipeline->done_cond, &pipeline->lock);
+        }
+        BATCH *batch = *slot;
+        *slot = NULL;
+        pthread_mutex_unlock(&pipeline->lock);
+        pipeline->writer.stalled += now_seconds() - started;
+        if (!batch) break;
+
+        started = now_seconds();
+        const uint64_t span = trace_begin();
+        for (int i = 0; i < batch->count; i++) {
+            int a, b;
+            matchup_pair(batch->matchup[i], pipeline->roster->count, &a, &b);
+            record_score(pipeline->score, a, b, batch->results[i].winner);
+            if (pipeline->output) {
+                result_writer_add(pipeline->output, batch->matchup[i], &batch->results[i]);
+            }
+        }
+        trace_end("write batch", span);
+        pipeline->writer.items += batch->count;
+        pipeline->writer.busy += now_seconds() - started;
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->free_list[pipeline->free_count++] = batch;
+        pipeline->in_flight--;
+        pthread_cond_signal(&pipeline->free_cond);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+    return NULL;
+}
+
+/**
+ * Input stage, run on the calling thread: parses the matchup file into
+ * batches, blocking while the whole pool is in flight.
+ *
+ * @param pipeline The pipeline
+ * @param file The mapped matchup file
+ */
+static void read_batches(PIPELINE *pipeline, MATCHUP_FILE *file) {
+    bool more = true;
+    while (more) {
+        double started = now_seconds();
+        pthread_mutex_lock(&pipeline->lock);
+        while (pipeline->free_count == 0) {
+            pthread_cond_wait(&pipeline->free_cond, &pipeline->lock);
+        }
+        BATCH *batch = pipeline->free_list[--pipeline->free_count];
+        pthread_mutex_unlock(&pipeline->lock);
+        pipeline->reader.stalled += now_seconds() - started;
+
+        started = now_seconds();
+        const uint64_t span = trace_begin();
+        batch->count = 0;
+        while (batch->count < BATCH_SIZE &&
+               (more = next_matchup(file, pipeline->roster->count, &batch->matchup[batch->count]))) {
+            batch->count++;
+        }
+        release_parsed(file);
+        trace_end("parse batch", span);
+        pipeline->reader.items += batch->count;
+        pipeline->reader.busy += now_seconds() - started;
+
+        pthread_mutex_lock(&pipeline->lock);
+        if (batch->count > 0) {
+            batch->seq = pipeline->produced++;
+            pipeline->queue[(pipeline->queue_head + pipeline->queue_count) % pipeline->capacity] = batch;
+            pipeline->queue_count++;
+            if (++pipeline->in_flight > pipeline->peak_in_flight) {
+                pipeline->peak_in_flight = pipeline->in_flight;
+            }
+            pthread_cond_signal(&pipeline->work_cond);
+        } else {
+            pipeline->free_list[pipeline->free_count++] = batch;
+        }
+        if (!more) {
+            pipeline->finished = true;
+            pthread_cond_broadcast(&pipeline->work_cond);
+            pthread_cond_broadcast(&pipeline->done_cond);
+        }
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+}
+
+/**
+ * Prints the counters of one stage.
+ *
+ * @param name Stage name
+ * @param stage The counters
+ * @param elapsed Wall time of the run in seconds
+ */
+static void print_stage(const char *name, const STAGE *stage, double elapsed) {
+    printf("%-12s %12llu %10.3f %10.3f %14.0f %7.1f%%\n", name, (unsigned long long) stage->items, stage->busy,
+           stage->stalled, stage->busy > 0 ? stage->items / stage->busy : 0.0,
+           elapsed > 0 ? 100.0 * stage->busy / elapsed : 0.0);
+}
+
+/**
+ * Plays a list of matchups between the armies of a roster as a streaming
+ * pipeline: the matchup file is memory-mapped and parsed in place by the
+ * calling thread, worker threads play batches taken from a bounded pool,
+ * and a writer thread emits the results in input order. The pool size is
+ * fixed by the worker count, so memory stays flat however long the input
+ * is. Outcomes are looked up in and added to the outcome database when one
+ * is given, as in a tournament. Prints the standings and the throughput of
+ * each stage.
+ *
+ * @param config Batch options; output_path and db_path may be NULL
+ * @return 0 on success
+ */
+int run_batch(const BATCH_CONFIG *config) {
+    FILE *roster_file = fopen(config->roster_path, "r");
+    if (!roster_file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(roster_file, &roster);
+    fclose(roster_file);
+    if (roster.count < 2) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    MATCHUP_FILE file = {0};
+    file.path = config->matchups_path;
+    const int fd = open(config->matchups_path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        error(ERR_FILE);
+    }
+    file.size = (size_t) st.st_size;
+    if (file.size > 0) {
+        void *map = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            error(ERR_FILE);
+        }
+        madvise(map, file.size, MADV_SEQUENTIAL);
+        file.data = map;
+    }
+    close(fd);
+
+    int threads = config->threads;
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    PIPELINE pipeline = {0};
+    pipeline.roster = &roster;
+    pipeline.limits = &config->limits;
+    pipeline.capacity = threads * BATCHES_PER_WORKER;
+    pipeline.pool = malloc(sizeof(BATCH) * pipeline.capacity);
+    pipeline.free_list = malloc(sizeof(BATCH *) * pipeline.capacity);
+    pipeline.queue = malloc(sizeof(BATCH *) * pipeline.capacity);
+    pipeline.done = calloc(pipeline.capacity, sizeof(BATCH *));
+    pipeline.score = calloc(roster.count, sizeof(*pipeline.score));
+    if (!pipeline.pool || !pipeline.free_list || !pipeline.queue || !pipeline.done || !pipeline.score) {
+        error(ERR_MEMORY);
+    }
+    for (int i = 0; i < pipeline.capacity; i++) {
+        pipeline.free_list[pipeline.free_count++] = &pipeline.pool[i];
+    }
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.free_cond, NULL);
+    pthread_cond_init(&pipeline.work_cond, NULL);
+    pthread_cond_init(&pipeline.done_cond, NULL);
+    if (config->output_path) {
+        pipeline.output = result_writer_open(config->output_path, config->format, roster.count);
+    }
+    if (config->db_path) {
+        pipeline.db = outcome_db_open(config->db_path, catalog_version(&item_list),
+                                      config->db_slots ? config->db_slots : OUTCOME_DB_DEFAULT_SLOTS, true);
+    }
+
+    const double started = now_seconds();
+    pthread_t writer;
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    if (!workers) {
+        error(ERR_MEMORY);
+    }
+    pthread_create(&writer, NULL, batch_writer, &pipeline);
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&workers[t], NULL, batch_worker, &pipeline);
+    }
+    trace_thread_name("batch reader");
+    read_batches(&pipeline, &file);
+    for (int t = 0; t < threads; t++) {
+        pthread_join(workers[t], NULL);
+    }
+    pthread_join(writer, NULL);
+    if (pipeline.output) {
+        result_writer_close(pipeline.output);
+    }
+    const double elapsed = now_seconds() - started;
+    free(workers);
+
+    print_standings(&roster, pipeline.score, stdout);
+    printf("\n%-12s %12s %10s %10s %14s %8s\n", "Stage", "Matchups", "Busy s", "Stalled s", "Matchups/s", "Load");
+    print_stage("reader", &pipeline.reader, elapsed);
+    print_stage("workers", &pipeline.workers, elapsed * threads);
+    print_stage("writer", &pipeline.writer, elapsed);
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("\n%llu matchups in %.3f s on %d workers (%.0f matchups/s)\n", (unsigned long long) pipeline.writer.items,
+           elapsed, threads, elapsed > 0 ? pipeline.writer.items / elapsed : 0.0);
+    printf("Batches: %d of %d in flight at peak, %zu KiB pool; peak resident memory %ld KiB\n",
+           pipeline.peak_in_flight, pipeline.capacity, sizeof(BATCH) * pipeline.capacity / 1024, usage.ru_maxrss);
+    if (pipeline.db) {
+        outcome_db_report(pipeline.db, stdout);
+        outcome_db_close(pipeline.db);
+    }
+
+    if (file.data) {
+        munmap((void *) file.data, file.size);
+    }
+    pthread_cond_destroy(&pipeline.done_cond);
+    pthread_cond_destroy(&pipeline.work_cond);
+    pthread_cond_destroy(&pipeline.free_cond);
+    pthread_mutex_destroy(&pipeline.lock);
+    free(pipeline.score);
+    free(pipeline.done);
+    free(pipeline.queue);
+    free(pipeline.free_list);
+    free(pipeline.pool);
+    free_roster(&roster);
+    return 0;
+}
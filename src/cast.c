@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+#define CAST_KEY_DELAY 1.0
+
+/**
+ * Asciicast v2 writer attached to a cell buffer. Each frame is written as
+ * the terminal output that turns the previous frame into it.
+ */
+typedef struct {
+    FILE *out;
+    RENDER_CELL *shown;
+    int cursor_y;
+    int cursor_x;
+    int attr;
+    char *data;
+    size_t length;
+    size_t capacity;
+    uint64_t events;
+    uint64_t bytes;
+    double render_time;
+} CAST;
+
+/**
+ * Appends bytes to the pending frame output.
+ *
+ * @param cast The writer
+ * @param bytes The bytes
+ * @param count Number of bytes
+ */
+static void append(CAST *cast, const char *bytes, size_t count) {
+    if (cast->length + count > cast->capacity) {
+        while (cast->length + count > cast->capacity) {
+            cast->capacity = cast->capacity ? cast->capacity * 2 : 4096;
+        }
+        char *grown = realloc(cast->data, cast->capacity);
+        if (!grown) {
+            error(ERR_MEMORY);
+        }
+        cast->data = grown;
+    }
+    memcpy(cast->data + cast->length, bytes, count);
+    cast->length += count;
+}
+
+/**
+ * Appends the UTF-8 encoding of a code point.
+ *
+ * @param cast The writer
+ * @param ch Code point (below 0x10000)
+ */
+static void append_utf8(CAST *cast, uint32_t ch) {
+    char bytes[3];
+    if (ch < 0x80) {
+        bytes[0] = (char) ch;
+        append(cast, bytes, 1);
+    } else if (ch < 0x800) {
+        bytes[0] = (char) (0xC0 | ch >> 6);
+        bytes[1] = (char) (0x80 | (ch & 0x3F));
+        append(cast, bytes, 2);
+    } else {
+        bytes[0] = (char) (0xE0 | ch >> 12);
+        bytes[1] = (char) (0x80 | (ch >> 6 & 0x3F));
+        bytes[2] = (char) (0x80 | (ch & 0x3F));
+        append(cast, bytes, 3);
+    }
+}
+
+/**
+ * Appends the SGR sequence selecting a render attribute.
+ *
+ * @param cast The writer
+ * @param attr Color pair number, optionally with RENDER_BOLD
+ */
+static void append_attr(CAST *cast, int attr) {
+    char sgr[32];
+    const int pair = attr & RENDER_PAIR_MASK;
+    int n;
+    if (pair > 0 && pair < RENDER_PAIRS) {
+        n = snprintf(sgr, sizeof(sgr), "\033[0;%s3%d;4%dm", attr & RENDER_BOLD ? "1;" : "",
+                     render_palette[pair][0], render_palette[pair][1]);
+    } else {
+        n = snprintf(sgr, sizeof(sgr), "\033[0%sm", attr & RENDER_BOLD ? ";1" : "");
+    }
+    append(cast, sgr, (size_t) n);
+    cast->attr = attr;
+}
+
+/**
+ * Writes one output event with the pending frame output as a JSON string.
+ *
+ * @param cast The writer
+ * @param time Event time in seconds
+ */
+static void write_event(CAST *cast, double time) {
+    int n = fprintf(cast->out, "[%.6f, \"o\", \"", time);
+    for (size_t i = 0; i < cast->length; i++) {
+        const unsigned char c = (unsigned char) cast->data[i];
+        if (c == '"' || c == '\\') {
+            n += fprintf(cast->out, "\\%c", c);
+        } else if (c < 0x20) {
+            n += fprintf(cast->out, "\\u%04x", c);
+        } else {
+            fputc(c, cast->out);
+            n++;
+        }
+    }
+    n += fprintf(cast->out, "\"]\n");
+    cast->bytes += (uint64_t) n;
+    cast->events++;
+    cast->length = 0;
+}
+
+/**
+ * Frame callback: encodes the cells that changed since the last frame as
+ * cursor moves, attribute changes and characters, stamped with the
+ * buffer's virtual time. Frames without changes produce no event.
+ *
+ * @param buffer The buffer that was presented
+ * @param context The CAST writer
+ */
+static void cast_frame(RENDER_BUFFER *buffer, void *context) {
+    CAST *cast = context;
+    const double started = now_seconds();
+
+    for (int y = 0; y < buffer->rows; y++) {
+        for (int x = 0; x < buffer->cols; x++) {
+            const size_t i = (size_t) y * buffer->cols + x;
+            const RENDER_CELL *cell = &buffer->cells[i];
+            if (cell->ch == cast->shown[i].ch && cell->attr == cast->shown[i].attr) continue;
+
+            if (y != cast->cursor_y || x != cast->cursor_x) {
+                char move[24];
+                const int n = snprintf(move, sizeof(move), "\033[%d;%dH", y + 1, x + 1);
+                append(cast, move, (size_t) n);
+            }
+            if (cell->attr != cast->attr) {
+                append_attr(cast, cell->attr);
+            }
+            append_utf8(cast, cell->ch);
+            cast->shown[i] = *cell;
+            cast->cursor_y = y;
+            cast->cursor_x = x + 1;
+        }
+    }
+    if (cast->length > 0) {
+        write_event(cast, buffer->clock);
+    }
+    cast->render_time += now_seconds() - started;
+}
+
+/**
+ * Renders the battle between the first two armies of a roster into an
+ * asciicast v2 file, without a terminal. The interactive battle screens are
+ * drawn into a cell buffer; animation delays and key presses only advance
+ * the recording's clock (by CAST_KEY_DELAY seconds per key), so the file is
+ * produced much faster than the battle would play.
+ *
+ * @param roster_path Path of the roster file
+ * @param output_path Path of the .cast file to write
+ * @return 0 on success
+ */
+int export_cast(const char *roster_path, const char *output_path) {
+    FILE *file = fopen(roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+
+    ARMY army1, army2;
+    if (roster.count < 2 || !expand_army(roster.armies[0], &army1) || !expand_army(roster.armies[1], &army2)) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    CAST cast = {0};
+    cast.out = fopen(output_path, "w");
+    if (!cast.out) {
+        error(ERR_FILE);
+    }
+    fprintf(cast.out, "{\"version\": 2, \"width\": %d, \"height\": %d, \"title\": \"Battle Arena\"}\n", GAME_WIDTH,
+            GAME_HEIGHT);
+
+    RENDER_BUFFER buffer;
+    render_buffer_init(&buffer, GAME_HEIGHT, GAME_WIDTH);
+    buffer.key_delay = CAST_KEY_DELAY;
+    buffer.on_present = cast_frame;
+    buffer.context = &cast;
+    // Nothing is on the player's screen yet; a zero code point never matches a cell
+    cast.shown = calloc((size_t) GAME_HEIGHT * GAME_WIDTH, sizeof(RENDER_CELL));
+    if (!cast.shown) {
+        error(ERR_MEMORY);
+    }
+    append(&cast, "\033[2J", 4);
+    append_attr(&cast, 0);
+
+    const double started = now_seconds();
+    RENDER *previous = render_use(&buffer.base);
+    battle_loop(&army1, &army2);
+    render_use(previous);
+    const double elapsed = now_seconds() - started;
+
+    // Keep the final screen up for the closing key press
+    write_event(&cast, buffer.clock);
+    if (fclose(cast.out) != 0) {
+        error(ERR_FILE);
+    }
+
+    printf("%llu frames, %llu events, %.1f s of playback in %.3f s (%.1fx real time)\n",
+           (unsigned long long) buffer.frames, (unsigned long long) cast.events, buffer.clock, elapsed,
+           elapsed > 0 ? buffer.clock / elapsed : 0.0);
+    printf("Frame encoding: %.1f us per frame, %llu bytes written to %s\n",
+           buffer.frames ? cast.render_time * 1e6 / buffer.frames : 0.0, (unsigned long long) cast.bytes,
+           output_path);
+
+    free(cast.shown);
+    free(cast.data);
+    render_buffer_free(&buffer);
+    free_roster(&roster);
+    return 0;
+}
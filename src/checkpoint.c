@@ -0,0 +1,185 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define CHECKPOINT_MAGIC "BACKPT01"
+
+/**
+ * Fixed part of a checkpoint file. It is followed by the score table
+ * (armies x 3 counters), the completed-chunk bitmap and a 64-bit checksum
+ * of everything before it.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t roster_hash;
+    uint64_t catalog_version;
+    uint64_t first;
+    uint64_t total;
+    uint64_t chunks;
+    uint64_t output_offset;
+    uint64_t output_rows;
+    uint32_t armies;
+    uint32_t reserved;
+} CHECKPOINT_HEADER;
+
+/**
+ * Extends an FNV-1a hash with a buffer.
+ *
+ * @param h Running hash
+ * @param data Buffer
+ * @param size Size of the buffer in bytes
+ * @return The extended hash
+ */
+static uint64_t checksum(uint64_t h, const void *data, size_t size) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+/**
+ * Returns the size of the completed-chunk bitmap of a checkpoint.
+ *
+ * @param chunks Number of chunks
+ * @return Bitmap size in bytes
+ */
+size_t checkpoint_bitmap_size(uint64_t chunks) {
+    return (size_t) ((chunks + 7) / 8);
+}
+
+/**
+ * Flushes the directory entry of a file to disk, so a rename() into that
+ * directory survives a crash.
+ *
+ * @param path Path of a file in the directory
+ * @return true on success
+ */
+static bool sync_directory(const char *path) {
+    char dir[4096];
+    const char *slash = strrchr(path, '/');
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int) (slash - path), path);
+    }
+
+    const int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    const bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+/**
+ * Writes a checkpoint crash-consistently: the data goes to "<path>.tmp",
+ * is flushed to disk and then renamed over the previous checkpoint, and the
+ * directory is flushed after the rename, so a crash at any point leaves
+ * either the old or the new checkpoint in place, and a completed save
+ * leaves the new one.
+ *
+ * @param path Checkpoint path
+ * @param cp The checkpoint
+ * @return true on success
+ */
+bool checkpoint_save(const char *path, const CHECKPOINT *cp) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *file = fopen(tmp, "wb");
+    if (!file) return false;
+
+    CHECKPOINT_HEADER header = {0};
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.roster_hash = cp->roster_hash;
+    header.catalog_version = cp->catalog_version;
+    header.first = cp->first;
+    header.total = cp->total;
+    header.chunks = cp->chunks;
+    header.output_offset = cp->output_offset;
+    header.output_rows = cp->output_rows;
+    header.armies = (uint32_t) cp->armies;
+
+    const size_t scores = sizeof(uint32_t) * 3 * (size_t) cp->armies;
+    const size_t bitmap = checkpoint_bitmap_size(cp->chunks);
+    uint64_t sum = checksum(14695981039346656037ull, &header, sizeof(header));
+    sum = checksum(sum, cp->score, scores);
+    sum = checksum(sum, cp->done, bitmap);
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(cp->score, 1, scores, file) == scores &&
+              fwrite(cp->done, 1, bitmap, file) == bitmap &&
+              fwrite(&sum, sizeof(sum), 1, file) == 1 &&
+              fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = fclose(file) == 0 && ok;
+    return ok && rename(tmp, path) == 0 && sync_directory(path);
+}
+
+/**
+ * Reads a checkpoint. The score table and bitmap are allocated here and
+ * released with checkpoint_free().
+ *
+ * @param path Checkpoint path
+ * @param cp Destination
+ * @return false if there is no checkpoint or it is damaged
+ */
+bool checkpoint_load(const char *path, CHECKPOINT *cp) {
+    memset(cp, 0, sizeof(*cp));
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    CHECKPOINT_HEADER header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 ||
+        header.armies > UINT16_MAX || header.chunks > header.total - header.first) {
+        fclose(file);
+        return false;
+    }
+
+    cp->roster_hash = header.roster_hash;
+    cp->catalog_version = header.catalog_version;
+    cp->first = header.first;
+    cp->total = header.total;
+    cp->chunks = header.chunks;
+    cp->output_offset = header.output_offset;
+    cp->output_rows = header.output_rows;
+    cp->armies = (int) header.armies;
+
+    const size_t scores = sizeof(uint32_t) * 3 * (size_t) cp->armies;
+    const size_t bitmap = checkpoint_bitmap_size(cp->chunks);
+    cp->score = malloc(scores ? scores : 1);
+    cp->done = malloc(bitmap ? bitmap : 1);
+    if (!cp->score || !cp->done) {
+        error(ERR_MEMORY);
+    }
+
+    uint64_t stored;
+    const bool ok = fread(cp->score, 1, scores, file) == scores &&
+                    fread(cp->done, 1, bitmap, file) == bitmap &&
+                    fread(&stored, sizeof(stored), 1, file) == 1;
+    fclose(file);
+
+    uint64_t sum = checksum(14695981039346656037ull, &header, sizeof(header));
+    sum = checksum(sum, cp->score, scores);
+    sum = checksum(sum, cp->done, bitmap);
+    if (!ok || sum != stored) {
+        checkpoint_free(cp);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Releases the tables of a checkpoint.
+ *
+ * @param cp The checkpoint
+ */
+void checkpoint_free(CHECKPOINT *cp) {
+    free(cp->score);
+    free(cp->done);
+    cp->score = NULL;
+    cp->done = NULL;
+}
@@ -0,0 +1,656 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define DECIDE_DEFENSES 32
+#define DECIDE_FIRST_ROUND 16
+
+/**
+ * Combat statistics of the global item list, compiled by load_items().
+ */
+CCATALOG combat_catalog;
+
+/**
+ * Compiles an item list into the compact statistics table used by the compact engine.
+ * Item ids in compact units are indices into this table. The longest range and
+ * widest radius are recorded so the engine can bound its work per round, and
+ * the duel table lets it finish one-on-one endings without fighting them out.
+ *
+ * @param list The item list to compile
+ * @param catalog Destination catalog
+ */
+void compile_catalog(const ITEM_LIST *list, CCATALOG *catalog) {
+    memset(catalog, 0, sizeof(*catalog));
+    catalog->count = list->count;
+
+    for (int i = 0; i < list->count; i++) {
+        const ITEM *item = &list->items[i];
+        catalog->items[i].att = (int) item->att;
+        catalog->items[i].def = (int) item->def;
+        catalog->items[i].range = (int) item->range;
+        catalog->items[i].radius = (int) item->radius;
+        catalog->items[i].slots = (int) item->slots;
+
+        if (catalog->items[i].range > catalog->max_range) {
+            catalog->max_range = catalog->items[i].range;
+        }
+        if (catalog->items[i].radius > catalog->max_radius) {
+            catalog->max_radius = catalog->items[i].radius;
+        }
+    }
+    catalog->duels = duel_table_get(catalog);
+}
+
+/**
+ * Returns the number of bytes occupied by a compact army with the given unit count.
+ *
+ * @param count Number of units
+ * @return Size in bytes of the CARMY structure including its units
+ */
+size_t carmy_size(int count) {
+    return sizeof(CARMY) + sizeof(CUNIT) * (size_t) count;
+}
+
+/**
+ * Allocates a compact army with room for a given number of units.
+ * The unit count is set to count; units are zero-initialized.
+ *
+ * @param count Number of units
+ * @return Newly allocated army, to be released with free()
+ */
+CARMY *carmy_new(int count) {
+    CARMY *army = calloc(1, carmy_size(count));
+    if (!army) {
+        error(ERR_MEMORY);
+    }
+    army->count = (uint16_t) count;
+    return army;
+}
+
+/**
+ * Converts an army into its compact combat representation.
+ * Items become indices into item_list and names are interned.
+ *
+ * @param army The army to convert
+ * @param out Destination compact army with room for at least army->top + 1 units
+ */
+void compact_army(const ARMY *army, CARMY *out) {
+    out->count = (uint16_t) (army->top + 1);
+
+    for (int i = 0; i <= army->top; i++) {
+        const UNIT *unit = &army->units[i];
+        CUNIT *c = &out->units[i];
+        c->item1 = unit->item1 ? (uint8_t) (unit->item1 - item_list.items) : CITEM_NONE;
+        c->item2 = unit->item2 ? (uint8_t) (unit->item2 - item_list.items) : CITEM_NONE;
+        c->hp = (int16_t) unit->hp;
+        c->name = intern_name(unit->name);
+    }
+}
+
+/**
+ * Converts a compact army back into the ARMY structure used by the UI.
+ *
+ * @param army The compact army to convert
+ * @param out Destination army
+ * @return true on success, false if the army has more than MAX_ARMY units
+ */
+bool expand_army(const CARMY *army, ARMY *out) {
+    if (army->count > MAX_ARMY) return false;
+
+    init_army(out);
+    for (int i = 0; i < army->count; i++) {
+        const CUNIT *c = &army->units[i];
+        UNIT unit = {0};
+        strncpy(unit.name, interned_name(c->name), MAX_NAME);
+        unit.item1 = c->item1 != CITEM_NONE ? &item_list.items[c->item1] : NULL;
+        unit.item2 = c->item2 != CITEM_NONE ? &item_list.items[c->item2] : NULL;
+        unit.hp = c->hp;
+        push(out, unit);
+    }
+    return true;
+}
+
+/**
+ * Finalizes a 64-bit value with the splitmix64 mixing function.
+ *
+ * @param x Value to mix
+ * @return Well-distributed 64-bit hash of x
+ */
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Hashes the combat-relevant content of a compact army: unit order, items and HP.
+ * Names are ignored, since they never influence a battle.
+ *
+ * @param army The army to hash
+ * @param seed Seed selecting an independent hash function
+ * @return 64-bit hash
+ */
+uint64_t carmy_hash(const CARMY *army, uint64_t seed) {
+    uint64_t h = mix64(seed ^ army->count);
+    for (int i = 0; i < army->count; i++) {
+        const CUNIT *unit = &army->units[i];
+        const uint64_t packed = unit->item1 | (uint64_t) unit->item2 << 8 | (uint64_t) (uint16_t) unit->hp << 16;
+        h = mix64(h ^ packed) + (uint64_t) i;
+    }
+    return h;
+}
+
+/**
+ * Returns the combined defense of a compact unit.
+ *
+ * @param unit The unit
+ * @param catalog Catalog the item ids refer to
+ * @return Sum of the defense values of the unit's items
+ */
+static int unit_defense(const CUNIT *unit, const CCATALOG *catalog) {
+    int de = 0;
+    if (unit->item1 != CITEM_NONE) de += catalog->items[unit->item1].def;
+    if (unit->item2 != CITEM_NONE) de += catalog->items[unit->item2].def;
+    return de;
+}
+
+/**
+ * Applies the hits of one item carried by the attacker at a given position.
+ *
+ * @param item Id of the item, or CITEM_NONE
+ * @param position Position of the attacker in its army
+ * @param defenders Defending units
+ * @param count Number of defending units
+ * @param catalog Catalog the item ids refer to
+ */
+static void item_attack(uint8_t item, int position, CUNIT *defenders, int count, const CCATALOG *catalog) {
+    if (item == CITEM_NONE) return;
+
+    const CITEM *stats = &catalog->items[item];
+    if (stats->range < position) return;
+
+    const int last = stats->radius < count - 1 ? stats->radius : count - 1;
+    for (int j = 0; j <= last; j++) {
+        // Saturate instead of wrapping: only the sign of a dead unit's HP matters
+        const int hp = defenders[j].hp - max(stats->att - unit_defense(&defenders[j], catalog), 1);
+        defenders[j].hp = (int16_t) (hp < INT16_MIN ? INT16_MIN : hp);
+    }
+}
+
+/**
+ * Compact counterpart of attack(): every attacker hits the defenders within the
+ * radius of each of its items, if its position is within the item's range.
+ * Attackers behind the longest range in the catalog can never hit anything and
+ * are not visited, so the cost does not grow with the size of the army.
+ *
+ * @param attackers Attacking units
+ * @param attack_count Number of attacking units
+ * @param defenders Defending units
+ * @param defend_count Number of defending units
+ * @param catalog Catalog the item ids refer to
+ */
+void cattack(const CUNIT *attackers, int attack_count, CUNIT *defenders, int defend_count, const CCATALOG *catalog) {
+    if (attack_count > catalog->max_range + 1) {
+        attack_count = catalog->max_range + 1;
+    }
+    for (int i = 0; i < attack_count; i++) {
+        item_attack(attackers[i].item1, i, defenders, defend_count, catalog);
+        item_attack(attackers[i].item2, i, defenders, defend_count, catalog);
+    }
+}
+
+/**
+ * Compact counterpart of check_hp(): removes dead units while keeping the
+ * order of the survivors.
+ * Only the front of the army can have been hit, so only the first `window`
+ * units are examined. Survivors of the window are moved back to close the
+ * gaps, leaving the army at units + (returned count); this costs O(window)
+ * instead of shifting the whole army.
+ *
+ * @param units Units to compact in place
+ * @param count Number of units
+ * @param window Number of front units that may have taken damage
+ * @return Number of dead units removed from the front of the array
+ */
+int ccheck_front(CUNIT *units, int count, int window) {
+    if (window > count) {
+        window = count;
+    }
+
+    int write = window;
+    for (int i = window - 1; i >= 0; i--) {
+        if (units[i].hp > 0) {
+            units[--write] = units[i];
+        }
+    }
+    return write;
+}
+
+/**
+ * Compact counterpart of battle_round().
+ * The army pointers are advanced past units removed by ccheck_front().
+ *
+ * @param army1 In/out pointer to the units of the first army
+ * @param count1 In/out number of units of the first army
+ * @param army2 In/out pointer to the units of the second army
+ * @param count2 In/out number of units of the second army
+ * @param catalog Catalog the item ids refer to
+ * @return Same result codes as battle_round()
+ */
+int cbattle_round(CUNIT **army1, int *count1, CUNIT **army2, int *count2, const CCATALOG *catalog) {
+    const uint64_t round_start = trace_begin();
+    uint64_t span = trace_begin();
+    cattack(*army1, *count1, *army2, *count2, catalog);
+    trace_end("attack 1->2", span);
+    span = trace_begin();
+    cattack(*army2, *count2, *army1, *count1, catalog);
+    trace_end("attack 2->1", span);
+
+    span = trace_begin();
+    const int dead1 = ccheck_front(*army1, *count1, catalog->max_radius + 1);
+    const int dead2 = ccheck_front(*army2, *count2, catalog->max_radius + 1);
+    trace_end("check_hp", span);
+    trace_end("battle_round", round_start);
+    *army1 += dead1;
+    *count1 -= dead1;
+    *army2 += dead2;
+    *count2 -= dead2;
+
+    if (*count1 == 0 && *count2 == 0) return 0;
+    if (*count1 == 0) return 2;
+    if (*count2 == 0) return 1;
+
+    return -1;
+}
+
+/**
+ * Fills a result structure from the final state of a battle.
+ *
+ * @param result Destination (may be NULL)
+ * @param winner Final result code
+ * @param rounds Number of rounds fought
+ * @param a Surviving units of the first army
+ * @param count1 Number of surviving units of the first army
+ * @param b Surviving units of the second army
+ * @param count2 Number of surviving units of the second army
+ */
+void fill_result(CRESULT *result, int winner, int rounds, const CUNIT *a, int count1, const CUNIT *b, int count2) {
+    if (!result) return;
+
+    result->winner = winner;
+    result->rounds = rounds;
+    result->survivors1 = count1;
+    result->survivors2 = count2;
+    result->hp1 = 0;
+    result->hp2 = 0;
+    for (int i = 0; i < count1; i++) result->hp1 += a[i].hp;
+    for (int i = 0; i < count2; i++) result->hp2 += b[i].hp;
+}
+
+/**
+ * Copies two armies into one working buffer, from the stack if they fit,
+ * otherwise from the arena or the heap.
+ *
+ * @param army1 The first army
+ * @param army2 The second army
+ * @param scratch Caller's stack buffer of 2 * SCRATCH_UNITS units
+ * @param arena Optional arena (may be NULL)
+ * @return The working buffer: army1's units followed by army2's units
+ */
+CUNIT *copy_armies(const CARMY *army1, const CARMY *army2, CUNIT *scratch, ARENA *arena) {
+    CUNIT *units = scratch;
+    const int total = army1->count + army2->count;
+    if (total > 2 * SCRATCH_UNITS) {
+        if (arena) {
+            units = arena_alloc(arena, sizeof(CUNIT) * total);
+        } else {
+            units = malloc(sizeof(CUNIT) * total);
+            if (!units) {
+                error(ERR_MEMORY);
+            }
+        }
+    }
+
+    memcpy(units, army1->units, sizeof(CUNIT) * army1->count);
+    memcpy(units + army1->count, army2->units, sizeof(CUNIT) * army2->count);
+    return units;
+}
+
+/**
+ * Simulates a battle between two compact armies without modifying them.
+ *
+ * @param army1 The first army
+ * @param army2 The second army
+ * @param catalog Catalog the item ids refer to
+ * @param result Optional output with rounds, survivors and remaining HP (may be NULL)
+ * @param arena Optional arena for the working copies of large armies; the
+ *              memory is left to the caller's next arena_reset() (may be NULL)
+ * @return Final result code (0 draw, 1 army 1 wins, 2 army 2 wins)
+ */
+int csimulate(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result, ARENA *arena) {
+    return csimulate_observed(army1, army2, catalog, result, arena, NULL, NULL, NULL);
+}
+
+/**
+ * Returns the total HP of an army.
+ *
+ * @param units The units
+ * @param count Number of units
+ * @return Sum of the units' HP
+ */
+static int64_t army_hp(const CUNIT *units, int count) {
+    int64_t hp = 0;
+    for (int i = 0; i < count; i++) hp += units[i].hp;
+    return hp;
+}
+
+/**
+ * Returns the damage of one hit, like attack(): attack minus defense, at least 1.
+ *
+ * @param att Attack of the item
+ * @param defense Defense of the defender
+ * @return Damage
+ */
+static int hit_damage(int att, int defense) {
+    return att - defense > 1 ? att - defense : 1;
+}
+
+/**
+ * Returns an upper bound on the damage an army can deal per round in this
+ * and every later round. Only positions up to the longest range attack, and
+ * units only move forward, so the strongest max_range + 1 units bound it;
+ * each hit is bounded against the weakest defense among the defenders.
+ *
+ * @param attackers Attacking units
+ * @param attack_count Number of attacking units
+ * @param defenders Defending units
+ * @param defend_count Number of defending units
+ * @param catalog Catalog the item ids refer to
+ * @return Damage bound
+ */
+static int64_t damage_ceiling(const CUNIT *attackers, int attack_count, const CUNIT *defenders, int defend_count,
+                              const CCATALOG *catalog) {
+    int weakest = INT32_MAX;
+    for (int j = 0; j < defend_count; j++) {
+        const int de = unit_defense(&defenders[j], catalog);
+        if (de < weakest) weakest = de;
+    }
+
+    // Keep the largest `keep` per-unit bounds in descending order
+    int64_t best[SCRATCH_UNITS];
+    const int keep = catalog->max_range + 1 < SCRATCH_UNITS ? catalog->max_range + 1 : SCRATCH_UNITS;
+    int kept = 0;
+    for (int i = 0; i < attack_count; i++) {
+        int64_t damage = 0;
+        const uint8_t items[2] = {attackers[i].item1, attackers[i].item2};
+        for (int k = 0; k < 2; k++) {
+            if (items[k] == CITEM_NONE) continue;
+            const CITEM *stats = &catalog->items[items[k]];
+            const int reach = stats->radius + 1 < defend_count ? stats->radius + 1 : defend_count;
+            damage += (int64_t) hit_damage(stats->att, weakest) * reach;
+        }
+        if (attack_count <= keep) {
+            best[kept++] = damage;
+            continue;
+        }
+        if (kept < keep) kept++;
+        else if (damage <= best[kept - 1]) continue;
+        int slot = kept - 1;
+        while (slot > 0 && best[slot - 1] < damage) {
+            best[slot] = best[slot - 1];
+            slot--;
+        }
+        best[slot] = damage;
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < kept; i++) total += best[i];
+    if (catalog->max_range + 1 > keep && kept > 0) {
+        total += best[0] * (catalog->max_range + 1 - keep);
+    }
+    return total;
+}
+
+/**
+ * Returns the damage any unit of an army deals at least when it attacks
+ * from the front, against a defender with the given defense.
+ *
+ * @param attackers Attacking units
+ * @param attack_count Number of attacking units
+ * @param defense Defense of the defender
+ * @param catalog Catalog the item ids refer to
+ * @return Smallest front damage over the attackers (0 if one carries no item)
+ */
+static int weakest_hit(const CUNIT *attackers, int attack_count, int defense, const CCATALOG *catalog) {
+    int weakest = INT32_MAX;
+    for (int i = 0; i < attack_count && weakest > 0; i++) {
+        int damage = 0;
+        if (attackers[i].item1 != CITEM_NONE) damage += hit_damage(catalog->items[attackers[i].item1].att, defense);
+        if (attackers[i].item2 != CITEM_NONE) damage += hit_damage(catalog->items[attackers[i].item2].att, defense);
+        if (damage < weakest) weakest = damage;
+    }
+    return weakest;
+}
+
+/**
+ * Returns a number of rounds within which an army certainly destroys
+ * another, as long as it has units left. Whichever unit is in front attacks
+ * at position 0, which every item reaches, and hits at least the front
+ * defender, so each defender dies after at most ceil(hp / weakest_hit())
+ * rounds at the front.
+ *
+ * @param attackers Attacking units
+ * @param attack_count Number of attacking units
+ * @param defenders Defending units
+ * @param defend_count Number of defending units
+ * @param catalog Catalog the item ids refer to
+ * @return Upper bound on the rounds needed, or INT64_MAX if there is none
+ */
+static int64_t rounds_to_destroy(const CUNIT *attackers, int attack_count, const CUNIT *defenders, int defend_count,
+                                 const CCATALOG *catalog) {
+    // weakest_hit() by defense value, computed once per distinct defense
+    int hits[DECIDE_DEFENSES] = {0};
+    int64_t rounds = 0;
+    for (int j = 0; j < defend_count; j++) {
+        const int defense = unit_defense(&defenders[j], catalog);
+        int hit = defense < DECIDE_DEFENSES ? hits[defense] : 0;
+        if (hit == 0) {
+            hit = weakest_hit(attackers, attack_count, defense, catalog);
+            if (hit == 0) return INT64_MAX;
+            if (defense < DECIDE_DEFENSES) hits[defense] = hit;
+        }
+        rounds += (defenders[j].hp + hit - 1) / hit;
+    }
+    return rounds;
+}
+
+/**
+ * Decides the winner of a battle in progress without fighting it out, when
+ * the bounds prove it: one army destroys the other within T rounds at the
+ * latest (rounds_to_destroy()), while the other needs more than T rounds to
+ * deal the first army's total HP at its damage ceiling. One-on-one battles
+ * are looked up in the catalog's duel table instead. A victory is only
+ * accepted if T fits in the rounds left before the cap; a later one would
+ * be a timeout, which a duel that outlasts the cap reports.
+ *
+ * @param a Units of the first army
+ * @param count1 Number of units of the first army (at least 1)
+ * @param b Units of the second army
+ * @param count2 Number of units of the second army (at least 1)
+ * @param catalog Catalog the item ids refer to
+ * @param budget Rounds left before the battle times out
+ * @return 1 or 2 if that army's victory is certain, RESULT_TIMEOUT if a duel
+ *         certainly outlasts the budget, -1 if neither is proven
+ */
+int decide_outcome(const CUNIT *a, int count1, const CUNIT *b, int count2, const CCATALOG *catalog, int budget) {
+    if (count1 == 1 && count2 == 1 && catalog->duels) {
+        const int winner = duel_outcome(catalog->duels, a, b, budget);
+        if (winner == 1 || winner == 2 || winner == RESULT_TIMEOUT) return winner;
+    }
+    const int64_t rounds1 = rounds_to_destroy(a, count1, b, count2, catalog);
+    if (rounds1 <= budget) {
+        const int64_t ceiling2 = damage_ceiling(b, count2, a, count1, catalog);
+        if (ceiling2 == 0 || rounds1 < (army_hp(a, count1) + ceiling2 - 1) / ceiling2) return 1;
+    }
+    const int64_t rounds2 = rounds_to_destroy(b, count2, a, count1, catalog);
+    if (rounds2 <= budget) {
+        const int64_t ceiling1 = damage_ceiling(a, count1, b, count2, catalog);
+        if (ceiling1 == 0 || rounds2 < (army_hp(b, count2) + ceiling1 - 1) / ceiling1) return 2;
+    }
+    return -1;
+}
+
+/**
+ * Simulates a battle like csimulate(), reporting the surviving units of both
+ * armies to an observer before the first round and after every round,
+ * together with the round number and the result code so far.
+ * With limits, a battle still undecided after max_rounds ends with
+ * RESULT_TIMEOUT, and with decide_early it stops as soon as decide_outcome()
+ * proves the winner. A check costs about as much as a round, so it is made
+ * after DECIDE_FIRST_ROUND rounds and every time the count doubles, and for
+ * large armies only once the rounds fought outweigh the cost of a check.
+ * Either way the result holds the rounds fought and the survivors at that
+ * point. Without an observer, a battle down to one unit per side is
+ * finished from the catalog's duel table in one step.
+ *
+ * @param army1 The first army
+ * @param army2 The second army
+ * @param catalog Catalog the item ids refer to
+ * @param result Optional output with rounds, survivors and remaining HP (may be NULL)
+ * @param arena Optional arena for the working copies of large armies (may be NULL)
+ * @param limits Round cap and early decision (may be NULL for neither)
+ * @param observer Function called with the state of the battle (may be NULL)
+ * @param context Passed through to the observer
+ * @return Final result code (0 draw, 1 army 1 wins, 2 army 2 wins, RESULT_TIMEOUT)
+ */
+int csimulate_observed(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result,
+                       ARENA *arena, const BATTLE_LIMITS *limits, ROUND_OBSERVER observer, void *context) {
+    CUNIT scratch[2 * SCRATCH_UNITS];
+    CUNIT *units = copy_armies(army1, army2, scratch, arena);
+
+    CUNIT *a = units;
+    CUNIT *b = units + army1->count;
+    int count1 = army1->count;
+    int count2 = army2->count;
+
+    int rounds = 0;
+    int winner = -1;
+    if (observer) {
+        observer(context, rounds, winner, a, count1, b, count2);
+    }
+    const int max_rounds = limits && limits->max_rounds > 0 ? limits->max_rounds : INT32_MAX;
+    const bool decide_early = limits && limits->decide_early;
+    const int64_t round_work = (int64_t) 2 * (catalog->max_range + 1) * (catalog->max_radius + 1);
+    while (winner == -1) {
+        if (count1 == 1 && count2 == 1 && catalog->duels && !observer) {
+            winner = duel_finish(catalog->duels, a, b, &rounds, max_rounds);
+            if (winner != -1) {
+                count1 = a->hp > 0;
+                count2 = b->hp > 0;
+                break;
+            }
+        }
+        if (decide_early && rounds >= DECIDE_FIRST_ROUND && (rounds & (rounds - 1)) == 0 &&
+            (int64_t) (rounds + 1) * round_work >= count1 + count2) {
+            winner = decide_outcome(a, count1, b, count2, catalog, max_rounds - rounds);
+        }
+        if (winner == -1 && rounds == max_rounds) {
+            winner = RESULT_TIMEOUT;
+        }
+        if (winner == -1) {
+            winner = cbattle_round(&a, &count1, &b, &count2, catalog);
+            rounds++;
+        }
+        if (observer) {
+            observer(context, rounds, winner, a, count1, b, count2);
+        }
+    }
+    fill_result(result, winner, rounds, a, count1, b, count2);
+
+    if (units != scratch && !arena) {
+        free(units);
+    }
+    return winner;
+}
+
+/**
+ * Reads the resident set size of the current process.
+ *
+ * @return Resident memory in bytes, or 0 if it cannot be determined
+ */
+static size_t resident_bytes(void) {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+
+    unsigned long size = 0, resident = 0;
+    if (fscanf(statm, "%lu %lu", &size, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(statm);
+    return (size_t) resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Measures and prints the memory used per army by the UI representation (ARMY)
+ * and the compact combat representation (CARMY).
+ * Allocates the given number of full armies in each form, fills them and
+ * reports the growth of the resident set divided by the army count, next to
+ * the static structure sizes.
+ *
+ * @param armies Number of armies to allocate for the measurement
+ * @param out Stream to print the report to
+ */
+void report_army_memory(int armies, FILE *out) {
+    if (item_list.count == 0) {
+        error(ERR_ITEM_COUNT);
+    }
+
+    ARMY sample;
+    init_army(&sample);
+    for (int i = 0; i < MAX_ARMY; i++) {
+        UNIT unit = {0};
+        snprintf(unit.name, sizeof(unit.name), "unit-%d", i);
+        unit.item1 = &item_list.items[i % item_list.count];
+        unit.hp = 100;
+        push(&sample, unit);
+    }
+
+    size_t before = resident_bytes();
+    ARMY *full = malloc(sizeof(ARMY) * (size_t) armies);
+    if (!full) {
+        error(ERR_MEMORY);
+    }
+    for (int i = 0; i < armies; i++) {
+        full[i] = sample;
+    }
+    const size_t full_bytes = resident_bytes() - before;
+
+    const size_t stride = carmy_size(MAX_ARMY);
+    before = resident_bytes();
+    uint8_t *packed = malloc(stride * (size_t) armies);
+    if (!packed) {
+        error(ERR_MEMORY);
+    }
+    for (int i = 0; i < armies; i++) {
+        compact_army(&full[i], (CARMY *) (packed + stride * i));
+    }
+    const size_t packed_bytes = resident_bytes() - before;
+
+    int names;
+    const size_t name_bytes = intern_memory(&names);
+
+    fprintf(out, "Army memory (%d armies of %d units)\n", armies, MAX_ARMY);
+    fprintf(out, "  UNIT   %4zu bytes/unit   ARMY  %5zu bytes/army   measured %8.1f bytes/army\n",
+            sizeof(UNIT), sizeof(ARMY), armies ? (double) full_bytes / armies : 0.0);
+    fprintf(out, "  CUNIT  %4zu bytes/unit   CARMY %5zu bytes/army   measured %8.1f bytes/army\n",
+            sizeof(CUNIT), stride, armies ? (double) packed_bytes / armies : 0.0);
+    fprintf(out, "  name table: %d names, %zu bytes shared\n", names, name_bytes);
+
+    free(packed);
+    free(full);
+}
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define COMPARE_CHUNK 256
+
+/**
+ * One catalog under evaluation. Its combat table is indexed by the item ids
+ * of the live catalog, which the armies of the roster refer to, so every
+ * catalog plays the same compact armies.
+ */
+typedef struct {
+    const char *path;
+    CCATALOG catalog;
+    bool changed[NUMBER_OF_ITEMS];
+    bool missing[NUMBER_OF_ITEMS];
+    int added;
+    bool *legal;
+    int excluded;
+    uint32_t (*score)[3];
+    uint64_t played;
+    uint64_t flipped;
+} CANDIDATE;
+
+/**
+ * State shared by the threads of a comparison.
+ */
+typedef struct {
+    const ROSTER *roster;
+    CANDIDATE *candidates;
+    int count;
+    uint64_t matchups;
+    atomic_uint_fast64_t next;
+    pthread_mutex_t lock;
+} COMPARISON;
+
+/**
+ * Builds a candidate from a catalog file. Items are matched to the live
+ * catalog by name. The candidate starts as a copy of the live combat table
+ * and only the entries of items whose stats differ are overwritten; items
+ * the candidate drops keep their live entry but make the armies carrying
+ * them ineligible, and items it adds are unused since no army refers to them.
+ *
+ * @param path Path of the catalog file
+ * @param candidate Destination
+ */
+static void load_candidate(const char *path, CANDIDATE *candidate) {
+    FILE *json = fopen(path, "r");
+    if (!json) {
+        error(ERR_FILE);
+    }
+    ITEM storage[NUMBER_OF_ITEMS];
+    ITEM_LIST list = {storage, 0};
+    parse_items(json, &list);
+    fclose(json);
+
+    candidate->path = path;
+    ITEM items[NUMBER_OF_ITEMS];
+    memcpy(items, item_list.items, sizeof(ITEM) * item_list.count);
+    int matched = 0;
+    for (int i = 0; i < item_list.count; i++) {
+        const ITEM *live = &item_list.items[i];
+        const ITEM *found = NULL;
+        for (int j = 0; j < list.count && !found; j++) {
+            if (strcasecmp(list.items[j].name, live->name) == 0) found = &list.items[j];
+        }
+        if (!found) {
+            candidate->missing[i] = true;
+            continue;
+        }
+        matched++;
+        candidate->changed[i] = found->att != live->att || found->def != live->def || found->slots != live->slots ||
+                                found->range != live->range || found->radius != live->radius;
+        if (candidate->changed[i]) {
+            items[i] = *found;
+        }
+    }
+    candidate->added = list.count - matched;
+
+    const ITEM_LIST aligned = {items, item_list.count};
+    compile_catalog(&aligned, &candidate->catalog);
+}
+
+/**
+ * Decides which armies can play under a catalog: every item they carry must
+ * exist in it, and every unit must still fit its items into two slots.
+ *
+ * @param candidate The catalog
+ * @param roster The armies
+ */
+static void find_legal(CANDIDATE *candidate, const ROSTER *roster) {
+    candidate->legal = malloc(sizeof(bool) * roster->count);
+    candidate->score = calloc(roster->count, sizeof(*candidate->score));
+    if (!candidate->legal || !candidate->score) {
+        error(ERR_MEMORY);
+    }
+    for (int a = 0; a < roster->count; a++) {
+        const CARMY *army = roster->armies[a];
+        bool legal = true;
+        for (int i = 0; i < army->count && legal; i++) {
+            const uint8_t items[2] = {army->units[i].item1, army->units[i].item2};
+            int slots = 0;
+            for (int k = 0; k < 2; k++) {
+                if (items[k] == CITEM_NONE) continue;
+                legal &= !candidate->missing[items[k]];
+                slots += candidate->catalog.items[items[k]].slots;
+            }
+            legal &= slots <= 2;
+        }
+        candidate->legal[a] = legal;
+        candidate->excluded += !legal;
+    }
+}
+
+/**
+ * Comparison thread: claims chunks of matchups and plays each one under
+ * every catalog in turn, while both armies are still in cache. Standings
+ * are kept per thread and added to the shared tables at the end.
+ *
+ * @param arg Pointer to the COMPARISON structure
+ * @return Always NULL
+ */
+static void *compare_main(void *arg) {
+    COMPARISON *comparison = arg;
+    const ROSTER *roster = comparison->roster;
+    const int count = comparison->count;
+    trace_thread_name("compare worker");
+
+    ARENA scratch;
+    arena_init(&scratch, 0);
+    uint32_t (*score)[3] = calloc((size_t) count * roster->count, sizeof(*score));
+    uint64_t *played = calloc(count, sizeof(uint64_t));
+    uint64_t *flipped = calloc(count, sizeof(uint64_t));
+    if (!score || !played || !flipped) {
+        error(ERR_MEMORY);
+    }
+
+    while (1) {
+        const uint64_t start = atomic_fetch_add(&comparison->next, COMPARE_CHUNK);
+        if (start >= comparison->matchups) break;
+        const uint64_t end = start + COMPARE_CHUNK < comparison->matchups ? start + COMPARE_CHUNK
+                                                                          : comparison->matchups;
+
+        int a, b;
+        matchup_pair(start, roster->count, &a, &b);
+        for (uint64_t id = start; id < end; id++) {
+            int live = -1;
+            for (int c = 0; c < count; c++) {
+                const CANDIDATE *candidate = &comparison->candidates[c];
+                if (!candidate->legal[a] || !candidate->legal[b]) continue;
+
+                CRESULT result;
+                csimulate(roster->armies[a], roster->armies[b], &candidate->catalog, &result, &scratch);
+                record_score(score + (size_t) c * roster->count, a, b, result.winner);
+                played[c]++;
+                if (c == 0) {
+                    live = result.winner;
+                } else if (live != -1 && result.winner != live) {
+                    flipped[c]++;
+                }
+            }
+            if (++b == roster->count) {
+                a++;
+                b = a + 1;
+            }
+        }
+        arena_reset(&scratch);
+    }
+
+    pthread_mutex_lock(&comparison->lock);
+    for (int c = 0; c < count; c++) {
+        CANDIDATE *candidate = &comparison->candidates[c];
+        for (int i = 0; i < roster->count; i++) {
+            for (int k = 0; k < 3; k++) {
+                candidate->score[i][k] += score[(size_t) c * roster->count + i][k];
+            }
+        }
+        candidate->played += played[c];
+        candidate->flipped += flipped[c];
+    }
+    pthread_mutex_unlock(&comparison->lock);
+
+    free(flipped);
+    free(played);
+    free(score);
+    arena_free(&scratch);
+    return NULL;
+}
+
+/**
+ * Returns the win rate in a score table of the armies carrying an item.
+ *
+ * @param roster The armies
+ * @param candidate The catalog whose standings to use
+ * @param item Item id
+ * @param armies Output number of eligible armies carrying the item
+ * @return Win rate in percent, or -1 if those armies played no battle
+ */
+static double item_win_rate(const ROSTER *roster, const CANDIDATE *candidate, int item, int *armies) {
+    uint64_t played = 0, wins = 0;
+    *armies = 0;
+    for (int a = 0; a < roster->count; a++) {
+        if (!candidate->legal[a]) continue;
+        const CARMY *army = roster->armies[a];
+        bool carries = false;
+        for (int i = 0; i < army->count && !carries; i++) {
+            carries = army->units[i].item1 == item || army->units[i].item2 == item;
+        }
+        if (!carries) continue;
+        (*armies)++;
+        played += candidate->score[a][0] + candidate->score[a][1] + candidate->score[a][2];
+        wins += candidate->score[a][0];
+    }
+    return played ? 100.0 * (double) wins / (double) played : -1.0;
+}
+
+/**
+ * Prints the win rate column headings: the live catalog first, then each
+ * candidate with its change against the live catalog.
+ *
+ * @param out Stream to print to
+ * @param count Number of candidate catalogs
+ */
+static void print_header(FILE *out, int count) {
+    fprintf(out, " %15s", "live win%");
+    for (int c = 1; c <= count; c++) {
+        char heading[32];
+        snprintf(heading, sizeof(heading), "#%d win%%   delta", c);
+        fprintf(out, " %15s", heading);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Prints one win rate column entry, or a dash when there is none.
+ *
+ * @param out Stream to print to
+ * @param rate Win rate in percent, or a negative value
+ * @param base Win rate under the live catalog, or a negative value
+ */
+static void print_rate(FILE *out, double rate, double base) {
+    if (rate < 0) {
+        fprintf(out, " %15s", "-");
+    } else if (base < 0) {
+        fprintf(out, " %14.2f%%", rate);
+    } else {
+        fprintf(out, " %6.2f%% %+7.2f", rate, rate - base);
+    }
+}
+
+/**
+ * Plays every matchup of a roster under the live catalog and under each
+ * candidate catalog in a single parallel pass and prints the results side
+ * by side: a summary per catalog, the win rate of the armies carrying each
+ * item and the standings of every army.
+ *
+ * @param roster_path Path of the roster file
+ * @param paths Paths of the candidate catalog files
+ * @param count Number of candidate catalogs
+ * @param threads Number of threads (0 for one per CPU)
+ * @return 0 on success
+ */
+int run_compare(const char *roster_path, const char *const *paths, int count, int threads) {
+    FILE *file = fopen(roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+    if (roster.count < 2 || count < 1) {
+        error(ERR_UNIT_COUNT);
+    }
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    COMPARISON comparison = {0};
+    comparison.roster = &roster;
+    comparison.count = count + 1;
+    comparison.matchups = matchup_count(roster.count);
+    comparison.candidates = calloc(comparison.count, sizeof(CANDIDATE));
+    if (!comparison.candidates) {
+        error(ERR_MEMORY);
+    }
+    comparison.candidates[0].path = "live";
+    comparison.candidates[0].catalog = combat_catalog;
+    for (int c = 1; c <= count; c++) {
+        load_candidate(paths[c - 1], &comparison.candidates[c]);
+    }
+    for (int c = 0; c <= count; c++) {
+        find_legal(&comparison.candidates[c], &roster);
+    }
+    atomic_init(&comparison.next, 0);
+    pthread_mutex_init(&comparison.lock, NULL);
+
+    const double started = now_seconds();
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    if (!ids) {
+        error(ERR_MEMORY);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&ids[t], NULL, compare_main, &comparison);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+    const double elapsed = now_seconds() - started;
+
+    uint64_t battles = 0;
+    for (int c = 0; c <= count; c++) {
+        const CANDIDATE *candidate = &comparison.candidates[c];
+        battles += candidate->played;
+        if (c == 0) {
+            printf("Catalog 0: live\n");
+        } else {
+            printf("Catalog %d: %s\n", c, candidate->path);
+            printf("  changed:");
+            int changed = 0;
+            for (int i = 0; i < item_list.count; i++) {
+                if (candidate->changed[i]) {
+                    printf(" %s", item_list.items[i].name);
+                    changed++;
+                }
+            }
+            printf("%s\n", changed ? "" : " none");
+            printf("  dropped:");
+            int dropped = 0;
+            for (int i = 0; i < item_list.count; i++) {
+                if (candidate->missing[i]) {
+                    printf(" %s", item_list.items[i].name);
+                    dropped++;
+                }
+            }
+            printf("%s; %d new items (unused by the roster)\n", dropped ? "" : " none", candidate->added);
+        }
+        printf("  %llu battles, %d of %d armies excluded", (unsigned long long) candidate->played,
+               candidate->excluded, roster.count);
+        if (c > 0) {
+            printf(", %llu outcomes differ from the live catalog", (unsigned long long) candidate->flipped);
+        }
+        printf("\n");
+    }
+
+    printf("\n%-12s", "Item");
+    print_header(stdout, count);
+    for (int i = 0; i < item_list.count; i++) {
+        int armies;
+        const double base = item_win_rate(&roster, &comparison.candidates[0], i, &armies);
+        printf("%-12.12s", item_list.items[i].name);
+        print_rate(stdout, base, -1);
+        for (int c = 1; c <= count; c++) {
+            print_rate(stdout, item_win_rate(&roster, &comparison.candidates[c], i, &armies), base);
+        }
+        printf("\n");
+    }
+
+    printf("\n%-6s %-16s %6s", "Army", "Leader", "Units");
+    print_header(stdout, count);
+    for (int a = 0; a < roster.count; a++) {
+        printf("%-6d %-16.16s %6d", a + 1, interned_name(roster.armies[a]->units[0].name), roster.armies[a]->count);
+        double base = -1;
+        for (int c = 0; c <= count; c++) {
+            const CANDIDATE *candidate = &comparison.candidates[c];
+            const uint32_t *s = candidate->score[a];
+            const uint32_t played = s[0] + s[1] + s[2];
+            const double rate = candidate->legal[a] && played ? 100.0 * s[0] / played : -1.0;
+            print_rate(stdout, rate, base);
+            if (c == 0) base = rate;
+        }
+        printf("\n");
+    }
+
+    printf("\n%d catalogs x %llu matchups: %llu battles in %.3f s on %d threads (%.0f battles/s)\n", count + 1,
+           (unsigned long long) comparison.matchups, (unsigned long long) battles, elapsed, threads,
+           elapsed > 0 ? battles / elapsed : 0.0);
+
+    for (int c = 0; c <= count; c++) {
+        free(comparison.candidates[c].legal);
+        free(comparison.candidates[c].score);
+    }
+    pthread_mutex_destroy(&comparison.lock);
+    free(comparison.candidates);
+    free_roster(&roster);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+/**
+ * Opens one hardware counter of the calling thread, counting user space only.
+ *
+ * @param config PERF_COUNT_HW_* event
+ * @return File descriptor, or -1 with errno set
+ */
+static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Starts counting last-level cache references and misses on the calling
+ * thread. Counters are often unavailable (virtual machines, a restrictive
+ * perf_event_paranoid); the reason is then kept for the report and reads
+ * return zero.
+ *
+ * @param counters The counters
+ * @return true if both counters are running
+ */
+bool cache_counters_open(CACHE_COUNTERS *counters) {
+    counters->references = open_counter(PERF_COUNT_HW_CACHE_REFERENCES);
+    counters->misses = counters->references >= 0 ? open_counter(PERF_COUNT_HW_CACHE_MISSES) : -1;
+    counters->error = counters->misses >= 0 ? 0 : errno;
+    if (counters->misses < 0 && counters->references >= 0) {
+        close(counters->references);
+        counters->references = -1;
+    }
+    return counters->misses >= 0;
+}
+
+/**
+ * Stops the counters of a thread and adds their counts to a total.
+ *
+ * @param counters The counters
+ * @param total Totals to add to; its error is set if these counters failed
+ */
+void cache_counters_close(CACHE_COUNTERS *counters, CACHE_STATS *total) {
+    if (counters->misses < 0) {
+        total->error = counters->error;
+        return;
+    }
+    uint64_t references = 0, misses = 0;
+    if (read(counters->references, &references, sizeof(references)) == sizeof(references) &&
+        read(counters->misses, &misses, sizeof(misses)) == sizeof(misses)) {
+        total->references += references;
+        total->misses += misses;
+    }
+    close(counters->references);
+    close(counters->misses);
+}
+
+/**
+ * Prints the last-level cache miss rate of a run.
+ *
+ * @param stats Totals over all threads
+ * @param battles Battles fought
+ * @param out Stream to print to
+ */
+void print_cache_stats(const CACHE_STATS *stats, uint64_t battles, FILE *out) {
+    if (stats->error) {
+        // perf_event_open() reports events the hardware or hypervisor does not expose as ENOENT
+        fprintf(out, "Cache counters unavailable: %s\n",
+                stats->error == ENOENT ? "no hardware cache events on this machine" : strerror(stats->error));
+        return;
+    }
+    fprintf(out, "Last-level cache: %llu misses of %llu references (%.2f%%), %.2f misses per battle\n",
+            (unsigned long long) stats->misses, (unsigned long long) stats->references,
+            stats->references ? 100.0 * (double) stats->misses / (double) stats->references : 0.0,
+            battles ? (double) stats->misses / (double) battles : 0.0);
+}
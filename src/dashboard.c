@@ -0,0 +1,263 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define DASHBOARD_FRAME_US 100000
+#define DASHBOARD_UNITS 5
+#define TILE_WIDTH 20
+#define TILE_HEIGHT 3
+#define HEADER_HEIGHT 3
+
+/**
+ * Snapshot of one battle as shown in a tile.
+ * Written by one engine thread under a sequence lock: `seq` is odd while an
+ * update is in progress, so the renderer can detect torn reads and retry.
+ */
+typedef struct {
+    atomic_uint seq;
+    atomic_uint frame;
+    int a;
+    int b;
+    int round;
+    int winner;
+    int count[2];
+    int16_t hp[2][DASHBOARD_UNITS];
+} DASHBOARD_TILE;
+
+/**
+ * Shared state between engine threads publishing battles and the renderer.
+ */
+struct dashboard {
+    DASHBOARD_TILE *tiles;
+    int tile_count;
+    int threads;
+    uint64_t total;
+    double started;
+    atomic_uint frame;
+    atomic_uint_fast64_t completed;
+};
+
+/**
+ * Creates a dashboard.
+ *
+ * @param tiles Number of battle tiles
+ * @param threads Number of engine threads that will publish battles
+ * @param total Number of battles of the run, for the progress header
+ * @return The new dashboard
+ */
+DASHBOARD *dashboard_new(int tiles, int threads, uint64_t total) {
+    DASHBOARD *dash = calloc(1, sizeof(DASHBOARD));
+    if (!dash) {
+        error(ERR_MEMORY);
+    }
+    dash->tiles = calloc(tiles, sizeof(DASHBOARD_TILE));
+    if (!dash->tiles) {
+        error(ERR_MEMORY);
+    }
+    dash->tile_count = tiles;
+    dash->threads = threads;
+    dash->total = total;
+    dash->started = now_seconds();
+    atomic_init(&dash->frame, 1);
+    atomic_init(&dash->completed, 0);
+    for (int i = 0; i < tiles; i++) {
+        dash->tiles[i].winner = -2;
+    }
+    return dash;
+}
+
+/**
+ * Releases a dashboard.
+ *
+ * @param dash The dashboard
+ */
+void dashboard_free(DASHBOARD *dash) {
+    free(dash->tiles);
+    free(dash);
+}
+
+/**
+ * Asks for a tile to show the next battle of an engine thread.
+ * Thread `worker` owns tiles worker, worker + threads, ... and cycles through
+ * them. A tile accepts one battle per rendered frame; between frames this
+ * returns NULL, so almost every battle runs unobserved.
+ *
+ * @param dash The dashboard (may be NULL)
+ * @param worker Index of the calling engine thread
+ * @param cursor The thread's position in its tile cycle
+ * @param a Index of the first army
+ * @param b Index of the second army
+ * @return Observer context for dashboard_observe(), or NULL
+ */
+void *dashboard_claim(DASHBOARD *dash, int worker, int *cursor, int a, int b) {
+    if (!dash || worker >= dash->tile_count) return NULL;
+
+    const int owned = (dash->tile_count - worker + dash->threads - 1) / dash->threads;
+    DASHBOARD_TILE *tile = &dash->tiles[worker + (*cursor % owned) * dash->threads];
+    const unsigned frame = atomic_load_explicit(&dash->frame, memory_order_relaxed);
+    if (atomic_load_explicit(&tile->frame, memory_order_relaxed) == frame) return NULL;
+
+    atomic_store_explicit(&tile->frame, frame, memory_order_relaxed);
+    *cursor = (*cursor + 1) % owned;
+
+    const unsigned seq = atomic_load_explicit(&tile->seq, memory_order_relaxed);
+    atomic_store_explicit(&tile->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    tile->a = a;
+    tile->b = b;
+    atomic_store_explicit(&tile->seq, seq + 2, memory_order_release);
+    return tile;
+}
+
+/**
+ * Round observer publishing a battle into its tile (see csimulate_observed()).
+ *
+ * @param context Tile returned by dashboard_claim()
+ * @param round Rounds fought so far
+ * @param winner Result code so far
+ * @param a Surviving units of the first army
+ * @param count1 Number of surviving units of the first army
+ * @param b Surviving units of the second army
+ * @param count2 Number of surviving units of the second army
+ */
+void dashboard_observe(void *context, int round, int winner, const CUNIT *a, int count1, const CUNIT *b, int count2) {
+    DASHBOARD_TILE *tile = context;
+
+    const unsigned seq = atomic_load_explicit(&tile->seq, memory_order_relaxed);
+    atomic_store_explicit(&tile->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    tile->round = round;
+    tile->winner = winner;
+    tile->count[0] = count1;
+    tile->count[1] = count2;
+    for (int i = 0; i < DASHBOARD_UNITS; i++) {
+        tile->hp[0][i] = i < count1 ? a[i].hp : 0;
+        tile->hp[1][i] = i < count2 ? b[i].hp : 0;
+    }
+
+    atomic_store_explicit(&tile->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * Adds finished battles to the progress counter.
+ *
+ * @param dash The dashboard (may be NULL)
+ * @param battles Number of battles finished
+ */
+void dashboard_progress(DASHBOARD *dash, uint64_t battles) {
+    if (dash) {
+        atomic_fetch_add_explicit(&dash->completed, battles, memory_order_relaxed);
+    }
+}
+
+/**
+ * Copies a consistent snapshot of a tile.
+ *
+ * @param tile The tile
+ * @param copy Destination
+ */
+static void read_tile(DASHBOARD_TILE *tile, DASHBOARD_TILE *copy) {
+    while (1) {
+        const unsigned before = atomic_load_explicit(&tile->seq, memory_order_acquire);
+        if (before & 1) continue;
+        copy->a = tile->a;
+        copy->b = tile->b;
+        copy->round = tile->round;
+        copy->winner = tile->winner;
+        memcpy(copy->count, tile->count, sizeof(copy->count));
+        memcpy(copy->hp, tile->hp, sizeof(copy->hp));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&tile->seq, memory_order_relaxed) == before) return;
+    }
+}
+
+/**
+ * Draws one side of a tile: a short HP gauge per front unit and the number
+ * of units not shown.
+ *
+ * @param y Row
+ * @param x Column
+ * @param side 0 for army 1, 1 for army 2
+ * @param tile Tile snapshot
+ */
+static void draw_tile_side(int y, int x, int side, const DASHBOARD_TILE *tile) {
+    attron(COLOR_PAIR(side == 0 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
+    mvprintw(y, x, "%d", side + 1);
+    attroff(COLOR_PAIR(side == 0 ? COLOR_ARMY1 : COLOR_ARMY2) | A_BOLD);
+
+    for (int i = 0; i < DASHBOARD_UNITS && i < tile->count[side]; i++) {
+        draw_hp_gauge(y, x + 2 + 3 * i, tile->hp[side][i] * 100 / UNIT_HP, 2);
+    }
+    if (tile->count[side] > DASHBOARD_UNITS) {
+        mvprintw(y, x + 2 + 3 * DASHBOARD_UNITS, "+");
+    }
+}
+
+/**
+ * Draws the throughput header and as many tiles as fit on the screen.
+ *
+ * @param dash The dashboard
+ */
+static void render(DASHBOARD *dash) {
+    const uint64_t completed = atomic_load_explicit(&dash->completed, memory_order_relaxed);
+    const double elapsed = now_seconds() - dash->started;
+
+    erase();
+    attron(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+    mvprintw(0, 1, "TOURNAMENT");
+    attroff(COLOR_PAIR(COLOR_TITLE) | A_BOLD);
+    mvprintw(0, 13, "%llu/%llu battles (%.1f%%)  %.0f battles/s  %.1f s  %d threads",
+             (unsigned long long) completed, (unsigned long long) dash->total,
+             dash->total ? 100.0 * completed / dash->total : 100.0,
+             elapsed > 0 ? completed / elapsed : 0.0, elapsed, dash->threads);
+
+    const int columns = COLS / TILE_WIDTH > 0 ? COLS / TILE_WIDTH : 1;
+    const int rows = (LINES - HEADER_HEIGHT) / TILE_HEIGHT;
+    const int shown = columns * rows < dash->tile_count ? columns * rows : dash->tile_count;
+    for (int t = 0; t < shown; t++) {
+        DASHBOARD_TILE tile;
+        read_tile(&dash->tiles[t], &tile);
+        if (tile.winner == -2) continue;
+
+        const int y = HEADER_HEIGHT - 1 + (t / columns) * TILE_HEIGHT;
+        const int x = (t % columns) * TILE_WIDTH;
+        mvprintw(y, x, "%d-%d", tile.a + 1, tile.b + 1);
+        if (tile.winner == -1) {
+            attron(COLOR_PAIR(COLOR_BATTLE_INFO));
+            mvprintw(y, x + 11, "R%d", tile.round);
+            attroff(COLOR_PAIR(COLOR_BATTLE_INFO));
+        } else {
+            const int color = tile.winner == 1 ? COLOR_ARMY1 : tile.winner == 2 ? COLOR_ARMY2 : COLOR_TITLE;
+            attron(COLOR_PAIR(color) | A_BOLD);
+            mvprintw(y, x + 11, tile.winner == 0 ? "DRAW" : tile.winner == RESULT_TIMEOUT ? "TIME" : "WIN %d",
+                     tile.winner);
+            attroff(COLOR_PAIR(color) | A_BOLD);
+        }
+        draw_tile_side(y + 1, x, 0, &tile);
+        draw_tile_side(y + 2, x, 1, &tile);
+    }
+    if (shown < dash->tile_count) {
+        mvprintw(LINES - 1, 1, "Showing %d of %d battles; enlarge the terminal to see more", shown, dash->tile_count);
+    }
+    refresh();
+}
+
+/**
+ * Renders the dashboard at a fixed frame rate until every battle of the run
+ * has finished. Runs on its own thread (normally the main thread), so the
+ * engine threads never wait for the terminal.
+ *
+ * @param dash The dashboard
+ */
+void dashboard_watch(DASHBOARD *dash) {
+    while (atomic_load_explicit(&dash->completed, memory_order_relaxed) < dash->total) {
+        render(dash);
+        atomic_fetch_add_explicit(&dash->frame, 1, memory_order_relaxed);
+        usleep(DASHBOARD_FRAME_US);
+    }
+    render(dash);
+}
@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+#define DUEL_NONE NUMBER_OF_ITEMS
+#define DUEL_ILLEGAL 0xFF
+
+/**
+ * Outcome of every one-on-one fight between two legal loadouts. Facing each
+ * other alone, both units attack from position 0, which every item reaches,
+ * and hit only each other, so a fight is fixed by the damage each side deals
+ * per round and the HP it must take off. Tables depend only on attack,
+ * defense and slots, and are shared by every catalog with the same values.
+ */
+struct duel_table {
+    uint64_t version;
+    int count;
+    uint8_t id[NUMBER_OF_ITEMS + 1][NUMBER_OF_ITEMS + 1];
+    uint16_t *damage;
+    uint8_t *kill;
+    DUEL_TABLE *next;
+};
+
+static DUEL_TABLE *duel_tables;
+static pthread_mutex_t duel_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Hashes the item statistics a duel table depends on.
+ *
+ * @param catalog The catalog
+ * @return Version of the catalog as far as duels are concerned
+ */
+static uint64_t duel_version(const CCATALOG *catalog) {
+    uint64_t h = mix64((uint64_t) catalog->count);
+    for (int i = 0; i < catalog->count; i++) {
+        const CITEM *item = &catalog->items[i];
+        h = mix64(h ^ ((uint64_t) (uint32_t) item->att | (uint64_t) (uint32_t) item->def << 32));
+        h = mix64(h ^ (uint64_t) (uint32_t) item->slots);
+    }
+    return h;
+}
+
+/**
+ * Returns the damage one loadout deals per round to another: attack minus
+ * defense for each item, at least 1.
+ *
+ * @param catalog The catalog
+ * @param attacker Item ids of the attacker (CITEM_NONE for an empty hand)
+ * @param defender Item ids of the defender
+ * @return Damage per round
+ */
+static int loadout_damage(const CCATALOG *catalog, const uint8_t *attacker, const uint8_t *defender) {
+    int defense = 0;
+    for (int k = 0; k < 2; k++) {
+        if (defender[k] != CITEM_NONE) defense += catalog->items[defender[k]].def;
+    }
+    int damage = 0;
+    for (int k = 0; k < 2; k++) {
+        if (attacker[k] == CITEM_NONE) continue;
+        const int att = catalog->items[attacker[k]].att;
+        damage += att - defense > 1 ? att - defense : 1;
+    }
+    return damage;
+}
+
+/**
+ * Builds the duel table of a catalog: the legal loadouts (one or two items
+ * within two slots, in either order), the damage per round between every
+ * pair of them and the rounds needed to kill at every HP from 1 to UNIT_HP.
+ *
+ * @param catalog The catalog
+ * @param version Its duel version
+ * @return The new table
+ */
+static DUEL_TABLE *build_duel_table(const CCATALOG *catalog, uint64_t version) {
+    const uint64_t span = trace_begin();
+    DUEL_TABLE *table = calloc(1, sizeof(DUEL_TABLE));
+    if (!table) {
+        error(ERR_MEMORY);
+    }
+    table->version = version;
+    memset(table->id, DUEL_ILLEGAL, sizeof(table->id));
+
+    uint8_t loadouts[NUMBER_OF_ITEMS * (NUMBER_OF_ITEMS + 3) / 2][2];
+    for (int i = 0; i < catalog->count; i++) {
+        for (int j = i; j <= catalog->count; j++) {
+            const int second = j == catalog->count ? DUEL_NONE : j;
+            const int slots = catalog->items[i].slots + (second == DUEL_NONE ? 0 : catalog->items[j].slots);
+            if (slots > 2) continue;
+            loadouts[table->count][0] = (uint8_t) i;
+            loadouts[table->count][1] = second == DUEL_NONE ? CITEM_NONE : (uint8_t) j;
+            table->id[i][second] = table->id[second][i] = (uint8_t) table->count;
+            table->count++;
+        }
+    }
+
+    const int n = table->count;
+    table->damage = malloc(sizeof(uint16_t) * n * n);
+    table->kill = malloc((size_t) n * n * UNIT_HP);
+    if (!table->damage || !table->kill) {
+        error(ERR_MEMORY);
+    }
+    for (int x = 0; x < n; x++) {
+        for (int y = 0; y < n; y++) {
+            const int damage = loadout_damage(catalog, loadouts[x], loadouts[y]);
+            table->damage[x * n + y] = (uint16_t) (damage < UINT16_MAX ? damage : UINT16_MAX);
+            uint8_t *kill = &table->kill[((size_t) x * n + y) * UNIT_HP];
+            for (int hp = 1; hp <= UNIT_HP; hp++) {
+                kill[hp - 1] = (uint8_t) ((hp + damage - 1) / damage);
+            }
+        }
+    }
+    trace_end("build duel table", span);
+    return table;
+}
+
+/**
+ * Returns the duel table for a compiled catalog, building it on first use.
+ * Tables are kept for the life of the process and shared between catalogs
+ * whose attack, defense and slot values are the same.
+ *
+ * @param catalog The catalog
+ * @return The table
+ */
+const DUEL_TABLE *duel_table_get(const CCATALOG *catalog) {
+    const uint64_t version = duel_version(catalog);
+    pthread_mutex_lock(&duel_lock);
+    DUEL_TABLE *table = duel_tables;
+    while (table && table->version != version) table = table->next;
+    if (!table) {
+        table = build_duel_table(catalog, version);
+        table->next = duel_tables;
+        duel_tables = table;
+    }
+    pthread_mutex_unlock(&duel_lock);
+    return table;
+}
+
+/**
+ * Returns the table index of a unit's loadout.
+ *
+ * @param table The table
+ * @param unit The unit
+ * @return Loadout index, or -1 if the loadout is not legal
+ */
+static int loadout_of(const DUEL_TABLE *table, const CUNIT *unit) {
+    const int first = unit->item1 == CITEM_NONE ? DUEL_NONE : unit->item1;
+    const int second = unit->item2 == CITEM_NONE ? DUEL_NONE : unit->item2;
+    if (first > DUEL_NONE || second > DUEL_NONE) return -1;
+    const int id = table->id[first][second];
+    return id == DUEL_ILLEGAL ? -1 : id;
+}
+
+/**
+ * Fights out a one-on-one battle from the table instead of round by round.
+ * Both units lose their HP as if the rounds had been fought; a unit at 0 HP
+ * or below is dead, as after battle_round().
+ *
+ * @param table The table
+ * @param a The unit of the first army (alive)
+ * @param b The unit of the second army (alive)
+ * @param rounds In/out number of rounds fought
+ * @param max_rounds Round at which the battle times out
+ * @return Result code (0 draw, 1, 2 or RESULT_TIMEOUT), or -1 if a loadout or
+ *         HP is outside the table and the battle must be fought normally
+ */
+int duel_finish(const DUEL_TABLE *table, CUNIT *a, CUNIT *b, int *rounds, int max_rounds) {
+    const int x = loadout_of(table, a);
+    const int y = loadout_of(table, b);
+    if (x < 0 || y < 0 || a->hp < 1 || a->hp > UNIT_HP || b->hp < 1 || b->hp > UNIT_HP) return -1;
+
+    const int n = table->count;
+    const int kill1 = table->kill[((size_t) x * n + y) * UNIT_HP + b->hp - 1];
+    const int kill2 = table->kill[((size_t) y * n + x) * UNIT_HP + a->hp - 1];
+    int fought = kill1 < kill2 ? kill1 : kill2;
+    int winner = kill1 < kill2 ? 1 : kill2 < kill1 ? 2 : 0;
+    if (fought > max_rounds - *rounds) {
+        fought = max_rounds - *rounds;
+        winner = RESULT_TIMEOUT;
+    }
+
+    const int hp1 = a->hp - fought * table->damage[y * n + x];
+    const int hp2 = b->hp - fought * table->damage[x * n + y];
+    a->hp = (int16_t) (hp1 < INT16_MIN ? INT16_MIN : hp1);
+    b->hp = (int16_t) (hp2 < INT16_MIN ? INT16_MIN : hp2);
+    *rounds += fought;
+    return winner;
+}
+
+/**
+ * Returns the winner of a one-on-one battle from the table.
+ *
+ * @param table The table
+ * @param a The unit of the first army
+ * @param b The unit of the second army
+ * @param budget Rounds left before the battle times out
+ * @return 0 for a draw, 1 or 2 for the winner, RESULT_TIMEOUT if the duel
+ *         lasts longer than budget, -1 if the table does not cover it
+ */
+int duel_outcome(const DUEL_TABLE *table, const CUNIT *a, const CUNIT *b, int budget) {
+    CUNIT first = *a, second = *b;
+    int rounds = 0;
+    return duel_finish(table, &first, &second, &rounds, budget);
+}
@@ -0,0 +1,113 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+/**
+ * What one item did over a battle.
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t damage;
+    uint64_t kills;
+} ITEM_TALLY;
+
+/**
+ * Returns the name of an event type as written to the event log.
+ *
+ * @param type The event type
+ * @return Its name
+ */
+static const char *event_name(COMBAT_EVENT_TYPE type) {
+    switch (type) {
+        case COMBAT_HIT: return "hit";
+        case COMBAT_ATTACK_END: return "attack_end";
+        case COMBAT_DEATH: return "death";
+        case COMBAT_ROUND_END: return "round";
+    }
+    return "?";
+}
+
+/**
+ * Writes the combat events of the battle between the first two armies of a
+ * roster as CSV, one line per event in the order the engine applies them,
+ * and prints what each item did. A death is credited to the item that last
+ * hit the unit in that round.
+ *
+ * @param roster_path Path of the roster file
+ * @param output_path Path of the CSV file to write
+ * @return 0 on success
+ */
+int export_events(const char *roster_path, const char *output_path) {
+    FILE *file = fopen(roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+
+    ARMY army1, army2;
+    if (roster.count < 2 || !expand_army(roster.armies[0], &army1) || !expand_army(roster.armies[1], &army2)) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    FILE *out = fopen(output_path, "w");
+    if (!out) {
+        error(ERR_FILE);
+    }
+    ITEM_TALLY *tally = calloc(item_list.count, sizeof(ITEM_TALLY));
+    if (!tally) {
+        error(ERR_MEMORY);
+    }
+    // Item that last hit each slot of each side this round
+    const ITEM *last_hit[3][MAX_ARMY] = {{NULL}};
+    uint64_t events = 0;
+    int result = -1;
+
+    fprintf(out, "round,event,side,attacker,item,defender,damage,hp,result\n");
+    BATTLE_STEP step;
+    COMBAT_EVENT event;
+    battle_step_init(&step, &army1, &army2);
+    while (battle_step(&step, &event)) {
+        events++;
+        switch (event.type) {
+            case COMBAT_HIT:
+                fprintf(out, "%d,%s,%d,%d,%s,%d,%d,%d,\n", event.round, event_name(event.type), event.side, event.attacker,
+                        event.item->name, event.defender, event.damage, event.hp);
+                tally[event.item - item_list.items].hits++;
+                tally[event.item - item_list.items].damage += event.damage;
+                last_hit[3 - event.side][event.defender] = event.item;
+                break;
+            case COMBAT_ATTACK_END:
+                fprintf(out, "%d,%s,%d,,,,,,\n", event.round, event_name(event.type), event.side);
+                break;
+            case COMBAT_DEATH:
+                fprintf(out, "%d,%s,%d,,,%d,,%d,\n", event.round, event_name(event.type), event.side, event.defender, event.hp);
+                if (last_hit[event.side][event.defender]) {
+                    tally[last_hit[event.side][event.defender] - item_list.items].kills++;
+                }
+                break;
+            case COMBAT_ROUND_END:
+                fprintf(out, "%d,%s,,,,,,,%d\n", event.round, event_name(event.type), event.result);
+                memset(last_hit, 0, sizeof(last_hit));
+                result = event.result;
+                break;
+        }
+    }
+    if (fclose(out) != 0) {
+        error(ERR_FILE);
+    }
+
+    printf("%llu events over %d rounds, result %d, written to %s\n", (unsigned long long) events, step.round,
+           result, output_path);
+    printf("%-20s %8s %10s %6s\n", "item", "hits", "damage", "kills");
+    for (int i = 0; i < item_list.count; i++) {
+        if (tally[i].hits == 0) continue;
+        printf("%-20s %8llu %10llu %6llu\n", item_list.items[i].name, (unsigned long long) tally[i].hits,
+               (unsigned long long) tally[i].damage, (unsigned long long) tally[i].kills);
+    }
+    free(tally);
+    free_roster(&roster);
+    return 0;
+}
@@ -0,0 +1,519 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define EVOLVE_EPOCH 10
+#define EVOLVE_MIGRANTS 2
+#define EVOLVE_ELITE 2
+#define EVOLVE_SELECTION 3
+#define MAX_LOADOUTS (NUMBER_OF_ITEMS * (NUMBER_OF_ITEMS + 3) / 2)
+
+/**
+ * An item combination a unit may carry (one that passes check_slots()).
+ * Genomes store indices into the loadout table.
+ */
+typedef struct {
+    uint8_t item1;
+    uint8_t item2;
+} LOADOUT;
+
+/**
+ * One island: a population evolving on its own between migrations, with
+ * its own random stream so the run does not depend on thread scheduling.
+ */
+typedef struct {
+    uint64_t rng;
+    uint8_t *genes;
+    uint8_t *next;
+    double *fitness;
+    double *next_fitness;
+    CARMY *army;
+    ARENA scratch;
+} ISLAND;
+
+/**
+ * State shared by the threads of an evolutionary run.
+ */
+typedef struct {
+    const ROSTER *pool;
+    const EVOLVE_CONFIG *config;
+    LOADOUT loadouts[MAX_LOADOUTS];
+    int loadout_count;
+    uint16_t name;
+    ISLAND *islands;
+    int generations;
+    atomic_int next;
+} EVOLUTION;
+
+/**
+ * Returns the next value of an island's random stream (SplitMix64).
+ *
+ * @param state Stream state
+ * @return Pseudo-random 64-bit value
+ */
+static uint64_t next_random(uint64_t *state) {
+    *state += 0x9E3779B97F4A7C15ull;
+    return mix64(*state);
+}
+
+/**
+ * Returns a pseudo-random integer in [0, n).
+ *
+ * @param state Stream state
+ * @param n Upper bound (positive)
+ * @return The integer
+ */
+static int random_below(uint64_t *state, int n) {
+    return (int) (next_random(state) % (uint64_t) n);
+}
+
+/**
+ * Lists every item combination a unit may carry: one item, or two items
+ * whose slots fit in a unit (order does not matter in combat, so each pair
+ * is listed once).
+ *
+ * @param evo The run
+ */
+static void build_loadouts(EVOLUTION *evo) {
+    for (int i = 0; i < item_list.count; i++) {
+        // j == -1 stands for no second item
+        for (int j = -1; j < item_list.count; j++) {
+            if (j >= 0 && j < i) continue;
+            UNIT unit = {0};
+            unit.item1 = &item_list.items[i];
+            unit.item2 = j >= 0 ? &item_list.items[j] : NULL;
+            if (!check_slots(unit)) continue;
+            evo->loadouts[evo->loadout_count].item1 = (uint8_t) i;
+            evo->loadouts[evo->loadout_count].item2 = j >= 0 ? (uint8_t) j : CITEM_NONE;
+            evo->loadout_count++;
+        }
+    }
+    if (evo->loadout_count == 0) {
+        error(ERR_SLOTS);
+    }
+}
+
+/**
+ * Builds the compact army described by a genome. Its units share the name
+ * interned once for the run, so evaluations do not take the intern lock.
+ *
+ * @param evo The run
+ * @param genes The genome (one loadout index per unit)
+ * @param army Destination, sized for config->units units
+ */
+static void express(const EVOLUTION *evo, const uint8_t *genes, CARMY *army) {
+    for (int i = 0; i < army->count; i++) {
+        army->units[i].item1 = evo->loadouts[genes[i]].item1;
+        army->units[i].item2 = evo->loadouts[genes[i]].item2;
+        army->units[i].hp = UNIT_HP;
+        army->units[i].name = evo->name;
+    }
+}
+
+/**
+ * Scores a genome against the opponent pool with the compact engine.
+ * A win is worth 2 points and a draw 1; the average HP margin adds less than
+ * half a point, to rank armies with the same results.
+ *
+ * @param evo The run
+ * @param island The island (for its army buffer and arena)
+ * @param genes The genome
+ * @param record Optional output wins, draws and losses
+ * @return Fitness
+ */
+static double evaluate(const EVOLUTION *evo, ISLAND *island, const uint8_t *genes, int record[3]) {
+    express(evo, genes, island->army);
+    double points = 0;
+    double margin = 0;
+    for (int k = 0; k < evo->pool->count; k++) {
+        const CARMY *opponent = evo->pool->armies[k];
+        CRESULT result;
+        csimulate(island->army, opponent, &combat_catalog, &result, &island->scratch);
+        arena_reset(&island->scratch);
+
+        points += result.winner == 1 ? 2 : result.winner == 0 ? 1 : 0;
+        const int size = island->army->count > opponent->count ? island->army->count : opponent->count;
+        margin += (double) (result.hp1 - result.hp2) / ((double) UNIT_HP * size);
+        if (record) {
+            record[result.winner == 1 ? 0 : result.winner == 0 ? 1 : 2]++;
+        }
+    }
+    return points + 0.49 * margin / evo->pool->count;
+}
+
+/**
+ * Picks a parent by tournament selection.
+ *
+ * @param island The island
+ * @param population Population size
+ * @return Index of the fittest of EVOLVE_SELECTION random individuals
+ */
+static int select_parent(ISLAND *island, int population) {
+    int best = random_below(&island->rng, population);
+    for (int k = 1; k < EVOLVE_SELECTION; k++) {
+        const int other = random_below(&island->rng, population);
+        if (island->fitness[other] > island->fitness[best]) best = other;
+    }
+    return best;
+}
+
+/**
+ * Returns the index of the fittest individual of an island (the first one
+ * on ties, so the choice is reproducible).
+ *
+ * @param fitness Fitness of each individual
+ * @param population Population size
+ * @return Index of the best individual
+ */
+static int best_index(const double *fitness, int population) {
+    int best = 0;
+    for (int i = 1; i < population; i++) {
+        if (fitness[i] > fitness[best]) best = i;
+    }
+    return best;
+}
+
+/**
+ * Breeds one child: two-point crossover of two parents, then mutations that
+ * change a unit's loadout, swap two units or move a unit to another position.
+ *
+ * @param evo The run
+ * @param island The island
+ * @param child Destination genome
+ */
+static void breed(const EVOLUTION *evo, ISLAND *island, uint8_t *child) {
+    const int units = evo->config->units;
+    const int population = evo->config->population;
+    const uint8_t *mother = island->genes + (size_t) select_parent(island, population) * units;
+    const uint8_t *father = island->genes + (size_t) select_parent(island, population) * units;
+
+    int from = random_below(&island->rng, units);
+    int to = random_below(&island->rng, units + 1);
+    if (from > to) {
+        const int t = from;
+        from = to;
+        to = t;
+    }
+    memcpy(child, mother, units);
+    memcpy(child + from, father + from, (size_t) (to - from));
+
+    // About one mutation per child, whatever the army size
+    const int mutations = 1 + random_below(&island->rng, 2);
+    for (int m = 0; m < mutations; m++) {
+        const int kind = random_below(&island->rng, 3);
+        const int i = random_below(&island->rng, units);
+        const int j = random_below(&island->rng, units);
+        if (kind == 0) {
+            child[i] = (uint8_t) random_below(&island->rng, evo->loadout_count);
+        } else if (kind == 1) {
+            const uint8_t t = child[i];
+            child[i] = child[j];
+            child[j] = t;
+        } else {
+            const uint8_t moved = child[i];
+            if (i < j) {
+                memmove(child + i, child + i + 1, (size_t) (j - i));
+            } else {
+                memmove(child + j + 1, child + j, (size_t) (i - j));
+            }
+            child[j] = moved;
+        }
+    }
+}
+
+/**
+ * Advances an island by evo->generations generations. The EVOLVE_ELITE best
+ * individuals survive unchanged; the rest of the next generation is bred.
+ *
+ * @param evo The run
+ * @param island The island
+ */
+static void evolve_island(const EVOLUTION *evo, ISLAND *island) {
+    const int units = evo->config->units;
+    const int population = evo->config->population;
+    const int elite = EVOLVE_ELITE < population ? EVOLVE_ELITE : population;
+
+    for (int g = 0; g < evo->generations; g++) {
+        // Elites in fitness order, by repeated maximum since the elite is tiny
+        int kept[EVOLVE_ELITE];
+        for (int e = 0; e < elite; e++) {
+            int best = -1;
+            for (int i = 0; i < population; i++) {
+                bool used = false;
+                for (int k = 0; k < e; k++) used |= kept[k] == i;
+                if (!used && (best < 0 || island->fitness[i] > island->fitness[best])) best = i;
+            }
+            kept[e] = best;
+            memcpy(island->next + (size_t) e * units, island->genes + (size_t) best * units, units);
+            island->next_fitness[e] = island->fitness[best];
+        }
+
+        for (int i = elite; i < population; i++) {
+            uint8_t *child = island->next + (size_t) i * units;
+            breed(evo, island, child);
+            island->next_fitness[i] = evaluate(evo, island, child, NULL);
+        }
+
+        uint8_t *genes = island->genes;
+        island->genes = island->next;
+        island->next = genes;
+        double *fitness = island->fitness;
+        island->fitness = island->next_fitness;
+        island->next_fitness = fitness;
+    }
+}
+
+/**
+ * Evolution thread: takes islands until every island has run the current
+ * epoch.
+ *
+ * @param arg Pointer to the EVOLUTION structure
+ * @return Always NULL
+ */
+static void *evolve_main(void *arg) {
+    EVOLUTION *evo = arg;
+    trace_thread_name("evolution worker");
+    while (1) {
+        const int i = atomic_fetch_add(&evo->next, 1);
+        if (i >= evo->config->islands) break;
+        const uint64_t span = trace_begin();
+        evolve_island(evo, &evo->islands[i]);
+        trace_end("island epoch", span);
+    }
+    return NULL;
+}
+
+/**
+ * Runs one epoch on every island in parallel.
+ *
+ * @param evo The run
+ * @param threads Number of threads
+ * @param generations Generations in this epoch
+ */
+static void run_epoch(EVOLUTION *evo, int threads, int generations) {
+    evo->generations = generations;
+    atomic_store(&evo->next, 0);
+
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    if (!ids) {
+        error(ERR_MEMORY);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&ids[t], NULL, evolve_main, evo);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+}
+
+/**
+ * Ring migration: the best EVOLVE_MIGRANTS individuals of each island
+ * replace the worst ones of the next island. Migrants are copied out first,
+ * so every island sends what it had before the exchange.
+ *
+ * @param evo The run
+ */
+static void migrate(EVOLUTION *evo) {
+    const int islands = evo->config->islands;
+    const int units = evo->config->units;
+    const int population = evo->config->population;
+    const int migrants = EVOLVE_MIGRANTS < population / 2 ? EVOLVE_MIGRANTS : population / 2;
+    if (islands < 2 || migrants == 0) return;
+
+    uint8_t *outgoing = malloc((size_t) islands * migrants * units);
+    double *outgoing_fitness = malloc(sizeof(double) * islands * migrants);
+    if (!outgoing || !outgoing_fitness) {
+        error(ERR_MEMORY);
+    }
+
+    for (int i = 0; i < islands; i++) {
+        ISLAND *island = &evo->islands[i];
+        double *fitness = malloc(sizeof(double) * population);
+        if (!fitness) {
+            error(ERR_MEMORY);
+        }
+        memcpy(fitness, island->fitness, sizeof(double) * population);
+        for (int m = 0; m < migrants; m++) {
+            const int best = best_index(fitness, population);
+            memcpy(outgoing + ((size_t) i * migrants + m) * units, island->genes + (size_t) best * units, units);
+            outgoing_fitness[i * migrants + m] = fitness[best];
+            fitness[best] = -1e300;
+        }
+        free(fitness);
+    }
+
+    for (int i = 0; i < islands; i++) {
+        ISLAND *island = &evo->islands[(i + 1) % islands];
+        for (int m = 0; m < migrants; m++) {
+            int worst = 0;
+            for (int k = 1; k < population; k++) {
+                if (island->fitness[k] < island->fitness[worst]) worst = k;
+            }
+            memcpy(island->genes + (size_t) worst * units, outgoing + ((size_t) i * migrants + m) * units, units);
+            island->fitness[worst] = outgoing_fitness[i * migrants + m];
+        }
+    }
+    free(outgoing);
+    free(outgoing_fitness);
+}
+
+/**
+ * Writes an army in roster format, merging runs of identical units with
+ * the " xN" suffix.
+ *
+ * @param evo The run
+ * @param genes The genome
+ * @param out Stream to write to
+ */
+static void write_army(const EVOLUTION *evo, const uint8_t *genes, FILE *out) {
+    const int units = evo->config->units;
+    int group = 0;
+    for (int i = 0; i < units;) {
+        int run = 1;
+        while (i + run < units && genes[i + run] == genes[i]) run++;
+
+        const LOADOUT *loadout = &evo->loadouts[genes[i]];
+        fprintf(out, "G%d", ++group);
+        if (run > 1) {
+            fprintf(out, " x%d", run);
+        }
+        fprintf(out, ": %s", item_list.items[loadout->item1].name);
+        if (loadout->item2 != CITEM_NONE) {
+            fprintf(out, ", %s", item_list.items[loadout->item2].name);
+        }
+        fprintf(out, "\n");
+        i += run;
+    }
+}
+
+/**
+ * Searches for a strong army composition against a pool of opponents with
+ * an island-model genetic algorithm. Each island evolves its own population
+ * for EVOLVE_EPOCH generations, then the best individuals migrate around a
+ * ring. Islands are seeded from config->seed and advanced independently, so
+ * a run is reproducible whatever the number of threads.
+ *
+ * @param config Search options
+ * @return 0 on success
+ */
+int run_evolve(const EVOLVE_CONFIG *config) {
+    FILE *file = fopen(config->pool_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER pool;
+    load_roster(file, &pool);
+    fclose(file);
+    if (pool.count < 1 || config->units < 1 || config->units > UINT16_MAX || config->population < 2 ||
+        config->islands < 1 || config->generations < 0) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    int threads = config->threads;
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+    if (threads > config->islands) threads = config->islands;
+
+    EVOLUTION evo = {0};
+    evo.pool = &pool;
+    evo.config = config;
+    build_loadouts(&evo);
+    evo.name = intern_name("Evolved");
+
+    const int units = config->units;
+    const int population = config->population;
+    const double started = now_seconds();
+    evo.islands = calloc(config->islands, sizeof(ISLAND));
+    if (!evo.islands) {
+        error(ERR_MEMORY);
+    }
+    for (int i = 0; i < config->islands; i++) {
+        ISLAND *island = &evo.islands[i];
+        island->rng = mix64(config->seed ^ mix64((uint64_t) i + 1));
+        island->genes = malloc((size_t) population * units);
+        island->next = malloc((size_t) population * units);
+        island->fitness = malloc(sizeof(double) * population);
+        island->next_fitness = malloc(sizeof(double) * population);
+        island->army = carmy_new(units);
+        if (!island->genes || !island->next || !island->fitness || !island->next_fitness) {
+            error(ERR_MEMORY);
+        }
+        arena_init(&island->scratch, 0);
+        for (size_t k = 0; k < (size_t) population * units; k++) {
+            island->genes[k] = (uint8_t) random_below(&island->rng, evo.loadout_count);
+        }
+        for (int k = 0; k < population; k++) {
+            island->fitness[k] = evaluate(&evo, island, island->genes + (size_t) k * units, NULL);
+        }
+    }
+
+    printf("%d islands x %d armies of %d units against %d opponents, %d loadouts, seed %llu\n", config->islands,
+           population, units, pool.count, evo.loadout_count, (unsigned long long) config->seed);
+    for (int done = 0; done < config->generations;) {
+        const int epoch = config->generations - done < EVOLVE_EPOCH ? config->generations - done : EVOLVE_EPOCH;
+        run_epoch(&evo, threads, epoch);
+        done += epoch;
+        migrate(&evo);
+
+        double best = -1e300;
+        for (int i = 0; i < config->islands; i++) {
+            const ISLAND *island = &evo.islands[i];
+            const double f = island->fitness[best_index(island->fitness, population)];
+            if (f > best) best = f;
+        }
+        printf("Generation %5d: best fitness %.3f of %d\n", done, best, 2 * pool.count);
+        fflush(stdout);
+    }
+    const double elapsed = now_seconds() - started;
+
+    int champion_island = 0;
+    int champion = best_index(evo.islands[0].fitness, population);
+    for (int i = 1; i < config->islands; i++) {
+        const int k = best_index(evo.islands[i].fitness, population);
+        if (evo.islands[i].fitness[k] > evo.islands[champion_island].fitness[champion]) {
+            champion_island = i;
+            champion = k;
+        }
+    }
+    ISLAND *island = &evo.islands[champion_island];
+    const uint8_t *genes = island->genes + (size_t) champion * units;
+    int record[3] = {0};
+    evaluate(&evo, island, genes, record);
+
+    printf("\nBest army: %d wins, %d draws, %d losses against %d opponents\n", record[0], record[1], record[2],
+           pool.count);
+    write_army(&evo, genes, stdout);
+    if (config->output_path) {
+        FILE *out = fopen(config->output_path, "w");
+        if (!out) {
+            error(ERR_FILE);
+        }
+        write_army(&evo, genes, out);
+        fclose(out);
+    }
+    const uint64_t battles = (uint64_t) config->islands * population * pool.count +
+                             (uint64_t) config->islands * (population - (EVOLVE_ELITE < population ? EVOLVE_ELITE
+                                                                                                   : population)) *
+                                 config->generations * pool.count;
+    printf("\n%llu battles on %d threads in %.3f s (%.0f battles/s)\n", (unsigned long long) battles, threads,
+           elapsed, elapsed > 0 ? battles / elapsed : 0.0);
+
+    for (int i = 0; i < config->islands; i++) {
+        free(evo.islands[i].genes);
+        free(evo.islands[i].next);
+        free(evo.islands[i].fitness);
+        free(evo.islands[i].next_fitness);
+        free(evo.islands[i].army);
+        arena_free(&evo.islands[i].scratch);
+    }
+    free(evo.islands);
+    free_roster(&pool);
+    return 0;
+}
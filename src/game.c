@@ -16,6 +16,54 @@ void check_hp(ARMY *army) {
     }
 }
 
+/**
+ * Applies the next hit of an attack and advances the cursor past it.
+ * Hits come in the order of attack(): attacking units front to back, item1
+ * before item2, and for each item the defenders from position 0 up to its
+ * radius. An item only fires if the attacker's position is within its range.
+ * Damage is max(attack - defender's total defense, 1). With a constant NULL
+ * event this inlines to the plain loops of attack().
+ *
+ * @param attacking_army Pointer to the ARMY structure that is attacking
+ * @param defending_army Pointer to the ARMY structure that is defending
+ * @param cursor Position of the attack, all zero before the first hit
+ * @param event Output for the hit (may be NULL)
+ * @return true if a hit was applied, false once the attack is over
+ */
+static inline bool next_hit(ARMY *attacking_army, ARMY *defending_army, HIT_CURSOR *cursor, COMBAT_EVENT *event) {
+    for (; cursor->attacker <= attacking_army->top; cursor->attacker++, cursor->item = 0) {
+        const UNIT *attacker = &attacking_army->units[cursor->attacker];
+        for (; cursor->item < 2; cursor->item++, cursor->defender = 0) {
+            const ITEM *item = cursor->item == 0 ? attacker->item1 : attacker->item2;
+            if (!item || item->range < cursor->attacker || cursor->defender > item->radius ||
+                cursor->defender > defending_army->top) {
+                continue;
+            }
+            const int j = cursor->defender++;
+            UNIT *defender = &defending_army->units[j];
+            int de = 0;
+            if (defender->item1) {
+                de += defender->item1->def;
+            }
+            if (defender->item2) {
+                de += defender->item2->def;
+            }
+            const int d = max(item->att - de, 1);
+            defender->hp -= d;
+            if (event) {
+                event->type = COMBAT_HIT;
+                event->attacker = cursor->attacker;
+                event->item = item;
+                event->defender = j;
+                event->damage = d;
+                event->hp = defender->hp;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
 /**
  * Executes attack actions from one army against another.
  * For each unit in the attacking army:
@@ -28,47 +76,24 @@ void check_hp(ARMY *army) {
  * @param defending_army Pointer to the ARMY structure that is defending
  */
 void attack(ARMY *attacking_army, ARMY *defending_army) {
-    for (int i = 0; i <= attacking_army -> top; i++) {
-            UNIT attacker;
-            if (peek_at(attacking_army, i, &attacker)) {
-                if (attacker.item1) {
-                    if (attacker.item1->range >= i) {
-                        for (int j = 0; j <= attacker.item1->radius; j++) {
-                            UNIT defender;
-                            if (peek_at(defending_army, j, &defender)) {
-                                int de = 0;
-                                if (defender.item1) {
-                                    de += defender.item1->def;
-                                }
-                                if (defender.item2) {
-                                    de += defender.item2->def;
-                                }
-                                const int d = max(attacker.item1 -> att - de, 1);
-                                defending_army -> units[j].hp -= d;
-                            }
-                        }
-                    }
-                }
-                if (attacker.item2) {
-                    if (attacker.item2 -> range >= i) {
-                        for (int j = 0; j <= attacker.item2->radius; j++) {
-                            UNIT defender;
-                            if (peek_at(defending_army, j, &defender)) {
-                                int de = 0;
-                                if (defender.item1) {
-                                    de += defender.item1->def;
-                                }
-                                if (defender.item2) {
-                                    de += defender.item2->def;
-                                }
-                                const int d = max(attacker.item2 -> att - de, 1);
-                                defending_army -> units[j].hp -= d;
-                            }
-                        }
-                    }
-                }
-            }
-        }
+    HIT_CURSOR cursor = {0, 0, 0};
+    while (next_hit(attacking_army, defending_army, &cursor, NULL)) {
+    }
+}
+
+/**
+ * Returns the result code of a round from the armies left after check_hp().
+ *
+ * @param army1 Pointer to the first ARMY structure
+ * @param army2 Pointer to the second ARMY structure
+ * @return int -1 to continue, 0 for a draw, 1 or 2 for the winner
+ */
+static int round_result(const ARMY *army1, const ARMY *army2) {
+    if (army1->top < 0 && army2->top < 0) return 0; // Draw
+    if (army1->top < 0) return 2; // Army 2 wins
+    if (army2->top < 0) return 1; // Army 1 wins
+
+    return -1; // Continue battle
 }
 
 /**
@@ -88,16 +113,133 @@ void attack(ARMY *attacking_army, ARMY *defending_army) {
  *          2: Army 2 wins
  */
 int battle_round(ARMY *army1, ARMY *army2) {
+    const uint64_t round_start = trace_begin();
+    uint64_t span = trace_begin();
     attack(army1, army2);
+    trace_end("attack 1->2", span);
+    span = trace_begin();
     attack(army2, army1);
+    trace_end("attack 2->1", span);
 
+    span = trace_begin();
     check_hp(army1);
     check_hp(army2);
+    trace_end("check_hp", span);
+    trace_end("battle_round", round_start);
 
+    return round_result(army1, army2);
+}
 
-    if (army1->top < 0 && army2->top < 0) return 0; // Draw
-    if (army1->top < 0) return 2; // Army 2 wins
-    if (army2->top < 0) return 1; // Army 1 wins
+/**
+ * Runs battle rounds until one of the armies is defeated.
+ * Both armies are modified in place and hold the survivors afterwards.
+ *
+ * @param army1 Pointer to the first ARMY structure
+ * @param army2 Pointer to the second ARMY structure
+ * @param rounds Optional output for the number of rounds fought (may be NULL)
+ * @return int Final result code of battle_round() (0, 1 or 2)
+ */
+int simulate_battle(ARMY *army1, ARMY *army2, int *rounds) {
+    int round = 0;
+    int result = -1;
 
-    return -1; // Continue battle
-}
\ No newline at end of file
+    while (result == -1) {
+        result = battle_round(army1, army2);
+        round++;
+    }
+
+    if (rounds) {
+        *rounds = round;
+    }
+    return result;
+}
+
+/**
+ * Starts stepping through a battle. The armies are modified in place as the
+ * events are taken, exactly as battle_round() would modify them.
+ *
+ * @param step The stepping state
+ * @param army1 Pointer to the first ARMY structure
+ * @param army2 Pointer to the second ARMY structure
+ */
+void battle_step_init(BATTLE_STEP *step, ARMY *army1, ARMY *army2) {
+    step->army1 = army1;
+    step->army2 = army2;
+    step->round = 1;
+    step->phase = STEP_ATTACK_1;
+    step->cursor = (HIT_CURSOR) {0, 0, 0};
+}
+
+/**
+ * Applies the next action of a battle and describes it. The events of a
+ * round are, in the order battle_round() applies them: the hits of army 1
+ * and COMBAT_ATTACK_END, the hits of army 2 and COMBAT_ATTACK_END, the
+ * deaths in army 1 and in army 2 (each from the back, so a slot is still
+ * where the hits found it), then COMBAT_ROUND_END with the result of the
+ * round. No unit has been removed yet when an attack ends. The state can be
+ * left between any two events and resumed later; after the round that ends
+ * the battle, step->round stays at the last round.
+ *
+ * @param step The stepping state
+ * @param event Output for the event
+ * @return true if an event was produced, false once the battle is over
+ */
+bool battle_step(BATTLE_STEP *step, COMBAT_EVENT *event) {
+    event->round = step->round;
+    switch (step->phase) {
+        case STEP_ATTACK_1:
+            if (next_hit(step->army1, step->army2, &step->cursor, event)) {
+                event->side = 1;
+                return true;
+            }
+            step->phase = STEP_ATTACK_2;
+            step->cursor = (HIT_CURSOR) {0, 0, 0};
+            event->type = COMBAT_ATTACK_END;
+            event->side = 1;
+            return true;
+        case STEP_ATTACK_2:
+            if (next_hit(step->army2, step->army1, &step->cursor, event)) {
+                event->side = 2;
+                return true;
+            }
+            step->phase = STEP_CHECK_1;
+            step->cursor.defender = step->army1->top;
+            event->type = COMBAT_ATTACK_END;
+            event->side = 2;
+            return true;
+        case STEP_CHECK_1:
+        case STEP_CHECK_2:
+            while (step->phase != STEP_ROUND_END) {
+                ARMY *army = step->phase == STEP_CHECK_1 ? step->army1 : step->army2;
+                while (step->cursor.defender >= 0) {
+                    const int slot = step->cursor.defender--;
+                    if (army->units[slot].hp <= 0) {
+                        event->type = COMBAT_DEATH;
+                        event->side = step->phase == STEP_CHECK_1 ? 1 : 2;
+                        event->defender = slot;
+                        event->hp = army->units[slot].hp;
+                        pop_at(army, slot);
+                        return true;
+                    }
+                }
+                step->phase = step->phase == STEP_CHECK_1 ? STEP_CHECK_2 : STEP_ROUND_END;
+                step->cursor.defender = step->army2->top;
+            }
+            // fall through
+        case STEP_ROUND_END:
+            event->type = COMBAT_ROUND_END;
+            event->side = 0;
+            event->result = round_result(step->army1, step->army2);
+            if (event->result == -1) {
+                step->round++;
+                step->phase = STEP_ATTACK_1;
+                step->cursor = (HIT_CURSOR) {0, 0, 0};
+            } else {
+                step->phase = STEP_DONE;
+            }
+            return true;
+        case STEP_DONE:
+            break;
+    }
+    return false;
+}
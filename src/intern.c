@@ -0,0 +1,158 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+#define INTERN_INITIAL_SLOTS 256
+
+/**
+ * Shared table of interned unit names.
+ * Every distinct name is stored exactly once; compact units refer to it by a
+ * 16-bit id. Id 0 is always the empty name.
+ */
+static struct {
+    pthread_mutex_t lock;
+    char **names;
+    int count;
+    int capacity;
+    uint16_t *slots;
+    int slot_count;
+    size_t bytes;
+} table = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, NULL, 0, 0};
+
+/**
+ * Computes the FNV-1a hash of a string.
+ *
+ * @param s The string to hash
+ * @return 32-bit hash value
+ */
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (uint8_t) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Inserts an id into the open-addressing index. The index must have a free slot.
+ *
+ * @param id Id of a name already stored in the table
+ */
+static void index_insert(uint16_t id) {
+    uint32_t i = hash_name(table.names[id]) & (table.slot_count - 1);
+    while (table.slots[i] != 0) {
+        i = (i + 1) & (table.slot_count - 1);
+    }
+    table.slots[i] = id;
+}
+
+/**
+ * Appends a copy of a name to the table and indexes it, growing storage as needed.
+ *
+ * @param name The name to store
+ * @return The id of the new entry
+ */
+static uint16_t append_name(const char *name) {
+    if (table.count == table.capacity) {
+        const int capacity = table.capacity ? table.capacity * 2 : INTERN_INITIAL_SLOTS / 2;
+        char **names = realloc(table.names, sizeof(char *) * capacity);
+        if (!names) {
+            error(ERR_MEMORY);
+        }
+        table.names = names;
+        table.capacity = capacity;
+    }
+
+    if ((table.count + 1) * 2 > table.slot_count) {
+        free(table.slots);
+        table.slot_count = table.slot_count ? table.slot_count * 2 : INTERN_INITIAL_SLOTS;
+        table.slots = calloc(table.slot_count, sizeof(uint16_t));
+        if (!table.slots) {
+            error(ERR_MEMORY);
+        }
+        for (int id = 1; id < table.count; id++) {
+            index_insert((uint16_t) id);
+        }
+    }
+
+    const size_t len = strlen(name);
+    char *copy = malloc(len + 1);
+    if (!copy) {
+        error(ERR_MEMORY);
+    }
+    memcpy(copy, name, len + 1);
+
+    const uint16_t id = (uint16_t) table.count++;
+    table.names[id] = copy;
+    table.bytes += len + 1;
+    if (id != 0) {
+        index_insert(id);
+    }
+    return id;
+}
+
+/**
+ * Interns a unit name, returning the id of its single shared copy.
+ * Safe to call from several threads.
+ *
+ * @param name The name to intern (NULL or empty maps to id 0)
+ * @return The id of the name; exits with ERR_MEMORY if the 16-bit id space is exhausted
+ */
+uint16_t intern_name(const char *name) {
+    pthread_mutex_lock(&table.lock);
+    if (table.count == 0) {
+        append_name("");
+    }
+
+    uint16_t id = 0;
+    if (name && name[0] != '\0') {
+        uint32_t i = hash_name(name) & (table.slot_count - 1);
+        while (table.slots[i] != 0 && strcmp(table.names[table.slots[i]], name) != 0) {
+            i = (i + 1) & (table.slot_count - 1);
+        }
+        if (table.slots[i] != 0) {
+            id = table.slots[i];
+        } else {
+            if (table.count > UINT16_MAX) {
+                error(ERR_MEMORY);
+            }
+            id = append_name(name);
+        }
+    }
+    pthread_mutex_unlock(&table.lock);
+    return id;
+}
+
+/**
+ * Returns the name stored under an id.
+ * Name strings never move once interned, so the pointer stays valid for the
+ * lifetime of the program.
+ *
+ * @param id An id previously returned by intern_name()
+ * @return The interned name, or "" for unknown ids
+ */
+const char *interned_name(uint16_t id) {
+    pthread_mutex_lock(&table.lock);
+    const char *name = id < table.count ? table.names[id] : "";
+    pthread_mutex_unlock(&table.lock);
+    return name;
+}
+
+/**
+ * Reports the memory held by the string table.
+ *
+ * @param count Optional output for the number of distinct names (may be NULL)
+ * @return Total bytes used by name storage and the lookup index
+ */
+size_t intern_memory(int *count) {
+    pthread_mutex_lock(&table.lock);
+    if (count) {
+        *count = table.count;
+    }
+    const size_t bytes = table.bytes + sizeof(char *) * table.capacity + sizeof(uint16_t) * table.slot_count;
+    pthread_mutex_unlock(&table.lock);
+    return bytes;
+}
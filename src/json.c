@@ -36,7 +36,7 @@ int skip(FILE *file) {
 }
 
 /**
- * Loads item definitions from a JSON file into the global item list.
+ * Parses item definitions from a JSON file into an item list.
  * Parses a JSON array of item objects, each containing name, att, def, slots, range, and radius attributes.
  *
  * The function expects a JSON structure like:
@@ -53,9 +53,10 @@ int skip(FILE *file) {
  * ]
  *
  * @param json The file stream containing JSON data to parse
+ * @param list Destination list with room for NUMBER_OF_ITEMS items
  */
-void load_items(FILE *json) {
-    item_list.count = 0;
+void parse_items(FILE *json, ITEM_LIST *list) {
+    list->count = 0;
 
     int c;
     while ((c = fgetc(json)) != EOF && c != '[') {}
@@ -161,14 +162,27 @@ void load_items(FILE *json) {
                 }
             }
             if (attributes[0] && attributes[1] && attributes[2] && attributes[3] && attributes[4] && attributes[5]) {
-                if (item_list.count >= NUMBER_OF_ITEMS) {
+                if (list->count >= NUMBER_OF_ITEMS) {
                     error("ERR_TOO_MANY_ITEMS");
                 }
-                item_list.items[item_list.count] = item;
-                item_list.count++;
+                list->items[list->count] = item;
+                list->count++;
             } else {
                 error(ERR_MISSING_ATTRIBUTE);
             }
         }
     }
+}
+
+/**
+ * Loads item definitions from a JSON file into the global item list (see
+ * parse_items()) and compiles them into combat_catalog for the compact engine.
+ *
+ * @param json The file stream containing JSON data to parse
+ */
+void load_items(FILE *json) {
+    const uint64_t span = trace_begin();
+    parse_items(json, &item_list);
+    compile_catalog(&item_list, &combat_catalog);
+    trace_end("load_items", span);
 }
\ No newline at end of file
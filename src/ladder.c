@@ -0,0 +1,453 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define LADDER_CHUNK 16
+#define LADDER_WINDOW 16
+#define LADDER_BATTLES_PER_ARMY 16
+#define LADDER_RATING 1500.0
+#define LADDER_RD 350.0
+#define GLICKO_Q (M_LN10 / 400.0)
+
+/**
+ * Glicko rating of one army. Battles are deterministic, so an army's
+ * strength does not drift and its deviation is never inflated again.
+ */
+typedef struct {
+    double rating;
+    double rd;
+} RATING;
+
+/**
+ * Sort key for ranking armies by a value, ties broken by army index.
+ */
+typedef struct {
+    double key;
+    int army;
+} RANKED;
+
+/**
+ * Open-addressing set of the matchup ids already played. Replaying a
+ * matchup would give the same result and no new information.
+ */
+typedef struct {
+    uint64_t *slots;
+    uint64_t mask;
+} PAIR_SET;
+
+/**
+ * State of a ladder run shared with the battle threads.
+ */
+typedef struct {
+    const ROSTER *roster;
+    const BATTLE_LIMITS *limits;
+    RATING *ratings;
+    uint32_t (*score)[3];
+    PAIR_SET played;
+    RANKED *by_rating;
+    RANKED *by_rd;
+    int *position;
+    int *previous_rank;
+    bool *used;
+    int (*pairs)[2];
+    CRESULT *results;
+    int count;
+    atomic_int next;
+} LADDER;
+
+/**
+ * Returns the Glicko attenuation of a rating difference for an opponent
+ * whose rating is uncertain by rd.
+ *
+ * @param rd Rating deviation of the opponent
+ * @return Factor in (0, 1]
+ */
+static double glicko_g(double rd) {
+    return 1.0 / sqrt(1.0 + 3.0 * GLICKO_Q * GLICKO_Q * rd * rd / (M_PI * M_PI));
+}
+
+/**
+ * Returns the expected score of one army against another.
+ *
+ * @param a The army
+ * @param b Its opponent
+ * @return Expected score between 0 and 1
+ */
+static double glicko_expected(const RATING *a, const RATING *b) {
+    return 1.0 / (1.0 + pow(10.0, -glicko_g(b->rd) * (a->rating - b->rating) / 400.0));
+}
+
+/**
+ * Applies one battle to an army's rating (a Glicko rating period of one game).
+ *
+ * @param rating The army's rating before the battle
+ * @param opponent The opponent's rating before the battle
+ * @param score 1 for a win, 0.5 for a draw or timeout, 0 for a loss
+ * @return The army's new rating
+ */
+static RATING glicko_update(RATING rating, const RATING *opponent, double score) {
+    const double g = glicko_g(opponent->rd);
+    const double expected = glicko_expected(&rating, opponent);
+    const double information = GLICKO_Q * GLICKO_Q * g * g * expected * (1.0 - expected);
+    const double precision = 1.0 / (rating.rd * rating.rd) + information;
+    rating.rating += GLICKO_Q / precision * g * (score - expected);
+    rating.rd = sqrt(1.0 / precision);
+    return rating;
+}
+
+/**
+ * Returns how much a battle between two armies is expected to tell: the
+ * variance it takes off both ratings. It is largest for close, uncertain
+ * armies, whose outcome is hardest to predict.
+ *
+ * @param a The first army
+ * @param b The second army
+ * @return Information score
+ */
+static double pair_information(const RATING *a, const RATING *b) {
+    const double expected = glicko_expected(a, b);
+    const double ga = glicko_g(a->rd), gb = glicko_g(b->rd);
+    return expected * (1.0 - expected) * (a->rd * a->rd * gb * gb + b->rd * b->rd * ga * ga);
+}
+
+/**
+ * Creates an empty set sized for a number of matchups.
+ *
+ * @param set The set
+ * @param capacity Largest number of matchups it will hold
+ */
+static void pair_set_init(PAIR_SET *set, uint64_t capacity) {
+    uint64_t size = 64;
+    while (size < capacity * 2) size <<= 1;
+    set->slots = calloc(size, sizeof(uint64_t));
+    if (!set->slots) {
+        error(ERR_MEMORY);
+    }
+    set->mask = size - 1;
+}
+
+/**
+ * Looks up a matchup in the set and optionally adds it.
+ *
+ * @param set The set
+ * @param matchup Matchup id
+ * @param add Whether to add the matchup if it is missing
+ * @return true if the matchup was already in the set
+ */
+static bool pair_set_test(PAIR_SET *set, uint64_t matchup, bool add) {
+    // Slots hold id + 1 so that 0 marks an empty slot
+    for (uint64_t i = mix64(matchup) & set->mask;; i = (i + 1) & set->mask) {
+        if (set->slots[i] == matchup + 1) return true;
+        if (set->slots[i] == 0) {
+            if (add) set->slots[i] = matchup + 1;
+            return false;
+        }
+    }
+}
+
+/**
+ * Orders ranked entries by descending key, then by army index.
+ *
+ * @param a The first entry
+ * @param b The second entry
+ * @return Negative, zero or positive as for qsort()
+ */
+static int compare_ranked(const void *a, const void *b) {
+    const RANKED *x = a, *y = b;
+    if (x->key != y->key) return x->key > y->key ? -1 : 1;
+    return x->army - y->army;
+}
+
+/**
+ * Sorts the armies by rating and by deviation.
+ *
+ * @param ladder The ladder
+ */
+static void rank_armies(LADDER *ladder) {
+    const int n = ladder->roster->count;
+    for (int i = 0; i < n; i++) {
+        ladder->by_rating[i] = (RANKED) {ladder->ratings[i].rating, i};
+        ladder->by_rd[i] = (RANKED) {ladder->ratings[i].rd, i};
+    }
+    qsort(ladder->by_rating, n, sizeof(RANKED), compare_ranked);
+    qsort(ladder->by_rd, n, sizeof(RANKED), compare_ranked);
+    for (int i = 0; i < n; i++) {
+        ladder->position[ladder->by_rating[i].army] = i;
+    }
+}
+
+/**
+ * Chooses the matchups of the next batch. The most uncertain armies pick
+ * first; each takes, among the unplayed armies within LADDER_WINDOW places
+ * of it in the current ranking, the one whose battle is most informative.
+ * An army plays at most once per batch, so the ratings a batch is chosen
+ * from are the ones its results update.
+ *
+ * @param ladder The ladder, ranked by rank_armies()
+ * @param limit Largest number of matchups to choose
+ * @return Number of matchups chosen
+ */
+static int pick_pairs(LADDER *ladder, int limit) {
+    const int n = ladder->roster->count;
+    memset(ladder->used, 0, sizeof(bool) * n);
+    int count = 0;
+    for (int k = 0; k < n && count < limit; k++) {
+        const int a = ladder->by_rd[k].army;
+        if (ladder->used[a]) continue;
+        const int p = ladder->position[a];
+        int best = -1;
+        double best_information = -1.0;
+        for (int q = p - LADDER_WINDOW; q <= p + LADDER_WINDOW; q++) {
+            if (q < 0 || q >= n || q == p) continue;
+            const int b = ladder->by_rating[q].army;
+            if (ladder->used[b]) continue;
+            if (pair_set_test(&ladder->played, a < b ? matchup_id(a, b, n) : matchup_id(b, a, n), false)) continue;
+            const double information = pair_information(&ladder->ratings[a], &ladder->ratings[b]);
+            if (information > best_information) {
+                best_information = information;
+                best = b;
+            }
+        }
+        if (best < 0) continue;
+        ladder->used[a] = ladder->used[best] = true;
+        ladder->pairs[count][0] = a < best ? a : best;
+        ladder->pairs[count][1] = a < best ? best : a;
+        pair_set_test(&ladder->played, matchup_id(ladder->pairs[count][0], ladder->pairs[count][1], n), true);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Battle thread: claims chunks of the batch's matchups and fights them.
+ *
+ * @param arg Pointer to the LADDER structure
+ * @return Always NULL
+ */
+static void *ladder_main(void *arg) {
+    LADDER *ladder = arg;
+    const ROSTER *roster = ladder->roster;
+    ARENA scratch;
+    arena_init(&scratch, 0);
+
+    while (1) {
+        const int start = atomic_fetch_add(&ladder->next, LADDER_CHUNK);
+        if (start >= ladder->count) break;
+        const int end = start + LADDER_CHUNK < ladder->count ? start + LADDER_CHUNK : ladder->count;
+        for (int k = start; k < end; k++) {
+            const int a = ladder->pairs[k][0], b = ladder->pairs[k][1];
+            csimulate_observed(roster->armies[a], roster->armies[b], &combat_catalog, &ladder->results[k], &scratch,
+                               ladder->limits, NULL, NULL);
+        }
+        arena_reset(&scratch);
+    }
+    arena_free(&scratch);
+    return NULL;
+}
+
+/**
+ * Fights the chosen matchups of a batch on a number of threads.
+ *
+ * @param ladder The ladder with its pairs and count set
+ * @param threads Number of threads
+ */
+static void run_pairs(LADDER *ladder, int threads) {
+    atomic_store(&ladder->next, 0);
+    if (threads == 1) {
+        ladder_main(ladder);
+        return;
+    }
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    if (!ids) {
+        error(ERR_MEMORY);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&ids[t], NULL, ladder_main, ladder);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+}
+
+/**
+ * Returns the mean number of places armies moved in the ranking since the
+ * previous batch, and remembers the current ranking.
+ *
+ * @param ladder The ladder, ranked by rank_armies()
+ * @return Mean rank change
+ */
+static double rank_shift(LADDER *ladder) {
+    const int n = ladder->roster->count;
+    uint64_t moved = 0;
+    for (int i = 0; i < n; i++) {
+        moved += (uint64_t) abs(ladder->position[i] - ladder->previous_rank[i]);
+        ladder->previous_rank[i] = ladder->position[i];
+    }
+    return (double) moved / n;
+}
+
+/**
+ * Returns the mean rating deviation of the armies.
+ *
+ * @param ladder The ladder
+ * @return Mean RD
+ */
+static double mean_rd(const LADDER *ladder) {
+    const int n = ladder->roster->count;
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += ladder->ratings[i].rd;
+    }
+    return sum / n;
+}
+
+/**
+ * Prints the progress of the ladder after a batch.
+ *
+ * @param ladder The ladder, ranked by rank_armies()
+ * @param battles Battles fought so far
+ * @param shift Mean rank change in the last batch
+ * @param out Stream to print to
+ */
+static void print_progress(const LADDER *ladder, uint64_t battles, double shift, FILE *out) {
+    fprintf(out, "%10llu battles  mean RD %6.1f  max RD %6.1f  rank shift %7.2f\n", (unsigned long long) battles,
+            mean_rd(ladder), ladder->by_rd[0].key, shift);
+}
+
+/**
+ * Ranks the armies of a roster with as few battles as possible. Every army
+ * starts with the same Glicko rating; batches of adaptively chosen matchups
+ * (see pick_pairs()) are fought in parallel and their results update the
+ * ratings as they come in. The run ends when the battle budget is spent,
+ * when the mean rating deviation reaches the target, or when no unplayed
+ * matchup is left near any army. Results of the battles fought can be
+ * written to config->output_path.
+ *
+ * @param config Ladder options
+ * @return 0 on success
+ */
+int run_ladder(const LADDER_CONFIG *config) {
+    FILE *file = fopen(config->roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+    if (roster.count < 2) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    int threads = config->threads;
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    const int n = roster.count;
+    const uint64_t matchups = matchup_count(n);
+    uint64_t budget = config->battles > 0 ? config->battles : (uint64_t) n * LADDER_BATTLES_PER_ARMY;
+    if (budget > matchups) budget = matchups;
+
+    LADDER ladder = {0};
+    ladder.roster = &roster;
+    ladder.limits = &config->limits;
+    ladder.ratings = malloc(sizeof(RATING) * n);
+    ladder.score = calloc(n, sizeof(*ladder.score));
+    ladder.by_rating = malloc(sizeof(RANKED) * n);
+    ladder.by_rd = malloc(sizeof(RANKED) * n);
+    ladder.position = malloc(sizeof(int) * n);
+    ladder.previous_rank = malloc(sizeof(int) * n);
+    ladder.used = malloc(sizeof(bool) * n);
+    ladder.pairs = malloc(sizeof(*ladder.pairs) * (n / 2));
+    ladder.results = malloc(sizeof(CRESULT) * (n / 2));
+    if (!ladder.ratings || !ladder.score || !ladder.by_rating || !ladder.by_rd || !ladder.position ||
+        !ladder.previous_rank || !ladder.used || !ladder.pairs || !ladder.results) {
+        error(ERR_MEMORY);
+    }
+    pair_set_init(&ladder.played, budget);
+    for (int i = 0; i < n; i++) {
+        ladder.ratings[i] = (RATING) {LADDER_RATING, LADDER_RD};
+    }
+    rank_armies(&ladder);
+    rank_shift(&ladder);
+    RESULT_WRITER *output = config->output_path ? result_writer_open(config->output_path, config->format, n) : NULL;
+
+    printf("Ladder over %d armies: up to %llu of %llu matchups, %d threads\n", n, (unsigned long long) budget,
+           (unsigned long long) matchups, threads);
+    const double started = now_seconds();
+    uint64_t battles = 0;
+    uint64_t batches = 0;
+    const char *stop = "battle budget spent";
+    while (battles < budget) {
+        const uint64_t left = budget - battles;
+        ladder.count = pick_pairs(&ladder, left < (uint64_t) n / 2 ? (int) left : n / 2);
+        if (ladder.count == 0) {
+            stop = "no unplayed matchup near any army";
+            break;
+        }
+        run_pairs(&ladder, threads);
+
+        // Each army plays at most once per batch, so results apply in any order
+        for (int k = 0; k < ladder.count; k++) {
+            const int a = ladder.pairs[k][0], b = ladder.pairs[k][1];
+            const int winner = ladder.results[k].winner;
+            const double score = winner == 1 ? 1.0 : winner == 2 ? 0.0 : 0.5;
+            const RATING before = ladder.ratings[a];
+            ladder.ratings[a] = glicko_update(before, &ladder.ratings[b], score);
+            ladder.ratings[b] = glicko_update(ladder.ratings[b], &before, 1.0 - score);
+            record_score(ladder.score, a, b, winner);
+            if (output) {
+                result_writer_add(output, matchup_id(a, b, n), &ladder.results[k]);
+            }
+        }
+        battles += ladder.count;
+        batches++;
+
+        rank_armies(&ladder);
+        const double shift = rank_shift(&ladder);
+        const bool converged = config->target_rd > 0 && mean_rd(&ladder) <= config->target_rd;
+        if ((batches & (batches - 1)) == 0 || converged || battles >= budget) {
+            print_progress(&ladder, battles, shift, stdout);
+        }
+        if (converged) {
+            stop = "mean RD reached the target";
+            break;
+        }
+    }
+    const double elapsed = now_seconds() - started;
+    if (output) {
+        result_writer_close(output);
+    }
+
+    printf("\n%-6s %-6s %-16s %6s %8s %6s %8s %8s %8s\n", "Rank", "Army", "Leader", "Units", "Rating", "RD", "Wins",
+           "Draws", "Losses");
+    for (int i = 0; i < n; i++) {
+        const int a = ladder.by_rating[i].army;
+        printf("%-6d %-6d %-16.16s %6d %8.1f %6.1f %8u %8u %8u\n", i + 1, a + 1,
+               interned_name(roster.armies[a]->units[0].name), roster.armies[a]->count, ladder.ratings[a].rating,
+               ladder.ratings[a].rd, ladder.score[a][0], ladder.score[a][1], ladder.score[a][2]);
+    }
+    printf("\n%llu battles (%.2f%% of the round robin) in %llu batches on %d threads in %.3f s (%.0f battles/s): %s\n",
+           (unsigned long long) battles, 100.0 * (double) battles / (double) matchups, (unsigned long long) batches,
+           threads, elapsed, elapsed > 0 ? battles / elapsed : 0.0, stop);
+
+    free(ladder.played.slots);
+    free(ladder.results);
+    free(ladder.pairs);
+    free(ladder.used);
+    free(ladder.previous_rank);
+    free(ladder.position);
+    free(ladder.by_rd);
+    free(ladder.by_rating);
+    free(ladder.score);
+    free(ladder.ratings);
+    free_roster(&roster);
+    return 0;
+}
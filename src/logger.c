@@ -54,10 +54,13 @@ void log_message(LogLevel lvl, const char *message, ...) {
     va_list args;
     va_start(args, message);
     if (log_file) {
+        va_list file_args;
+        va_copy(file_args, args);
         fprintf(log_file, "[%s] ", timestr);
-        vfprintf(log_file, message, args);
+        vfprintf(log_file, message, file_args);
         fprintf(log_file, "\n");
         fflush(log_file);
+        va_end(file_args);
     }
 
     fprintf(stderr, "[%s] ", timestr);
@@ -0,0 +1,388 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define PARALLEL_MIN_HITS 4096
+
+/**
+ * A persistent pool of threads that split the attack phase of a single battle.
+ * The calling thread takes part as participant 0; each participant computes
+ * the damage of a slice of attackers in both directions into its own
+ * accumulator, and the caller sums the accumulators before compaction.
+ */
+struct engine_pool {
+    int participants;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    uint64_t generation;
+    int remaining;
+    bool stopping;
+
+    const CUNIT *attackers[2];
+    int attack_count[2];
+    const CUNIT *defenders[2];
+    int defend_count[2];
+    const CCATALOG *catalog;
+    int window;
+    int64_t *damage;
+};
+
+/**
+ * Returns the accumulator of one participant for one attack direction.
+ *
+ * @param pool The pool
+ * @param participant Participant index
+ * @param direction 0 for army 1 attacking army 2, 1 for the reverse
+ * @return Array of pool->window damage totals indexed by defender position
+ */
+static int64_t *accumulator(ENGINE_POOL *pool, int participant, int direction) {
+    return pool->damage + ((size_t) participant * 2 + direction) * pool->window;
+}
+
+/**
+ * Adds up the damage dealt by a slice of attackers without touching defender HP.
+ * Damage depends only on the attacker's item and the defender's items, never
+ * on HP, so slices can be evaluated independently and in any order.
+ *
+ * @param attackers Attacking units
+ * @param from First attacker position of the slice
+ * @param to One past the last attacker position of the slice
+ * @param defenders Defending units
+ * @param defend_count Number of defending units
+ * @param catalog Catalog the item ids refer to
+ * @param damage Accumulator indexed by defender position
+ */
+static void accumulate(const CUNIT *attackers, int from, int to, const CUNIT *defenders, int defend_count,
+                       const CCATALOG *catalog, int64_t *damage) {
+    for (int i = from; i < to; i++) {
+        const uint8_t items[2] = {attackers[i].item1, attackers[i].item2};
+        for (int k = 0; k < 2; k++) {
+            if (items[k] == CITEM_NONE) continue;
+
+            const CITEM *stats = &catalog->items[items[k]];
+            if (stats->range < i) continue;
+
+            const int last = stats->radius < defend_count - 1 ? stats->radius : defend_count - 1;
+            for (int j = 0; j <= last; j++) {
+                int de = 0;
+                if (defenders[j].item1 != CITEM_NONE) de += catalog->items[defenders[j].item1].def;
+                if (defenders[j].item2 != CITEM_NONE) de += catalog->items[defenders[j].item2].def;
+                damage[j] += max(stats->att - de, 1);
+            }
+        }
+    }
+}
+
+/**
+ * Computes one participant's share of the current round: a contiguous slice
+ * of the attackers in each direction.
+ *
+ * @param pool The pool
+ * @param participant Participant index
+ */
+static void run_share(ENGINE_POOL *pool, int participant) {
+    static const char *const names[2] = {"attack 1->2 (share)", "attack 2->1 (share)"};
+    for (int d = 0; d < 2; d++) {
+        const uint64_t span = trace_begin();
+        int64_t *damage = accumulator(pool, participant, d);
+        memset(damage, 0, sizeof(int64_t) * pool->window);
+
+        const int count = pool->attack_count[d];
+        const int from = (int) ((int64_t) count * participant / pool->participants);
+        const int to = (int) ((int64_t) count * (participant + 1) / pool->participants);
+        accumulate(pool->attackers[d], from, to, pool->defenders[d], pool->defend_count[d], pool->catalog, damage);
+        trace_end(names[d], span);
+    }
+}
+
+/**
+ * Pool thread: waits for a new round, computes its share and reports back.
+ *
+ * @param arg Pointer to the thread's ENGINE_POOL and participant index
+ * @return Always NULL
+ */
+static void *pool_main(void *arg) {
+    ENGINE_POOL *pool = ((void **) arg)[0];
+    const int participant = (int) (intptr_t) ((void **) arg)[1];
+    free(arg);
+    trace_thread_name("engine pool");
+
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_share(pool, participant);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->remaining == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/**
+ * Creates a pool for parallel attack phases.
+ *
+ * @param threads Total number of participating threads including the caller (0 selects one per online CPU)
+ * @param catalog Catalog whose widest radius bounds the accumulator size
+ * @return The new pool
+ */
+ENGINE_POOL *engine_pool_new(int threads, const CCATALOG *catalog) {
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    ENGINE_POOL *pool = calloc(1, sizeof(ENGINE_POOL));
+    if (!pool) {
+        error(ERR_MEMORY);
+    }
+    pool->participants = threads;
+    pool->window = catalog->max_radius + 1;
+    pool->damage = malloc(sizeof(int64_t) * 2 * (size_t) pool->window * threads);
+    pool->threads = malloc(sizeof(pthread_t) * threads);
+    if (!pool->damage || !pool->threads) {
+        error(ERR_MEMORY);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    for (int p = 1; p < threads; p++) {
+        void **arg = malloc(2 * sizeof(void *));
+        if (!arg) {
+            error(ERR_MEMORY);
+        }
+        arg[0] = pool;
+        arg[1] = (void *) (intptr_t) p;
+        pthread_create(&pool->threads[p], NULL, pool_main, arg);
+    }
+    return pool;
+}
+
+/**
+ * Stops the threads of a pool and frees it.
+ *
+ * @param pool The pool to free
+ */
+void engine_pool_free(ENGINE_POOL *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int p = 1; p < pool->participants; p++) {
+        pthread_join(pool->threads[p], NULL);
+    }
+    free(pool->threads);
+    free(pool->damage);
+    free(pool);
+}
+
+/**
+ * Applies summed damage to the front of an army, saturating like item_attack().
+ *
+ * @param pool The pool holding the accumulators
+ * @param direction Attack direction whose damage to apply
+ * @param defenders Defending units
+ * @param count Number of defending units
+ */
+static void apply_damage_totals(ENGINE_POOL *pool, int direction, CUNIT *defenders, int count) {
+    const int window = pool->window < count ? pool->window : count;
+    for (int j = 0; j < window; j++) {
+        int64_t total = 0;
+        for (int p = 0; p < pool->participants; p++) {
+            total += accumulator(pool, p, direction)[j];
+        }
+        const int64_t hp = defenders[j].hp - total;
+        defenders[j].hp = (int16_t) (hp < INT16_MIN ? INT16_MIN : hp);
+    }
+}
+
+/**
+ * Runs both attack directions of one round on the pool.
+ *
+ * @param pool The pool
+ * @param a Units of the first army
+ * @param count1 Number of units of the first army
+ * @param b Units of the second army
+ * @param count2 Number of units of the second army
+ * @param catalog Catalog the item ids refer to
+ */
+static void parallel_attack(ENGINE_POOL *pool, CUNIT *a, int count1, CUNIT *b, int count2, const CCATALOG *catalog) {
+    pthread_mutex_lock(&pool->lock);
+    pool->catalog = catalog;
+    pool->attackers[0] = a;
+    pool->attack_count[0] = count1 < catalog->max_range + 1 ? count1 : catalog->max_range + 1;
+    pool->defenders[0] = b;
+    pool->defend_count[0] = count2;
+    pool->attackers[1] = b;
+    pool->attack_count[1] = count2 < catalog->max_range + 1 ? count2 : catalog->max_range + 1;
+    pool->defenders[1] = a;
+    pool->defend_count[1] = count1;
+    pool->remaining = pool->participants - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    run_share(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->remaining > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    apply_damage_totals(pool, 0, b, count2);
+    apply_damage_totals(pool, 1, a, count1);
+}
+
+/**
+ * Parallel counterpart of cbattle_round(): runs the attack phase on the pool
+ * if the round's possible hit count reaches min_hits, otherwise sequentially.
+ * The army pointers are advanced past removed units like in cbattle_round().
+ *
+ * @param pool Engine pool to run the attack phase on
+ * @param army1 In/out pointer to the units of the first army
+ * @param count1 In/out number of units of the first army
+ * @param army2 In/out pointer to the units of the second army
+ * @param count2 In/out number of units of the second army
+ * @param catalog Catalog the item ids refer to (must match the pool's catalog bounds)
+ * @param min_hits Smallest hit count worth waking the pool for (0 always uses it)
+ * @return Same result codes as battle_round()
+ */
+int cparallel_round(ENGINE_POOL *pool, CUNIT **army1, int *count1, CUNIT **army2, int *count2,
+                    const CCATALOG *catalog, int min_hits) {
+    const int window = catalog->max_radius + 1;
+    const int attack1 = *count1 < catalog->max_range + 1 ? *count1 : catalog->max_range + 1;
+    const int attack2 = *count2 < catalog->max_range + 1 ? *count2 : catalog->max_range + 1;
+    const int64_t hits = (int64_t) 2 * (attack1 + attack2) * window;
+
+    if (pool->participants < 2 || hits < min_hits) {
+        return cbattle_round(army1, count1, army2, count2, catalog);
+    }
+
+    const uint64_t round_start = trace_begin();
+    parallel_attack(pool, *army1, *count1, *army2, *count2, catalog);
+
+    const uint64_t span = trace_begin();
+    const int dead1 = ccheck_front(*army1, *count1, window);
+    const int dead2 = ccheck_front(*army2, *count2, window);
+    trace_end("check_hp", span);
+    trace_end("battle_round (parallel)", round_start);
+    *army1 += dead1;
+    *count1 -= dead1;
+    *army2 += dead2;
+    *count2 -= dead2;
+
+    if (*count1 == 0 && *count2 == 0) return 0;
+    if (*count1 == 0) return 2;
+    if (*count2 == 0) return 1;
+
+    return -1;
+}
+
+/**
+ * Simulates a battle like csimulate(), splitting the attack phase of each
+ * large round across an engine pool.
+ * Rounds whose possible hit count is below PARALLEL_MIN_HITS run sequentially,
+ * since waking the pool would cost more than it saves, and one-on-one
+ * endings are finished from the duel table. Results are bit-identical to
+ * csimulate().
+ *
+ * @param army1 The first army
+ * @param army2 The second army
+ * @param catalog Catalog the item ids refer to (must match the pool's catalog bounds)
+ * @param result Optional output with rounds, survivors and remaining HP (may be NULL)
+ * @param pool Engine pool to run large rounds on
+ * @return Final result code (0 draw, 1 army 1 wins, 2 army 2 wins)
+ */
+int csimulate_parallel(const CARMY *army1, const CARMY *army2, const CCATALOG *catalog, CRESULT *result,
+                       ENGINE_POOL *pool) {
+    CUNIT scratch[2 * SCRATCH_UNITS];
+    CUNIT *units = copy_armies(army1, army2, scratch, NULL);
+
+    CUNIT *a = units;
+    CUNIT *b = units + army1->count;
+    int count1 = army1->count;
+    int count2 = army2->count;
+
+    int rounds = 0;
+    int winner = -1;
+    while (winner == -1) {
+        if (count1 == 1 && count2 == 1 && catalog->duels) {
+            winner = duel_finish(catalog->duels, a, b, &rounds, INT32_MAX);
+            if (winner != -1) {
+                count1 = a->hp > 0;
+                count2 = b->hp > 0;
+                break;
+            }
+        }
+        winner = cparallel_round(pool, &a, &count1, &b, &count2, catalog, PARALLEL_MIN_HITS);
+        rounds++;
+    }
+    fill_result(result, winner, rounds, a, count1, b, count2);
+
+    if (units != scratch) {
+        free(units);
+    }
+    return winner;
+}
+
+/**
+ * Fights the first two armies of a roster file with the sequential compact
+ * engine and with the parallel engine, checks that both agree and reports
+ * the time taken by each.
+ *
+ * @param roster_path Path of the roster file
+ * @param threads Threads for the parallel engine (0 selects one per online CPU)
+ * @return 0 if both engines agree, 1 otherwise
+ */
+int run_mass_battle(const char *roster_path, int threads) {
+    FILE *file = fopen(roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+    if (roster.count < 2) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    CRESULT sequential, parallel;
+    double started = now_seconds();
+    csimulate(roster.armies[0], roster.armies[1], &combat_catalog, &sequential, NULL);
+    const double sequential_time = now_seconds() - started;
+
+    ENGINE_POOL *pool = engine_pool_new(threads, &combat_catalog);
+    started = now_seconds();
+    csimulate_parallel(roster.armies[0], roster.armies[1], &combat_catalog, &parallel, pool);
+    const double parallel_time = now_seconds() - started;
+
+    printf("Mass battle: %d vs %d units\n", roster.armies[0]->count, roster.armies[1]->count);
+    printf("  result %d after %d rounds, survivors %d (%d HP) vs %d (%d HP)\n",
+           sequential.winner, sequential.rounds, sequential.survivors1, sequential.hp1,
+           sequential.survivors2, sequential.hp2);
+    printf("  sequential %.3f s, parallel (%d threads) %.3f s\n", sequential_time, pool->participants, parallel_time);
+
+    const bool same = memcmp(&sequential, &parallel, sizeof(CRESULT)) == 0;
+    printf("  engines %s\n", same ? "agree" : "DISAGREE");
+
+    engine_pool_free(pool);
+    free_roster(&roster);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,406 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define OUTCOME_DB_MAGIC "BAOUTDB1"
+#define OUTCOME_DB_MAX_LOAD 0.75
+#define KEY_SEED_1 0x243f6a8885a308d3ull
+#define KEY_SEED_2 0x13198a2e03707344ull
+
+/**
+ * File header. The slot table follows immediately after it.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t catalog_version;
+    uint64_t capacity;
+    _Atomic uint64_t count;
+    uint8_t reserved[32];
+} DB_HEADER;
+
+/**
+ * One open-addressing slot: a 128-bit matchup key and the outcome seen from
+ * the canonical side. A slot is published by storing `key` last, so readers
+ * that observe a non-zero key always see a complete entry.
+ */
+typedef struct {
+    _Atomic uint64_t key;
+    uint64_t check;
+    uint32_t rounds;
+    uint32_t hp1;
+    uint32_t hp2;
+    uint16_t survivors1;
+    uint16_t survivors2;
+} DB_SLOT;
+
+/**
+ * An open outcome database.
+ */
+struct outcome_db {
+    int fd;
+    int lock_fd;
+    bool writable;
+    bool full_warned;
+    DB_HEADER *header;
+    DB_SLOT *slots;
+    size_t mapped;
+    pthread_mutex_t write_lock;
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong stores;
+};
+
+/**
+ * Computes a version stamp of a catalog from every stat of every item, so that
+ * any change to items.json changes the version.
+ *
+ * @param list The item list
+ * @return 64-bit FNV-1a hash of the catalog contents
+ */
+uint64_t catalog_version(const ITEM_LIST *list) {
+    uint64_t h = 14695981039346656037ull;
+    for (int i = 0; i < list->count; i++) {
+        const ITEM *item = &list->items[i];
+        const unsigned int stats[5] = {item->att, item->def, item->slots, item->range, item->radius};
+        for (const char *c = item->name; *c; c++) {
+            h = (h ^ (uint8_t) *c) * 1099511628211ull;
+        }
+        h = (h ^ 0xFF) * 1099511628211ull;
+        for (int k = 0; k < 5; k++) {
+            for (int b = 0; b < 4; b++) {
+                h = (h ^ ((stats[k] >> (8 * b)) & 0xFF)) * 1099511628211ull;
+            }
+        }
+    }
+    return h;
+}
+
+/**
+ * Builds the 128-bit canonical key of a matchup.
+ * The battle is symmetric (both attack phases read only items, never HP),
+ * so (a, b) and (b, a) share one entry; `swapped` tells the caller whether
+ * the entry is stored from b's point of view.
+ *
+ * @param a The first army
+ * @param b The second army
+ * @param key Output primary key (never 0)
+ * @param check Output secondary key
+ * @param swapped Output flag set if b is the canonical first army
+ */
+static void matchup_key(const CARMY *a, const CARMY *b, uint64_t *key, uint64_t *check, bool *swapped) {
+    uint64_t ha = carmy_hash(a, KEY_SEED_1);
+    uint64_t hb = carmy_hash(b, KEY_SEED_1);
+    uint64_t ca = carmy_hash(a, KEY_SEED_2);
+    uint64_t cb = carmy_hash(b, KEY_SEED_2);
+
+    *swapped = ha > hb || (ha == hb && ca > cb);
+    if (*swapped) {
+        uint64_t t = ha; ha = hb; hb = t;
+        t = ca; ca = cb; cb = t;
+    }
+
+    *key = mix64(ha * 0x9e3779b97f4a7c15ull + hb);
+    *check = mix64(ca * 0xc2b2ae3d27d4eb4full + cb);
+    if (*key == 0) {
+        *key = 1;
+    }
+}
+
+/**
+ * Creates a fresh, empty database file and atomically moves it into place,
+ * so readers never observe a half-written header.
+ *
+ * @param path Database path
+ * @param version Catalog version to stamp
+ * @param capacity Number of slots (power of two)
+ * @return true on success
+ */
+static bool create_file(const char *path, uint64_t version, uint64_t capacity) {
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    const int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+
+    DB_HEADER header = {0};
+    memcpy(header.magic, OUTCOME_DB_MAGIC, 8);
+    header.catalog_version = version;
+    header.capacity = capacity;
+
+    const off_t size = (off_t) (sizeof(DB_HEADER) + sizeof(DB_SLOT) * capacity);
+    const bool ok = ftruncate(fd, size) == 0 &&
+                    pwrite(fd, &header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+                    fsync(fd) == 0;
+    close(fd);
+    return ok && rename(tmp, path) == 0;
+}
+
+/**
+ * Maps an existing database file and checks its header.
+ *
+ * @param db Database being opened
+ * @param path Database path
+ * @param version Expected catalog version
+ * @return true if the file is valid for this catalog
+ */
+static bool map_file(OUTCOME_DB *db, const char *path, uint64_t version) {
+    db->fd = open(path, (db->writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (db->fd < 0) return false;
+
+    struct stat st;
+    if (fstat(db->fd, &st) < 0 || (size_t) st.st_size < sizeof(DB_HEADER)) {
+        close(db->fd);
+        return false;
+    }
+
+    const int prot = db->writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    void *map = mmap(NULL, (size_t) st.st_size, prot, MAP_SHARED, db->fd, 0);
+    if (map == MAP_FAILED) {
+        close(db->fd);
+        return false;
+    }
+
+    DB_HEADER *header = map;
+    const uint64_t capacity = header->capacity;
+    if (memcmp(header->magic, OUTCOME_DB_MAGIC, 8) != 0 || header->catalog_version != version ||
+        capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        (size_t) st.st_size != sizeof(DB_HEADER) + sizeof(DB_SLOT) * capacity) {
+        munmap(map, (size_t) st.st_size);
+        close(db->fd);
+        return false;
+    }
+
+    db->header = header;
+    db->slots = (DB_SLOT *) (header + 1);
+    db->mapped = (size_t) st.st_size;
+    return true;
+}
+
+/**
+ * Opens (or creates) a memory-mapped outcome database.
+ * Any number of processes may read concurrently; one process at a time may
+ * write, enforced with an advisory lock on "<path>.lock". If another writer
+ * holds the lock the database is opened read-only. A database stamped with a
+ * different catalog version is discarded and recreated by the writer; readers
+ * treat it as empty.
+ *
+ * @param path Database path
+ * @param version Catalog version, from catalog_version()
+ * @param capacity Number of slots for a new database (rounded up to a power of two)
+ * @param writable Whether this process wants to add outcomes
+ * @return The database handle; never NULL (an unusable database behaves as empty)
+ */
+OUTCOME_DB *outcome_db_open(const char *path, uint64_t version, uint64_t capacity, bool writable) {
+    OUTCOME_DB *db = calloc(1, sizeof(OUTCOME_DB));
+    if (!db) {
+        error(ERR_MEMORY);
+    }
+    db->fd = -1;
+    db->lock_fd = -1;
+    pthread_mutex_init(&db->write_lock, NULL);
+
+    if (writable) {
+        char lock_path[4096];
+        snprintf(lock_path, sizeof(lock_path), "%s.lock", path);
+        db->lock_fd = open(lock_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (db->lock_fd >= 0 && flock(db->lock_fd, LOCK_EX | LOCK_NB) == 0) {
+            db->writable = true;
+        } else {
+            warning(ERR_DB_LOCKED);
+            if (db->lock_fd >= 0) {
+                close(db->lock_fd);
+                db->lock_fd = -1;
+            }
+        }
+    }
+
+    if (!map_file(db, path, version)) {
+        if (!db->writable) {
+            return db;
+        }
+
+        uint64_t slots = 1024;
+        while (slots < capacity) slots <<= 1;
+        if (!create_file(path, version, slots) || !map_file(db, path, version)) {
+            warning(ERR_FILE);
+            db->writable = false;
+        }
+    }
+    return db;
+}
+
+/**
+ * Looks up the outcome of a matchup. Lock-free and zero-copy: the entry is
+ * read directly from the mapping.
+ *
+ * @param db The database
+ * @param a The first army
+ * @param b The second army
+ * @param result Output outcome from a's point of view
+ * @return true if the outcome was found
+ */
+bool outcome_db_lookup(OUTCOME_DB *db, const CARMY *a, const CARMY *b, CRESULT *result) {
+    if (!db->header) {
+        atomic_fetch_add(&db->misses, 1);
+        return false;
+    }
+
+    uint64_t key, check;
+    bool swapped;
+    matchup_key(a, b, &key, &check, &swapped);
+
+    const uint64_t mask = db->header->capacity - 1;
+    for (uint64_t i = key & mask;; i = (i + 1) & mask) {
+        const DB_SLOT *slot = &db->slots[i];
+        const uint64_t stored = atomic_load_explicit(&slot->key, memory_order_acquire);
+        if (stored == 0) break;
+        if (stored != key || slot->check != check) continue;
+
+        result->rounds = (int) slot->rounds;
+        result->survivors1 = swapped ? slot->survivors2 : slot->survivors1;
+        result->survivors2 = swapped ? slot->survivors1 : slot->survivors2;
+        result->hp1 = (int) (swapped ? slot->hp2 : slot->hp1);
+        result->hp2 = (int) (swapped ? slot->hp1 : slot->hp2);
+        if (result->survivors1 == 0 && result->survivors2 == 0) result->winner = 0;
+        else if (result->survivors1 == 0) result->winner = 2;
+        else result->winner = 1;
+
+        atomic_fetch_add(&db->hits, 1);
+        return true;
+    }
+
+    atomic_fetch_add(&db->misses, 1);
+    return false;
+}
+
+/**
+ * Appends the outcome of a matchup. Ignored when the database is read-only or
+ * has reached its load limit.
+ *
+ * @param db The database
+ * @param a The first army
+ * @param b The second army
+ * @param result Outcome from a's point of view
+ */
+void outcome_db_store(OUTCOME_DB *db, const CARMY *a, const CARMY *b, const CRESULT *result) {
+    if (!db->writable) return;
+
+    uint64_t key, check;
+    bool swapped;
+    matchup_key(a, b, &key, &check, &swapped);
+
+    pthread_mutex_lock(&db->write_lock);
+    const uint64_t capacity = db->header->capacity;
+    if (atomic_load(&db->header->count) >= (uint64_t) (capacity * OUTCOME_DB_MAX_LOAD)) {
+        if (!db->full_warned) {
+            warning(ERR_DB_FULL);
+            db->full_warned = true;
+        }
+        pthread_mutex_unlock(&db->write_lock);
+        return;
+    }
+
+    for (uint64_t i = key & (capacity - 1);; i = (i + 1) & (capacity - 1)) {
+        DB_SLOT *slot = &db->slots[i];
+        const uint64_t stored = atomic_load_explicit(&slot->key, memory_order_relaxed);
+        if (stored == key && slot->check == check) break;
+        if (stored != 0) continue;
+
+        slot->check = check;
+        slot->rounds = (uint32_t) result->rounds;
+        slot->survivors1 = (uint16_t) (swapped ? result->survivors2 : result->survivors1);
+        slot->survivors2 = (uint16_t) (swapped ? result->survivors1 : result->survivors2);
+        slot->hp1 = (uint32_t) (swapped ? result->hp2 : result->hp1);
+        slot->hp2 = (uint32_t) (swapped ? result->hp1 : result->hp2);
+        atomic_store_explicit(&slot->key, key, memory_order_release);
+        atomic_fetch_add(&db->header->count, 1);
+        atomic_fetch_add(&db->stores, 1);
+        break;
+    }
+    pthread_mutex_unlock(&db->write_lock);
+}
+
+/**
+ * Looks a matchup up in an outcome database, if there is one, for a run
+ * under battle limits. Stored outcomes are battles fought to the end, so
+ * one that lasted longer than the round cap does not count; the battle is
+ * simulated again and times out. With decide_early the database is not
+ * used at all: rows then end where the winner became certain, and a stored
+ * full battle would not match them.
+ *
+ * @param db The database, or NULL
+ * @param limits Battle limits of the run
+ * @param a The first army
+ * @param b The second army
+ * @param result Output outcome
+ * @return true if the outcome was found and applies under the limits
+ */
+bool lookup_outcome(OUTCOME_DB *db, const BATTLE_LIMITS *limits, const CARMY *a, const CARMY *b, CRESULT *result) {
+    if (!db || limits->decide_early || !outcome_db_lookup(db, a, b, result)) return false;
+    return limits->max_rounds <= 0 || result->rounds <= limits->max_rounds;
+}
+
+/**
+ * Stores the outcome of a battle simulated under battle limits, if there is
+ * a database. Only battles fought to the end are stored; cut-off ones
+ * depend on the limits.
+ *
+ * @param db The database, or NULL
+ * @param limits Battle limits of the run
+ * @param a The first army
+ * @param b The second army
+ * @param result Outcome from a's point of view
+ */
+void store_outcome(OUTCOME_DB *db, const BATTLE_LIMITS *limits, const CARMY *a, const CARMY *b,
+                   const CRESULT *result) {
+    if (db && !limits->decide_early && (result->survivors1 == 0 || result->survivors2 == 0)) {
+        outcome_db_store(db, a, b, result);
+    }
+}
+
+/**
+ * Prints lookup and store counters of a database.
+ *
+ * @param db The database
+ * @param out Stream to print to
+ */
+void outcome_db_report(OUTCOME_DB *db, FILE *out) {
+    const unsigned long hits = atomic_load(&db->hits);
+    const unsigned long misses = atomic_load(&db->misses);
+    fprintf(out, "Outcome DB: %lu hits, %lu misses (%.1f%% hit rate), %lu stored, %llu/%llu slots used%s\n",
+            hits, misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0, atomic_load(&db->stores),
+            db->header ? (unsigned long long) atomic_load(&db->header->count) : 0ull,
+            db->header ? (unsigned long long) db->header->capacity : 0ull,
+            db->writable ? "" : " (read-only)");
+}
+
+/**
+ * Flushes and closes a database.
+ *
+ * @param db The database to close
+ */
+void outcome_db_close(OUTCOME_DB *db) {
+    if (db->header) {
+        if (db->writable) {
+            msync(db->header, db->mapped, MS_SYNC);
+        }
+        munmap(db->header, db->mapped);
+    }
+    if (db->fd >= 0) {
+        close(db->fd);
+    }
+    if (db->lock_fd >= 0) {
+        close(db->lock_fd);
+    }
+    pthread_mutex_destroy(&db->write_lock);
+    free(db);
+}
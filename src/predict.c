@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+/**
+ * Converts a unit to compact form for prediction. The name field is
+ * replaced by the unit's position in its army, which lets a recorded round
+ * tell which of the original units are still alive.
+ *
+ * @param unit The unit
+ * @param index Position of the unit in its army
+ * @return The compact unit
+ */
+static CUNIT predict_unit(const UNIT *unit, int index) {
+    CUNIT c;
+    c.item1 = (uint8_t) (unit->item1 - item_list.items);
+    c.item2 = unit->item2 ? (uint8_t) (unit->item2 - item_list.items) : CITEM_NONE;
+    c.hp = (int16_t) unit->hp;
+    c.name = (uint16_t) index;
+    return c;
+}
+
+/**
+ * Returns the longest range among the items of a compact unit.
+ *
+ * @param unit The unit
+ * @return Longest item range
+ */
+static int unit_range(const CUNIT *unit) {
+    int range = combat_catalog.items[unit->item1].range;
+    if (unit->item2 != CITEM_NONE && combat_catalog.items[unit->item2].range > range) {
+        range = combat_catalog.items[unit->item2].range;
+    }
+    return range;
+}
+
+/**
+ * Returns the widest radius among the items of a compact unit.
+ *
+ * @param unit The unit
+ * @return Widest item radius
+ */
+static int unit_radius(const CUNIT *unit) {
+    int radius = combat_catalog.items[unit->item1].radius;
+    if (unit->item2 != CITEM_NONE && combat_catalog.items[unit->item2].radius > radius) {
+        radius = combat_catalog.items[unit->item2].radius;
+    }
+    return radius;
+}
+
+/**
+ * Appends a battle state to the predictor's round history.
+ *
+ * @param p The predictor
+ * @param state State to append
+ */
+static void push_state(PREDICTOR *p, const PREDICT_STATE *state) {
+    if (p->state_count == p->capacity) {
+        p->capacity = p->capacity ? p->capacity * 2 : 64;
+        PREDICT_STATE *states = realloc(p->states, sizeof(PREDICT_STATE) * p->capacity);
+        if (!states) {
+            error(ERR_MEMORY);
+        }
+        p->states = states;
+    }
+    p->states[p->state_count++] = *state;
+}
+
+/**
+ * Recomputes the prediction after the units of one army changed from index
+ * `first` onwards.
+ *
+ * A changed unit cannot influence the battle while it is out of reach: it
+ * only attacks once its position is within the range of its items, and is
+ * only hit once its position is within the radius of an enemy item. Its
+ * position is the number of living units ahead of it, which only shrinks.
+ * So every recorded round in which more than `bound` units are still ahead
+ * of the change is identical in the new battle, and simulation resumes from
+ * the first round where that no longer holds.
+ *
+ * @param p The predictor
+ * @param side Army that changed (0 or 1)
+ * @param first Index of the first changed unit
+ * @param changed_range Longest range among the old and new units from `first` on
+ */
+static void update(PREDICTOR *p, int side, int first, int changed_range) {
+    const double started = now_seconds();
+    p->replayed = 0;
+
+    if (p->count[0] == 0 || p->count[1] == 0) {
+        p->valid = false;
+        p->state_count = 0;
+        p->elapsed = now_seconds() - started;
+        return;
+    }
+
+    int bound = changed_range;
+    for (int i = 0; i < p->count[1 - side]; i++) {
+        const int radius = unit_radius(&p->army[1 - side][i]);
+        if (radius > bound) bound = radius;
+    }
+
+    int resume = 0;
+    if (p->state_count > 0) {
+        while (resume < p->state_count - 1) {
+            const PREDICT_STATE *state = &p->states[resume];
+            int ahead = 0;
+            for (int i = 0; i < state->count[side]; i++) {
+                if (state->units[side][i].name < first) ahead++;
+            }
+            if (ahead <= bound) break;
+            resume++;
+        }
+    }
+
+    // Up to the resume round the changed units are untouched, so the recorded
+    // states keep the units ahead of the change and take the new units fresh
+    PREDICT_STATE state;
+    if (p->state_count > 0) {
+        for (int r = 0; r <= resume; r++) {
+            PREDICT_STATE *recorded = &p->states[r];
+            int count = 0;
+            for (int i = 0; i < recorded->count[side]; i++) {
+                if (recorded->units[side][i].name < first) {
+                    recorded->units[side][count++] = recorded->units[side][i];
+                }
+            }
+            for (int i = first; i < p->count[side]; i++) {
+                recorded->units[side][count++] = p->army[side][i];
+            }
+            recorded->count[side] = (uint8_t) count;
+        }
+        state = p->states[resume];
+    } else {
+        for (int s = 0; s < 2; s++) {
+            memcpy(state.units[s], p->army[s], sizeof(CUNIT) * p->count[s]);
+            state.count[s] = (uint8_t) p->count[s];
+        }
+    }
+    p->state_count = resume;
+
+    int winner = -1;
+    while (1) {
+        push_state(p, &state);
+        if (state.count[0] == 0 || state.count[1] == 0) {
+            winner = state.count[0] == 0 ? (state.count[1] == 0 ? 0 : 2) : 1;
+            break;
+        }
+
+        CUNIT *a = state.units[0];
+        CUNIT *b = state.units[1];
+        int count1 = state.count[0];
+        int count2 = state.count[1];
+        cbattle_round(&a, &count1, &b, &count2, &combat_catalog);
+        memmove(state.units[0], a, sizeof(CUNIT) * count1);
+        memmove(state.units[1], b, sizeof(CUNIT) * count2);
+        state.count[0] = (uint8_t) count1;
+        state.count[1] = (uint8_t) count2;
+        p->replayed++;
+    }
+
+    const PREDICT_STATE *last = &p->states[p->state_count - 1];
+    fill_result(&p->result, winner, p->state_count - 1, last->units[0], last->count[0], last->units[1], last->count[1]);
+    p->valid = true;
+    p->elapsed = now_seconds() - started;
+}
+
+/**
+ * Initializes an empty predictor.
+ *
+ * @param p The predictor
+ */
+void predictor_init(PREDICTOR *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+/**
+ * Releases the round history of a predictor.
+ *
+ * @param p The predictor
+ */
+void predictor_free(PREDICTOR *p) {
+    free(p->states);
+    memset(p, 0, sizeof(*p));
+}
+
+/**
+ * Replaces a whole army of the predicted battle.
+ *
+ * @param p The predictor
+ * @param side 0 for army 1, 1 for army 2
+ * @param army The new army (NULL for an empty army)
+ */
+void predictor_set_army(PREDICTOR *p, int side, const ARMY *army) {
+    const int count = army ? army->top + 1 : 0;
+
+    int range = 0;
+    for (int i = 0; i < p->count[side]; i++) {
+        const int r = unit_range(&p->army[side][i]);
+        if (r > range) range = r;
+    }
+    for (int i = 0; i < count; i++) {
+        p->army[side][i] = predict_unit(&army->units[i], i);
+        const int r = unit_range(&p->army[side][i]);
+        if (r > range) range = r;
+    }
+    p->count[side] = count;
+    update(p, side, 0, range);
+}
+
+/**
+ * Replaces the unit at a position of an army, or appends it if the position
+ * is the current size of the army.
+ *
+ * @param p The predictor
+ * @param side 0 for army 1, 1 for army 2
+ * @param index Position of the unit (at most the current army size, below MAX_ARMY)
+ * @param unit The unit; its items must be from item_list
+ */
+void predictor_set_unit(PREDICTOR *p, int side, int index, const UNIT *unit) {
+    if (index < 0 || index > p->count[side] || index >= MAX_ARMY) return;
+
+    int range = index < p->count[side] ? unit_range(&p->army[side][index]) : 0;
+    p->army[side][index] = predict_unit(unit, index);
+    const int r = unit_range(&p->army[side][index]);
+    if (r > range) range = r;
+    if (index == p->count[side]) {
+        p->count[side]++;
+    }
+    update(p, side, index, range);
+}
+
+/**
+ * Shortens an army of the predicted battle.
+ *
+ * @param p The predictor
+ * @param side 0 for army 1, 1 for army 2
+ * @param count New number of units (no more than the current size)
+ */
+void predictor_truncate(PREDICTOR *p, int side, int count) {
+    if (count < 0 || count >= p->count[side]) return;
+
+    int range = 0;
+    for (int i = count; i < p->count[side]; i++) {
+        const int r = unit_range(&p->army[side][i]);
+        if (r > range) range = r;
+    }
+    p->count[side] = count;
+    update(p, side, count, range);
+}
@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+/**
+ * Writes a 16-bit unsigned integer in little-endian byte order.
+ *
+ * @param p Destination buffer (at least 2 bytes)
+ * @param v Value to write
+ */
+void wire_put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+/**
+ * Writes a 32-bit unsigned integer in little-endian byte order.
+ *
+ * @param p Destination buffer (at least 4 bytes)
+ * @param v Value to write
+ */
+void wire_put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+    p[2] = (uint8_t) (v >> 16);
+    p[3] = (uint8_t) (v >> 24);
+}
+
+/**
+ * Reads a little-endian 16-bit unsigned integer.
+ *
+ * @param p Source buffer (at least 2 bytes)
+ * @return The decoded value
+ */
+uint16_t wire_get_u16(const uint8_t *p) {
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+/**
+ * Reads a little-endian 32-bit unsigned integer.
+ *
+ * @param p Source buffer (at least 4 bytes)
+ * @return The decoded value
+ */
+uint32_t wire_get_u32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+ * Encodes an army into the compact wire format used by the server protocol.
+ *
+ * Layout:
+ *   u8  unit count (1..MAX_ARMY)
+ *   per unit:
+ *     u8  item1 index into item_list
+ *     u8  item2 index into item_list, or WIRE_NO_ITEM
+ *     u16 hp
+ *
+ * Unit names are not transmitted; combat does not depend on them.
+ *
+ * @param army The army to encode
+ * @param buf Destination buffer of at least WIRE_ARMY_MAX bytes
+ * @return Number of bytes written
+ */
+size_t encode_army(const ARMY *army, uint8_t *buf) {
+    size_t n = 0;
+    buf[n++] = (uint8_t) (army->top + 1);
+
+    for (int i = 0; i <= army->top; i++) {
+        const UNIT *unit = &army->units[i];
+        buf[n++] = unit->item1 ? (uint8_t) (unit->item1 - item_list.items) : WIRE_NO_ITEM;
+        buf[n++] = unit->item2 ? (uint8_t) (unit->item2 - item_list.items) : WIRE_NO_ITEM;
+        wire_put_u16(buf + n, (uint16_t) unit->hp);
+        n += 2;
+    }
+    return n;
+}
+
+/**
+ * Decodes and validates an army from the wire format.
+ * Every unit must have a first item, reference items that exist in item_list,
+ * respect the slot limit and have positive HP, so that a decoded matchup is
+ * guaranteed to terminate. HP above INT16_MAX is rejected: the compact
+ * engine keeps HP in 16 bits, and every engine must see the same army.
+ *
+ * @param buf Source buffer
+ * @param len Number of bytes available in buf
+ * @param army Destination army, initialized by this function
+ * @return Number of bytes consumed, or -1 if the data is truncated or invalid
+ */
+int decode_army(const uint8_t *buf, size_t len, ARMY *army) {
+    if (len < 1) return -1;
+
+    const int count = buf[0];
+    if (count < MIN_ARMY || count > MAX_ARMY) return -1;
+    if (len < 1 + (size_t) count * WIRE_UNIT_SIZE) return -1;
+
+    init_army(army);
+    const uint8_t *p = buf + 1;
+    for (int i = 0; i < count; i++, p += WIRE_UNIT_SIZE) {
+        UNIT unit = {0};
+
+        if (p[0] >= item_list.count) return -1;
+        unit.item1 = &item_list.items[p[0]];
+
+        if (p[1] != WIRE_NO_ITEM) {
+            if (p[1] >= item_list.count) return -1;
+            unit.item2 = &item_list.items[p[1]];
+        }
+
+        unit.hp = wire_get_u16(p + 2);
+        if (unit.hp <= 0 || unit.hp > INT16_MAX || !check_slots(unit)) return -1;
+
+        push(army, unit);
+    }
+    return 1 + count * WIRE_UNIT_SIZE;
+}
@@ -0,0 +1,406 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+/**
+ * Foreground and background of each color pair, indexed by pair number.
+ * init_gui() registers them with ncurses; the cell buffer keeps pair numbers
+ * and exporters map them back through this table.
+ */
+const short render_palette[RENDER_PAIRS][2] = {
+    [COLOR_TITLE] = {COLOR_YELLOW, COLOR_BLACK},
+    [COLOR_MENU] = {COLOR_WHITE, COLOR_BLUE},
+    [COLOR_SELECTED] = {COLOR_BLACK, COLOR_CYAN},
+    [COLOR_HP_GOOD] = {COLOR_GREEN, COLOR_BLACK},
+    [COLOR_HP_MID] = {COLOR_YELLOW, COLOR_BLACK},
+    [COLOR_HP_LOW] = {COLOR_RED, COLOR_BLACK},
+    [COLOR_BATTLE_INFO] = {COLOR_CYAN, COLOR_BLACK},
+    [COLOR_ARMY1] = {COLOR_BLUE, COLOR_BLACK},
+    [COLOR_ARMY2] = {COLOR_RED, COLOR_BLACK},
+};
+
+/**
+ * Converts a render attribute to ncurses attributes.
+ *
+ * @param attr Color pair number, optionally with RENDER_BOLD
+ * @return ncurses attributes
+ */
+static attr_t curses_attr(int attr) {
+    return COLOR_PAIR(attr & RENDER_PAIR_MASK) | (attr & RENDER_BOLD ? A_BOLD : 0);
+}
+
+/**
+ * Maps a line-drawing glyph to its ncurses character.
+ *
+ * @param glyph Unicode code point
+ * @return ncurses character
+ */
+static chtype curses_glyph(uint32_t glyph) {
+    switch (glyph) {
+        case RENDER_HLINE: return ACS_HLINE;
+        case RENDER_VLINE: return ACS_VLINE;
+        case RENDER_ULCORNER: return ACS_ULCORNER;
+        case RENDER_URCORNER: return ACS_URCORNER;
+        case RENDER_LLCORNER: return ACS_LLCORNER;
+        case RENDER_LRCORNER: return ACS_LRCORNER;
+        default: return glyph < 0x80 ? (chtype) glyph : '?';
+    }
+}
+
+/**
+ * Clears the terminal screen.
+ *
+ * @param r The backend
+ */
+static void curses_clear(RENDER *r) {
+    (void) r;
+    clear();
+}
+
+/**
+ * Draws a border around the terminal screen.
+ *
+ * @param r The backend
+ */
+static void curses_border(RENDER *r) {
+    (void) r;
+    box(stdscr, 0, 0);
+}
+
+/**
+ * Prints text on the terminal with the current attributes.
+ *
+ * @param r The backend
+ * @param y Row
+ * @param x Column
+ * @param text The text
+ */
+static void curses_text(RENDER *r, int y, int x, const char *text) {
+    attron(curses_attr(r->attr));
+    mvprintw(y, x, "%s", text);
+    attroff(curses_attr(r->attr));
+}
+
+/**
+ * Draws one glyph on the terminal with the current attributes.
+ *
+ * @param r The backend
+ * @param y Row
+ * @param x Column
+ * @param glyph ASCII character or RENDER_* code point
+ */
+static void curses_put_glyph(RENDER *r, int y, int x, uint32_t glyph) {
+    attron(curses_attr(r->attr));
+    mvaddch(y, x, curses_glyph(glyph));
+    attroff(curses_attr(r->attr));
+}
+
+/**
+ * Refreshes the terminal.
+ *
+ * @param r The backend
+ */
+static void curses_present(RENDER *r) {
+    (void) r;
+    refresh();
+}
+
+/**
+ * Sleeps between animation frames.
+ *
+ * @param r The backend
+ * @param usec Delay in microseconds
+ */
+static void curses_pause(RENDER *r, unsigned int usec) {
+    (void) r;
+    usleep(usec);
+}
+
+/**
+ * Waits for a key press on the terminal.
+ *
+ * @param r The backend
+ * @return The key
+ */
+static int curses_wait_key(RENDER *r) {
+    (void) r;
+    return getch();
+}
+
+/**
+ * Backend drawing to stdscr, the default target.
+ */
+static RENDER curses_backend = {
+    curses_clear, curses_border, curses_text, curses_put_glyph, curses_present, curses_pause, curses_wait_key, 0,
+};
+
+static RENDER *target = &curses_backend;
+
+/**
+ * Returns the backend that draws to the real terminal through ncurses.
+ *
+ * @return The ncurses backend
+ */
+RENDER *render_curses(void) {
+    return &curses_backend;
+}
+
+/**
+ * Selects the backend the drawing functions go to.
+ *
+ * @param r The backend
+ * @return The previously selected backend
+ */
+RENDER *render_use(RENDER *r) {
+    RENDER *previous = target;
+    target = r;
+    return previous;
+}
+
+/**
+ * Clears the screen.
+ */
+void render_clear(void) {
+    target->attr = 0;
+    target->clear_screen(target);
+}
+
+/**
+ * Draws a border around the whole screen.
+ */
+void render_border(void) {
+    target->draw_border(target);
+}
+
+/**
+ * Turns on attributes for the following drawing, like attron().
+ *
+ * @param attr Color pair number, optionally with RENDER_BOLD
+ */
+void render_attron(int attr) {
+    if (attr & RENDER_PAIR_MASK) {
+        target->attr &= ~RENDER_PAIR_MASK;
+    }
+    target->attr |= attr;
+}
+
+/**
+ * Turns off attributes, like attroff().
+ *
+ * @param attr Color pair number, optionally with RENDER_BOLD
+ */
+void render_attroff(int attr) {
+    if ((attr & RENDER_PAIR_MASK) == (target->attr & RENDER_PAIR_MASK)) {
+        target->attr &= ~RENDER_PAIR_MASK;
+    }
+    target->attr &= ~(attr & ~RENDER_PAIR_MASK);
+}
+
+/**
+ * Prints formatted text at a position, like mvprintw().
+ *
+ * @param y Row
+ * @param x Column
+ * @param format printf-style format
+ */
+void render_printw(int y, int x, const char *format, ...) {
+    char text[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    target->draw_text(target, y, x, text);
+}
+
+/**
+ * Draws one character or line-drawing glyph, like mvaddch().
+ *
+ * @param y Row
+ * @param x Column
+ * @param glyph ASCII character or RENDER_* line-drawing code point
+ */
+void render_glyph(int y, int x, uint32_t glyph) {
+    target->draw_glyph(target, y, x, glyph);
+}
+
+/**
+ * Shows what was drawn since the last call, like refresh().
+ */
+void render_present(void) {
+    target->present(target);
+}
+
+/**
+ * Waits between animation frames. Headless backends only advance their
+ * clock, so rendering runs faster than real time.
+ *
+ * @param usec Delay in microseconds
+ */
+void render_pause(unsigned int usec) {
+    target->pause(target, usec);
+}
+
+/**
+ * Waits for a key press. Headless backends advance their clock by their
+ * key delay instead.
+ *
+ * @return The key, or 0 for headless backends
+ */
+int render_wait_key(void) {
+    return target->wait_key(target);
+}
+
+/**
+ * Returns the cell of a buffer at a position, or NULL if it is off screen.
+ *
+ * @param buffer The buffer
+ * @param y Row
+ * @param x Column
+ * @return The cell or NULL
+ */
+static RENDER_CELL *cell_at(RENDER_BUFFER *buffer, int y, int x) {
+    if (y < 0 || y >= buffer->rows || x < 0 || x >= buffer->cols) return NULL;
+    return &buffer->cells[(size_t) y * buffer->cols + x];
+}
+
+/**
+ * Fills a buffer with blank cells.
+ *
+ * @param r The buffer backend
+ */
+static void buffer_clear(RENDER *r) {
+    RENDER_BUFFER *buffer = (RENDER_BUFFER *) r;
+    for (size_t i = 0; i < (size_t) buffer->rows * buffer->cols; i++) {
+        buffer->cells[i].ch = ' ';
+        buffer->cells[i].attr = 0;
+    }
+}
+
+/**
+ * Stores one glyph with the current attributes; off-screen positions are ignored.
+ *
+ * @param r The buffer backend
+ * @param y Row
+ * @param x Column
+ * @param glyph ASCII character or RENDER_* code point
+ */
+static void buffer_put_glyph(RENDER *r, int y, int x, uint32_t glyph) {
+    RENDER_CELL *cell = cell_at((RENDER_BUFFER *) r, y, x);
+    if (cell) {
+        cell->ch = glyph;
+        cell->attr = (uint16_t) r->attr;
+    }
+}
+
+/**
+ * Draws a border along the edges of a buffer.
+ *
+ * @param r The buffer backend
+ */
+static void buffer_border(RENDER *r) {
+    RENDER_BUFFER *buffer = (RENDER_BUFFER *) r;
+    const int bottom = buffer->rows - 1;
+    const int right = buffer->cols - 1;
+    for (int x = 1; x < right; x++) {
+        buffer_put_glyph(r, 0, x, RENDER_HLINE);
+        buffer_put_glyph(r, bottom, x, RENDER_HLINE);
+    }
+    for (int y = 1; y < bottom; y++) {
+        buffer_put_glyph(r, y, 0, RENDER_VLINE);
+        buffer_put_glyph(r, y, right, RENDER_VLINE);
+    }
+    buffer_put_glyph(r, 0, 0, RENDER_ULCORNER);
+    buffer_put_glyph(r, 0, right, RENDER_URCORNER);
+    buffer_put_glyph(r, bottom, 0, RENDER_LLCORNER);
+    buffer_put_glyph(r, bottom, right, RENDER_LRCORNER);
+}
+
+/**
+ * Stores text one cell per character, clipped at the screen edge.
+ *
+ * @param r The buffer backend
+ * @param y Row
+ * @param x Column
+ * @param text The text
+ */
+static void buffer_text(RENDER *r, int y, int x, const char *text) {
+    for (; *text; text++, x++) {
+        if (*text == '\n') break;
+        buffer_put_glyph(r, y, x, (unsigned char) *text);
+    }
+}
+
+/**
+ * Counts a frame and hands it to the buffer's frame callback.
+ *
+ * @param r The buffer backend
+ */
+static void buffer_present(RENDER *r) {
+    RENDER_BUFFER *buffer = (RENDER_BUFFER *) r;
+    buffer->frames++;
+    if (buffer->on_present) {
+        buffer->on_present(buffer, buffer->context);
+    }
+}
+
+/**
+ * Advances the virtual clock instead of sleeping.
+ *
+ * @param r The buffer backend
+ * @param usec Delay in microseconds
+ */
+static void buffer_pause(RENDER *r, unsigned int usec) {
+    ((RENDER_BUFFER *) r)->clock += usec / 1e6;
+}
+
+/**
+ * Advances the virtual clock by the key delay instead of waiting for a key.
+ *
+ * @param r The buffer backend
+ * @return Always 0
+ */
+static int buffer_wait_key(RENDER *r) {
+    RENDER_BUFFER *buffer = (RENDER_BUFFER *) r;
+    buffer->clock += buffer->key_delay;
+    return 0;
+}
+
+/**
+ * Initializes an in-memory screen of character cells. Drawing into it needs
+ * no terminal; each present() calls buffer->on_present, if set, with the
+ * frame and the virtual time in buffer->clock.
+ *
+ * @param buffer The buffer
+ * @param rows Screen height
+ * @param cols Screen width
+ */
+void render_buffer_init(RENDER_BUFFER *buffer, int rows, int cols) {
+    memset(buffer, 0, sizeof(*buffer));
+    buffer->base.clear_screen = buffer_clear;
+    buffer->base.draw_border = buffer_border;
+    buffer->base.draw_text = buffer_text;
+    buffer->base.draw_glyph = buffer_put_glyph;
+    buffer->base.present = buffer_present;
+    buffer->base.pause = buffer_pause;
+    buffer->base.wait_key = buffer_wait_key;
+    buffer->rows = rows;
+    buffer->cols = cols;
+    buffer->cells = malloc(sizeof(RENDER_CELL) * (size_t) rows * cols);
+    if (!buffer->cells) {
+        error(ERR_MEMORY);
+    }
+    buffer_clear(&buffer->base);
+}
+
+/**
+ * Releases the cells of a buffer.
+ *
+ * @param buffer The buffer
+ */
+void render_buffer_free(RENDER_BUFFER *buffer) {
+    free(buffer->cells);
+    buffer->cells = NULL;
+}
@@ -0,0 +1,681 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define RESULTS_MAGIC "BACOLS01"
+#define RESULTS_VERSION 1
+#define RESULTS_HEADER 64
+#define RESULTS_ALIGN 4096
+#define RESULTS_BLOCK_ROWS 65536
+#define RESULTS_CSV_BUFFER (1 << 20)
+#define BLOCK_MAGIC 0x4C4F4342u
+#define BLOCK_HEADER 40
+#define VARINT_MAX 10
+
+/**
+ * Columns of a block, in file order.
+ */
+enum {
+    COLUMN_MATCHUP,
+    COLUMN_WINNER,
+    COLUMN_ROUNDS,
+    COLUMN_SURVIVORS1,
+    COLUMN_SURVIVORS2,
+    COLUMN_HP1,
+    COLUMN_HP2,
+    COLUMN_COUNT
+};
+
+/**
+ * Output stream for tournament results, buffering one block of rows in
+ * column order.
+ */
+struct result_writer {
+    FILE *file;
+    RESULT_FORMAT format;
+    int armies;
+    uint64_t rows;
+    int pending;
+    uint64_t *matchup;
+    CRESULT *results;
+    uint8_t *block;
+    size_t block_capacity;
+};
+
+/**
+ * Appends an unsigned LEB128 varint.
+ *
+ * @param p Destination (room for VARINT_MAX bytes)
+ * @param v Value
+ * @return Number of bytes written
+ */
+static int put_varint(uint8_t *p, uint64_t v) {
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t) v;
+    return n;
+}
+
+/**
+ * Reads an unsigned LEB128 varint.
+ *
+ * @param p Position in the buffer, advanced past the varint
+ * @param end End of the buffer
+ * @param v Output value
+ * @return false if the varint runs past the end of the buffer
+ */
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint64_t *v) {
+    *v = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        const uint8_t byte = *(*p)++;
+        *v |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+/**
+ * Writes a 64-bit value in little-endian order.
+ *
+ * @param p Destination
+ * @param v Value
+ */
+static void put_u64(uint8_t *p, uint64_t v) {
+    wire_put_u32(p, (uint32_t) v);
+    wire_put_u32(p + 4, (uint32_t) (v >> 32));
+}
+
+/**
+ * Reads a 64-bit little-endian value.
+ *
+ * @param p Source
+ * @return The value
+ */
+static uint64_t get_u64(const uint8_t *p) {
+    return wire_get_u32(p) | (uint64_t) wire_get_u32(p + 4) << 32;
+}
+
+/**
+ * Writes the file header of a columnar result file.
+ *
+ * @param writer The writer
+ */
+static void write_header(RESULT_WRITER *writer) {
+    uint8_t header[RESULTS_HEADER] = {0};
+    memcpy(header, RESULTS_MAGIC, 8);
+    wire_put_u32(header + 8, RESULTS_VERSION);
+    wire_put_u32(header + 12, (uint32_t) writer->armies);
+    put_u64(header + 16, writer->rows);
+    wire_put_u32(header + 24, RESULTS_ALIGN);
+
+    rewind(writer->file);
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) {
+        error(ERR_FILE);
+    }
+}
+
+/**
+ * Encodes the buffered rows as one block and writes it.
+ * Columns: matchup ids as varint deltas from the previous row (the first
+ * relative to 0), winner codes packed four to a byte, then rounds, survivors
+ * and HP of each side as varints. The block is zero-padded to RESULTS_ALIGN
+ * bytes so every block starts on an aligned file offset.
+ *
+ * @param writer The writer
+ */
+static void flush_block(RESULT_WRITER *writer) {
+    if (writer->pending == 0) return;
+
+    const int rows = writer->pending;
+    const size_t worst = BLOCK_HEADER + (size_t) rows * (VARINT_MAX * (COLUMN_COUNT - 1) + 1) + RESULTS_ALIGN;
+    if (worst > writer->block_capacity) {
+        free(writer->block);
+        writer->block = malloc(worst);
+        if (!writer->block) {
+            error(ERR_MEMORY);
+        }
+        writer->block_capacity = worst;
+    }
+
+    uint8_t *p = writer->block + BLOCK_HEADER;
+    uint32_t sizes[COLUMN_COUNT];
+    uint8_t *start = p;
+
+    uint64_t previous = 0;
+    for (int i = 0; i < rows; i++) {
+        const uint64_t id = writer->matchup[i];
+        const uint64_t delta = id - previous;
+        // Zigzag, since chunks from different workers arrive out of order
+        const int64_t signed_delta = (int64_t) delta;
+        p += put_varint(p, ((uint64_t) signed_delta << 1) ^ (uint64_t) (signed_delta >> 63));
+        previous = id;
+    }
+    sizes[COLUMN_MATCHUP] = (uint32_t) (p - start);
+
+    start = p;
+    memset(p, 0, (rows + 3) / 4);
+    for (int i = 0; i < rows; i++) {
+        p[i / 4] |= (uint8_t) ((writer->results[i].winner & 3) << (2 * (i % 4)));
+    }
+    p += (rows + 3) / 4;
+    sizes[COLUMN_WINNER] = (uint32_t) (p - start);
+
+    for (int column = COLUMN_ROUNDS; column < COLUMN_COUNT; column++) {
+        start = p;
+        for (int i = 0; i < rows; i++) {
+            const CRESULT *r = &writer->results[i];
+            const int value = column == COLUMN_ROUNDS ? r->rounds
+                            : column == COLUMN_SURVIVORS1 ? r->survivors1
+                            : column == COLUMN_SURVIVORS2 ? r->survivors2
+                            : column == COLUMN_HP1 ? r->hp1 : r->hp2;
+            p += put_varint(p, (uint32_t) value);
+        }
+        sizes[column] = (uint32_t) (p - start);
+    }
+
+    const size_t used = (size_t) (p - writer->block);
+    const size_t padded = (used + RESULTS_ALIGN - 1) / RESULTS_ALIGN * RESULTS_ALIGN;
+    memset(p, 0, padded - used);
+
+    wire_put_u32(writer->block, BLOCK_MAGIC);
+    wire_put_u32(writer->block + 4, (uint32_t) rows);
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        wire_put_u32(writer->block + 8 + 4 * column, sizes[column]);
+    }
+    wire_put_u32(writer->block + 8 + 4 * COLUMN_COUNT, (uint32_t) padded);
+
+    if (fwrite(writer->block, 1, padded, writer->file) != padded) {
+        error(ERR_FILE);
+    }
+    writer->pending = 0;
+}
+
+/**
+ * Opens a result file for a tournament.
+ *
+ * @param path Output path
+ * @param format RESULT_CSV for one text line per battle, RESULT_COLUMNAR for the binary block format
+ * @param armies Number of armies in the tournament, needed to map matchup ids back to armies
+ * @return The writer
+ */
+RESULT_WRITER *result_writer_open(const char *path, RESULT_FORMAT format, int armies) {
+    RESULT_WRITER *writer = calloc(1, sizeof(RESULT_WRITER));
+    if (!writer) {
+        error(ERR_MEMORY);
+    }
+    writer->format = format;
+    writer->armies = armies;
+    writer->file = fopen(path, format == RESULT_CSV ? "w" : "wb");
+    if (!writer->file) {
+        error(ERR_FILE);
+    }
+
+    if (format == RESULT_CSV) {
+        setvbuf(writer->file, NULL, _IOFBF, RESULTS_CSV_BUFFER);
+        return writer;
+    }
+
+    writer->matchup = malloc(sizeof(uint64_t) * RESULTS_BLOCK_ROWS);
+    writer->results = malloc(sizeof(CRESULT) * RESULTS_BLOCK_ROWS);
+    if (!writer->matchup || !writer->results) {
+        error(ERR_MEMORY);
+    }
+    write_header(writer);
+
+    // Blocks start at the first aligned offset after the header
+    uint8_t zero[RESULTS_ALIGN - RESULTS_HEADER] = {0};
+    if (fwrite(zero, 1, sizeof(zero), writer->file) != sizeof(zero)) {
+        error(ERR_FILE);
+    }
+    return writer;
+}
+
+/**
+ * Reopens a result file to continue an interrupted run. Everything after
+ * `offset` (results written after the last sync) is discarded.
+ *
+ * @param path Output path
+ * @param format Format the file was created with
+ * @param armies Number of armies in the tournament
+ * @param offset File size returned by result_writer_sync() at the checkpoint
+ * @param rows Row count returned by result_writer_sync() at the checkpoint
+ * @return The writer
+ */
+RESULT_WRITER *result_writer_resume(const char *path, RESULT_FORMAT format, int armies, uint64_t offset,
+                                    uint64_t rows) {
+    if (format == RESULT_COLUMNAR && offset < RESULTS_ALIGN) {
+        return result_writer_open(path, format, armies);
+    }
+
+    RESULT_WRITER *writer = calloc(1, sizeof(RESULT_WRITER));
+    if (!writer) {
+        error(ERR_MEMORY);
+    }
+    writer->format = format;
+    writer->armies = armies;
+    writer->rows = rows;
+    writer->file = fopen(path, "r+b");
+    if (!writer->file || ftruncate(fileno(writer->file), (off_t) offset) != 0 ||
+        fseeko(writer->file, (off_t) offset, SEEK_SET) != 0) {
+        error(ERR_FILE);
+    }
+
+    if (format == RESULT_CSV) {
+        setvbuf(writer->file, NULL, _IOFBF, RESULTS_CSV_BUFFER);
+        return writer;
+    }
+    writer->matchup = malloc(sizeof(uint64_t) * RESULTS_BLOCK_ROWS);
+    writer->results = malloc(sizeof(CRESULT) * RESULTS_BLOCK_ROWS);
+    if (!writer->matchup || !writer->results) {
+        error(ERR_MEMORY);
+    }
+    return writer;
+}
+
+/**
+ * Makes every result added so far durable: buffered rows are written out
+ * (as a short block in the columnar format) and the file is flushed to disk.
+ *
+ * @param writer The writer
+ * @param rows Output number of rows in the file
+ * @return Size of the file in bytes
+ */
+uint64_t result_writer_sync(RESULT_WRITER *writer, uint64_t *rows) {
+    if (writer->format == RESULT_COLUMNAR) {
+        flush_block(writer);
+    }
+    if (fflush(writer->file) != 0 || fsync(fileno(writer->file)) != 0) {
+        error(ERR_FILE);
+    }
+    *rows = writer->rows;
+    return (uint64_t) ftello(writer->file);
+}
+
+/**
+ * Adds the result of one matchup. Not thread-safe; callers serialize access.
+ *
+ * @param writer The writer
+ * @param matchup Matchup id (see matchup_pair())
+ * @param result Result of the battle
+ */
+void result_writer_add(RESULT_WRITER *writer, uint64_t matchup, const CRESULT *result) {
+    writer->rows++;
+    if (writer->format == RESULT_CSV) {
+        int a, b;
+        matchup_pair(matchup, writer->armies, &a, &b);
+        fprintf(writer->file, "%llu,%d,%d,%d,%d,%d,%d,%d,%d\n", (unsigned long long) matchup, a, b,
+                result->winner, result->rounds, result->survivors1, result->hp1, result->survivors2, result->hp2);
+        return;
+    }
+
+    writer->matchup[writer->pending] = matchup;
+    writer->results[writer->pending] = *result;
+    if (++writer->pending == RESULTS_BLOCK_ROWS) {
+        flush_block(writer);
+    }
+}
+
+/**
+ * Writes any buffered rows, finalizes the header and closes the file.
+ *
+ * @param writer The writer
+ */
+void result_writer_close(RESULT_WRITER *writer) {
+    if (writer->format == RESULT_COLUMNAR) {
+        flush_block(writer);
+        write_header(writer);
+    }
+    if (fclose(writer->file) != 0) {
+        error(ERR_FILE);
+    }
+    free(writer->matchup);
+    free(writer->results);
+    free(writer->block);
+    free(writer);
+}
+
+/**
+ * Input stream over a result file in either format.
+ */
+struct result_reader {
+    FILE *file;
+    RESULT_FORMAT format;
+    int armies;
+    uint64_t total;
+    uint64_t read;
+    uint8_t *block;
+    size_t block_capacity;
+    uint64_t *matchup;
+    CRESULT *results;
+    int capacity;
+    int rows;
+    int next;
+};
+
+/**
+ * Decodes one varint column of a block into a field of each result.
+ *
+ * @param p Start of the column
+ * @param size Size of the column in bytes
+ * @param rows Number of rows
+ * @param results Destination results
+ * @param offset Byte offset of the int field within CRESULT
+ * @return false if the column is malformed
+ */
+static bool decode_column(const uint8_t *p, uint32_t size, int rows, CRESULT *results, size_t offset) {
+    const uint8_t *end = p + size;
+    for (int i = 0; i < rows; i++) {
+        uint64_t v;
+        if (!get_varint(&p, end, &v) || v > INT32_MAX) return false;
+        *(int *) ((uint8_t *) &results[i] + offset) = (int) v;
+    }
+    return p == end;
+}
+
+/**
+ * Reads and decodes the next block of a columnar file.
+ * Exits through error() on a malformed block.
+ *
+ * @param reader The reader
+ * @return false at the end of the file
+ */
+static bool read_block(RESULT_READER *reader) {
+    uint8_t head[BLOCK_HEADER];
+    if (reader->read >= reader->total || fread(head, 1, sizeof(head), reader->file) != sizeof(head)) {
+        return false;
+    }
+
+    const int rows = (int) wire_get_u32(head + 4);
+    const uint32_t padded = wire_get_u32(head + 8 + 4 * COLUMN_COUNT);
+    uint32_t sizes[COLUMN_COUNT];
+    uint64_t used = BLOCK_HEADER;
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        sizes[column] = wire_get_u32(head + 8 + 4 * column);
+        used += sizes[column];
+    }
+    if (wire_get_u32(head) != BLOCK_MAGIC || rows <= 0 || used > padded ||
+        sizes[COLUMN_WINNER] != (uint32_t) (rows + 3) / 4) {
+        error(ERR_BAD_VALUE);
+    }
+
+    if (rows > reader->capacity) {
+        reader->capacity = rows;
+        free(reader->matchup);
+        free(reader->results);
+        reader->matchup = malloc(sizeof(uint64_t) * rows);
+        reader->results = malloc(sizeof(CRESULT) * rows);
+        if (!reader->matchup || !reader->results) {
+            error(ERR_MEMORY);
+        }
+    }
+    if (padded - BLOCK_HEADER > reader->block_capacity) {
+        free(reader->block);
+        reader->block_capacity = padded - BLOCK_HEADER;
+        reader->block = malloc(reader->block_capacity);
+        if (!reader->block) {
+            error(ERR_MEMORY);
+        }
+    }
+    if (fread(reader->block, 1, padded - BLOCK_HEADER, reader->file) != padded - BLOCK_HEADER) {
+        error(ERR_BAD_VALUE);
+    }
+
+    const uint8_t *p = reader->block;
+    const uint8_t *end = p + sizes[COLUMN_MATCHUP];
+    uint64_t previous = 0;
+    for (int i = 0; i < rows; i++) {
+        uint64_t zigzag;
+        if (!get_varint(&p, end, &zigzag)) {
+            error(ERR_BAD_VALUE);
+        }
+        previous += (zigzag >> 1) ^ (uint64_t) -(int64_t) (zigzag & 1);
+        reader->matchup[i] = previous;
+    }
+    p = end;
+
+    for (int i = 0; i < rows; i++) {
+        reader->results[i].winner = (p[i / 4] >> (2 * (i % 4))) & 3;
+    }
+    p += sizes[COLUMN_WINNER];
+
+    static const size_t offsets[COLUMN_COUNT] = {
+        [COLUMN_ROUNDS] = offsetof(CRESULT, rounds),
+        [COLUMN_SURVIVORS1] = offsetof(CRESULT, survivors1),
+        [COLUMN_SURVIVORS2] = offsetof(CRESULT, survivors2),
+        [COLUMN_HP1] = offsetof(CRESULT, hp1),
+        [COLUMN_HP2] = offsetof(CRESULT, hp2),
+    };
+    for (int column = COLUMN_ROUNDS; column < COLUMN_COUNT; column++) {
+        if (!decode_column(p, sizes[column], rows, reader->results, offsets[column])) {
+            error(ERR_BAD_VALUE);
+        }
+        p += sizes[column];
+    }
+
+    reader->rows = rows;
+    reader->next = 0;
+    return true;
+}
+
+/**
+ * Opens a result file written by a RESULT_WRITER; the format is detected
+ * from the file contents. Exits through error() if the file cannot be read.
+ *
+ * @param path Path of the result file
+ * @return The reader
+ */
+RESULT_READER *result_reader_open(const char *path) {
+    RESULT_READER *reader = calloc(1, sizeof(RESULT_READER));
+    if (!reader) {
+        error(ERR_MEMORY);
+    }
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        error(ERR_FILE);
+    }
+
+    uint8_t header[RESULTS_HEADER];
+    const size_t got = fread(header, 1, sizeof(header), reader->file);
+    if (got < 8 || memcmp(header, RESULTS_MAGIC, 8) != 0) {
+        reader->format = RESULT_CSV;
+        rewind(reader->file);
+        return reader;
+    }
+
+    if (got != sizeof(header) || wire_get_u32(header + 8) != RESULTS_VERSION) {
+        error(ERR_BAD_VALUE);
+    }
+    reader->format = RESULT_COLUMNAR;
+    reader->armies = (int) wire_get_u32(header + 12);
+    reader->total = get_u64(header + 16);
+    const uint32_t align = wire_get_u32(header + 24);
+    if (align < RESULTS_HEADER || fseek(reader->file, align, SEEK_SET) != 0) {
+        error(ERR_BAD_VALUE);
+    }
+    return reader;
+}
+
+/**
+ * Returns the number of armies recorded in a result file.
+ *
+ * @param reader The reader
+ * @return Number of armies, or 0 if the file does not record it (CSV)
+ */
+int result_reader_armies(const RESULT_READER *reader) {
+    return reader->armies;
+}
+
+/**
+ * Reads the next result. For CSV input the army indices of each line are
+ * returned through a and b; for columnar input they are derived from the
+ * matchup id.
+ *
+ * @param reader The reader
+ * @param matchup Output matchup id
+ * @param a Output index of the first army
+ * @param b Output index of the second army
+ * @param result Output result
+ * @return false at the end of the file
+ */
+bool result_reader_next(RESULT_READER *reader, uint64_t *matchup, int *a, int *b, CRESULT *result) {
+    if (reader->format == RESULT_CSV) {
+        unsigned long long id;
+        const int fields = fscanf(reader->file, "%llu,%d,%d,%d,%d,%d,%d,%d,%d", &id, a, b, &result->winner,
+                                  &result->rounds, &result->survivors1, &result->hp1, &result->survivors2,
+                                  &result->hp2);
+        if (fields == EOF) return false;
+        if (fields != 9) {
+            error(ERR_BAD_VALUE);
+        }
+        *matchup = id;
+        reader->read++;
+        return true;
+    }
+
+    if (reader->next == reader->rows && !read_block(reader)) {
+        if (reader->read != reader->total) {
+            error(ERR_BAD_VALUE);
+        }
+        return false;
+    }
+    *matchup = reader->matchup[reader->next];
+    *result = reader->results[reader->next];
+    reader->next++;
+    reader->read++;
+    matchup_pair(*matchup, reader->armies, a, b);
+    return true;
+}
+
+/**
+ * Closes a result reader.
+ *
+ * @param reader The reader
+ */
+void result_reader_close(RESULT_READER *reader) {
+    fclose(reader->file);
+    free(reader->block);
+    free(reader->matchup);
+    free(reader->results);
+    free(reader);
+}
+
+/**
+ * Reads a result file and prints it in the CSV format of
+ * result_writer_open(..., RESULT_CSV, ...).
+ *
+ * @param path Path of the result file
+ * @param out Stream to print to
+ * @return Number of rows printed
+ */
+uint64_t dump_results(const char *path, FILE *out) {
+    RESULT_READER *reader = result_reader_open(path);
+
+    uint64_t printed = 0;
+    uint64_t matchup;
+    int a, b;
+    CRESULT r;
+    while (result_reader_next(reader, &matchup, &a, &b, &r)) {
+        fprintf(out, "%llu,%d,%d,%d,%d,%d,%d,%d,%d\n", (unsigned long long) matchup, a, b, r.winner,
+                r.rounds, r.survivors1, r.hp1, r.survivors2, r.hp2);
+        printed++;
+    }
+    result_reader_close(reader);
+    return printed;
+}
+
+/**
+ * A result of a shard file held in memory for merging.
+ */
+typedef struct {
+    uint64_t matchup;
+    CRESULT result;
+} MERGE_ROW;
+
+/**
+ * Orders merge rows by matchup id.
+ *
+ * @param x First row
+ * @param y Second row
+ * @return Negative, zero or positive as for qsort()
+ */
+static int compare_rows(const void *x, const void *y) {
+    const uint64_t a = ((const MERGE_ROW *) x)->matchup;
+    const uint64_t b = ((const MERGE_ROW *) y)->matchup;
+    return (a > b) - (a < b);
+}
+
+/**
+ * Merges the result files of the shards of a tournament into one result
+ * file in matchup id order, the order of a single-worker run.
+ * Files may be in either format and in any order. The merge fails through
+ * error() unless the files together hold every matchup of the tournament
+ * exactly once.
+ *
+ * @param inputs Paths of the shard result files
+ * @param count Number of input files
+ * @param output_path Path of the merged result file
+ * @param format Format of the merged file
+ * @return Number of results merged
+ */
+uint64_t merge_results(const char *const *inputs, int count, const char *output_path, RESULT_FORMAT format) {
+    MERGE_ROW *rows = NULL;
+    size_t used = 0;
+    size_t capacity = 0;
+    int armies = 0;
+
+    for (int f = 0; f < count; f++) {
+        RESULT_READER *reader = result_reader_open(inputs[f]);
+        const int recorded = result_reader_armies(reader);
+        if (recorded) {
+            if (armies && armies != recorded) {
+                error(ERR_BAD_VALUE);
+            }
+            armies = recorded;
+        }
+
+        uint64_t matchup;
+        int a, b;
+        CRESULT r;
+        while (result_reader_next(reader, &matchup, &a, &b, &r)) {
+            if (used == capacity) {
+                capacity = capacity ? capacity * 2 : 65536;
+                MERGE_ROW *grown = realloc(rows, sizeof(MERGE_ROW) * capacity);
+                if (!grown) {
+                    error(ERR_MEMORY);
+                }
+                rows = grown;
+            }
+            rows[used].matchup = matchup;
+            rows[used].result = r;
+            used++;
+            if (!recorded && b >= armies) {
+                // CSV does not record the army count; infer it from the highest army index seen
+                armies = b + 1;
+            }
+        }
+        result_reader_close(reader);
+    }
+
+    qsort(rows, used, sizeof(MERGE_ROW), compare_rows);
+    if (used != matchup_count(armies)) {
+        error(ERR_BAD_VALUE);
+    }
+    for (size_t i = 0; i < used; i++) {
+        if (rows[i].matchup != i) {
+            error(ERR_BAD_VALUE);
+        }
+    }
+
+    RESULT_WRITER *writer = result_writer_open(output_path, format, armies);
+    for (size_t i = 0; i < used; i++) {
+        result_writer_add(writer, rows[i].matchup, &rows[i].result);
+    }
+    result_writer_close(writer);
+    free(rows);
+    return used;
+}
@@ -0,0 +1,330 @@
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/battle-arena.h"
+
+#define ROSTER_LINE 512
+
+/**
+ * Removes leading and trailing whitespace from a string in place.
+ *
+ * @param s The string to trim
+ * @return Pointer to the first non-whitespace character
+ */
+static char *trim(char *s) {
+    while (isspace((unsigned char) *s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char) end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+/**
+ * Appends an army under construction to the roster.
+ *
+ * @param roster The roster
+ * @param units Units of the army
+ * @param count Number of units
+ */
+static void add_army(ROSTER *roster, const CUNIT *units, int count) {
+    if (roster->count == roster->capacity) {
+        roster->capacity = roster->capacity ? roster->capacity * 2 : 64;
+        CARMY **armies = realloc(roster->armies, sizeof(CARMY *) * roster->capacity);
+        if (!armies) {
+            error(ERR_MEMORY);
+        }
+        roster->armies = armies;
+    }
+
+    CARMY *army = arena_alloc(&roster->arena, carmy_size(count));
+    army->count = (uint16_t) count;
+    memcpy(army->units, units, sizeof(CUNIT) * count);
+    roster->armies[roster->count++] = army;
+}
+
+/**
+ * Splits an optional repeat suffix " xN" off a unit name.
+ *
+ * @param name The unit name (modified in place)
+ * @return The repeat count, 1 if there is no suffix, 0 if N is out of range
+ */
+static int parse_repeat(char *name) {
+    char *space = strrchr(name, ' ');
+    if (!space || space[1] != 'x' || !isdigit((unsigned char) space[2])) return 1;
+
+    for (const char *p = space + 2; *p; p++) {
+        if (!isdigit((unsigned char) *p)) return 1;
+    }
+    const long repeat = strtol(space + 2, NULL, 10);
+    if (repeat < 1 || repeat > UINT16_MAX) return 0;
+    *space = '\0';
+    trim(name);
+    return (int) repeat;
+}
+
+/**
+ * Parses one unit line of the form "name[ xN]: item1[, item2]" without
+ * exiting on bad input. Items are resolved through find() and the
+ * combination must pass check_slots().
+ *
+ * @param line The line to parse (modified in place)
+ * @param unit Destination unit (items and HP; the name is returned separately)
+ * @param name Output name, pointing into the line
+ * @param repeat Output number of copies requested by the " xN" suffix
+ * @param bad Output offending text for the error message (may be NULL)
+ * @return NULL on success, otherwise the ERR_ code of the problem
+ */
+static const char *parse_unit_line(char *line, UNIT *unit, char **name, int *repeat, const char **bad) {
+    memset(unit, 0, sizeof(*unit));
+    char *colon = strchr(line, ':');
+    if (!colon) return ERR_BAD_VALUE;
+    *colon = '\0';
+
+    *name = trim(line);
+    *repeat = parse_repeat(*name);
+    if (*repeat == 0) return ERR_UNIT_COUNT;
+    char *items = colon + 1;
+    char *comma = strchr(items, ',');
+    if (comma) {
+        *comma = '\0';
+    }
+
+    if (bad) *bad = trim(items);
+    unit->item1 = find(trim(items));
+    if (!unit->item1) return ERR_WRONG_ITEM;
+    if (comma) {
+        if (strchr(comma + 1, ',')) return ERR_ITEM_COUNT;
+        if (bad) *bad = trim(comma + 1);
+        unit->item2 = find(trim(comma + 1));
+        if (!unit->item2) return ERR_WRONG_ITEM;
+    }
+    if (!check_slots(*unit)) return ERR_SLOTS;
+
+    unit->hp = UNIT_HP;
+    return NULL;
+}
+
+/**
+ * Parses one roster unit line into compact form, exiting through error()
+ * on bad input.
+ *
+ * @param line The line to parse (modified in place)
+ * @param unit Destination compact unit
+ * @return Number of copies of the unit requested by the " xN" suffix
+ */
+static int parse_unit(char *line, CUNIT *unit) {
+    UNIT parsed;
+    char *name;
+    int repeat;
+    const char *problem = parse_unit_line(line, &parsed, &name, &repeat, NULL);
+    if (problem) {
+        error(problem);
+    }
+
+    unit->item1 = (uint8_t) (parsed.item1 - item_list.items);
+    unit->item2 = parsed.item2 ? (uint8_t) (parsed.item2 - item_list.items) : CITEM_NONE;
+    unit->hp = UNIT_HP;
+    unit->name = intern_name(name);
+    return repeat;
+}
+
+/**
+ * Loads a pool of armies from a text file into compact form.
+ *
+ * File format: one unit per line as "name: item1[, item2]"; armies are
+ * separated by blank lines; lines starting with '#' are comments. A name
+ * suffix " xN" repeats the unit N times, for mass battles.
+ *
+ *   # two armies
+ *   Knight: sword, shield
+ *   Archer: crossbow
+ *
+ *   Mage: wand
+ *   Soldier x500: spear, helmet
+ *
+ * Every army is stored in the roster's arena. Exits through error() on invalid input.
+ *
+ * @param file The file to read
+ * @param roster Destination roster, initialized by this function
+ */
+void load_roster(FILE *file, ROSTER *roster) {
+    memset(roster, 0, sizeof(*roster));
+    arena_init(&roster->arena, 0);
+
+    CUNIT *units = NULL;
+    int count = 0;
+    int capacity = 0;
+
+    char line[ROSTER_LINE];
+    while (fgets(line, sizeof(line), file)) {
+        char *text = trim(line);
+        if (text[0] == '#') continue;
+
+        if (text[0] == '\0') {
+            if (count > 0) {
+                add_army(roster, units, count);
+                count = 0;
+            }
+            continue;
+        }
+
+        CUNIT unit;
+        const int repeat = parse_unit(text, &unit);
+        if (count + repeat > UINT16_MAX) {
+            error(ERR_UNIT_COUNT);
+        }
+        if (count + repeat > capacity) {
+            while (count + repeat > capacity) {
+                capacity = capacity ? capacity * 2 : MAX_ARMY;
+            }
+            CUNIT *grown = realloc(units, sizeof(CUNIT) * capacity);
+            if (!grown) {
+                error(ERR_MEMORY);
+            }
+            units = grown;
+        }
+        for (int k = 0; k < repeat; k++) {
+            units[count++] = unit;
+        }
+    }
+    if (count > 0) {
+        add_army(roster, units, count);
+    }
+    free(units);
+}
+
+/**
+ * Records an import problem, keeping the first IMPORT_MAX_ERRORS messages.
+ *
+ * @param import The import
+ * @param line Line number of the problem
+ * @param format printf-style message
+ */
+static void import_error(ARMY_IMPORT *import, int line, const char *format, ...) {
+    if (import->error_count < IMPORT_MAX_ERRORS) {
+        char *message = import->errors[import->error_count];
+        const int n = snprintf(message, IMPORT_ERROR_TEXT, "line %d: ", line);
+        va_list args;
+        va_start(args, format);
+        vsnprintf(message + n, IMPORT_ERROR_TEXT - n, format, args);
+        va_end(args);
+    }
+    import->error_count++;
+}
+
+/**
+ * Loads up to IMPORT_MAX_ARMIES interactive armies from a file in roster
+ * format (see load_roster()), with at most MAX_ARMY units each. Unlike
+ * load_roster(), bad input does not exit: the whole file is checked in one
+ * pass and every problem is recorded in import->errors.
+ *
+ * @param file The file to read
+ * @param import Destination, initialized by this function
+ * @return true if the file was valid; the armies are only usable then
+ */
+bool import_armies(FILE *file, ARMY_IMPORT *import) {
+    memset(import, 0, sizeof(*import));
+    bool in_army = false;
+    bool army_overflow = false;
+    bool roster_overflow = false;
+
+    char line[ROSTER_LINE];
+    for (int number = 1; fgets(line, sizeof(line), file); number++) {
+        char *text = trim(line);
+        if (text[0] == '#') continue;
+        if (text[0] == '\0') {
+            in_army = false;
+            continue;
+        }
+
+        if (!in_army) {
+            in_army = true;
+            army_overflow = false;
+            if (import->count == IMPORT_MAX_ARMIES) {
+                if (!roster_overflow) {
+                    import_error(import, number, "only %d armies can be loaded (%s)", IMPORT_MAX_ARMIES,
+                                 ERR_UNIT_COUNT);
+                }
+                roster_overflow = true;
+            } else {
+                init_army(&import->armies[import->count++]);
+            }
+        }
+
+        UNIT unit;
+        char *name;
+        int repeat;
+        const char *bad = "";
+        const char *problem = parse_unit_line(text, &unit, &name, &repeat, &bad);
+        if (!problem) {
+            if (name[0] == '\0' || strlen(name) > MAX_NAME) {
+                import_error(import, number, "unit name must have 1 to %d characters (%s)", MAX_NAME,
+                             ERR_BAD_VALUE);
+                problem = ERR_BAD_VALUE;
+            }
+        } else if (strcmp(problem, ERR_BAD_VALUE) == 0) {
+            import_error(import, number, "expected \"name: item1[, item2]\" (%s)", problem);
+        } else if (strcmp(problem, ERR_WRONG_ITEM) == 0) {
+            import_error(import, number, "unknown item '%s' (%s)", bad, problem);
+        } else if (strcmp(problem, ERR_ITEM_COUNT) == 0) {
+            import_error(import, number, "a unit carries at most 2 items (%s)", problem);
+        } else if (strcmp(problem, ERR_SLOTS) == 0 && !unit.item2) {
+            import_error(import, number, "%s needs more than 2 slots (%s)", unit.item1->name, problem);
+        } else if (strcmp(problem, ERR_SLOTS) == 0) {
+            import_error(import, number, "%s and %s need more than 2 slots (%s)", unit.item1->name,
+                         unit.item2->name, problem);
+        } else {
+            import_error(import, number, "bad unit count (%s)", problem);
+        }
+        if (roster_overflow) continue;
+
+        ARMY *army = &import->armies[import->count - 1];
+        if (!problem && army->top + repeat >= MAX_ARMY) {
+            if (!army_overflow) {
+                import_error(import, number, "army %d has more than %d units (%s)", import->count, MAX_ARMY,
+                             ERR_UNIT_COUNT);
+            }
+            army_overflow = true;
+            continue;
+        }
+        if (problem || army_overflow) continue;
+
+        strncpy(unit.name, name, MAX_NAME);
+        unit.name[MAX_NAME] = '\0';
+        for (int k = 0; k < repeat; k++) {
+            push(army, unit);
+        }
+    }
+    if (import->count == 0 && import->error_count == 0) {
+        import_error(import, 1, "no armies in file (%s)", ERR_UNIT_COUNT);
+    }
+    return import->error_count == 0;
+}
+
+/**
+ * Hashes the combat-relevant content of every army of a roster, in order,
+ * to recognize the same roster across runs.
+ *
+ * @param roster The roster
+ * @return 64-bit hash
+ */
+uint64_t roster_hash(const ROSTER *roster) {
+    uint64_t h = mix64((uint64_t) roster->count);
+    for (int i = 0; i < roster->count; i++) {
+        h = mix64(h ^ carmy_hash(roster->armies[i], (uint64_t) i));
+    }
+    return h;
+}
+
+/**
+ * Releases the memory held by a roster.
+ *
+ * @param roster The roster to free
+ */
+void free_roster(ROSTER *roster) {
+    free(roster->armies);
+    arena_free(&roster->arena);
+    memset(roster, 0, sizeof(*roster));
+}
@@ -0,0 +1,453 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define SENSITIVITY_CHUNK 256
+#define MAX_CHANGES 8
+
+/**
+ * Combat statistics a tweak can change. Slots are left out: they decide
+ * which armies are legal, not how a battle goes.
+ */
+enum {
+    STAT_ATT,
+    STAT_DEF,
+    STAT_RANGE,
+    STAT_RADIUS
+};
+
+static const char *stat_names[] = {"att", "def", "range", "radius"};
+
+/**
+ * One hypothetical catalog: a set of stat changes applied together, the
+ * armies they touch and the standings changes they cause.
+ */
+typedef struct {
+    const char *spec;
+    int change_count;
+    int item[MAX_CHANGES];
+    int stat[MAX_CHANGES];
+    int value[MAX_CHANGES];
+    CCATALOG catalog;
+    int *affected;
+    int affected_count;
+    bool *touched;
+    uint64_t matchups;
+    uint64_t first_job;
+    atomic_int (*delta)[3];
+    atomic_uint_fast64_t changed;
+} TWEAK;
+
+/**
+ * State shared by the analysis threads. The baseline phase splits the
+ * matchup ids into chunks; the tweak phase hands out one job per affected
+ * army of each tweak.
+ */
+typedef struct {
+    const ROSTER *roster;
+    uint64_t matchups;
+    int8_t *baseline;
+    TWEAK *tweaks;
+    int tweak_count;
+    uint64_t jobs;
+    atomic_uint_fast64_t next;
+} ANALYSIS;
+
+/**
+ * Parses a tweak of the form "item.stat=value[,item.stat=value...]" and
+ * builds its catalog from the loaded item list.
+ *
+ * @param spec The tweak text
+ * @param tweak Destination
+ */
+static void parse_tweak(const char *spec, TWEAK *tweak) {
+    memset(tweak, 0, sizeof(*tweak));
+    tweak->spec = spec;
+
+    ITEM items[NUMBER_OF_ITEMS];
+    memcpy(items, item_list.items, sizeof(ITEM) * item_list.count);
+
+    const char *p = spec;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        const size_t length = end ? (size_t) (end - p) : strlen(p);
+        char text[MAX_NAME + 32];
+        if (length >= sizeof(text) || tweak->change_count == MAX_CHANGES) {
+            error(ERR_BAD_VALUE);
+        }
+        memcpy(text, p, length);
+        text[length] = '\0';
+
+        // Split at the last '.' before the '=', so item names may contain dots
+        char *equals = strchr(text, '=');
+        char *dot = NULL;
+        for (char *q = text; equals && q < equals; q++) {
+            if (*q == '.') dot = q;
+        }
+        if (!dot) {
+            error(ERR_BAD_VALUE);
+        }
+        *dot = '\0';
+        *equals = '\0';
+
+        const ITEM *item = find(text);
+        int stat = 0;
+        while (stat <= STAT_RADIUS && strcmp(stat_names[stat], dot + 1) != 0) stat++;
+        char *rest;
+        const long value = strtol(equals + 1, &rest, 10);
+        if (!item || stat > STAT_RADIUS || *rest != '\0' || rest == equals + 1 || value < 0 || value > 1000) {
+            error(ERR_BAD_VALUE);
+        }
+
+        const int c = tweak->change_count++;
+        tweak->item[c] = (int) (item - item_list.items);
+        tweak->stat[c] = stat;
+        tweak->value[c] = (int) value;
+        ITEM *changed = &items[tweak->item[c]];
+        unsigned int *field = stat == STAT_ATT ? &changed->att
+                            : stat == STAT_DEF ? &changed->def
+                            : stat == STAT_RANGE ? &changed->range : &changed->radius;
+        *field = (unsigned int) value;
+
+        p += length;
+        if (*p == ',') p++;
+    }
+    if (tweak->change_count == 0) {
+        error(ERR_BAD_VALUE);
+    }
+
+    const ITEM_LIST list = {items, item_list.count};
+    compile_catalog(&list, &tweak->catalog);
+}
+
+/**
+ * Tells whether any unit of an army carries an item.
+ *
+ * @param army The army
+ * @param item Item id
+ * @return true if the item is in the army
+ */
+static bool army_has_item(const CARMY *army, int item) {
+    for (int i = 0; i < army->count; i++) {
+        if (army->units[i].item1 == item || army->units[i].item2 == item) return true;
+    }
+    return false;
+}
+
+/**
+ * Finds the armies a tweak touches. Only battles with at least one of them
+ * can change, since an item's stats are read only for units that carry it.
+ * The engine's global range and radius bounds also depend on the catalog,
+ * but they only limit work and never change a result.
+ *
+ * @param tweak The tweak
+ * @param roster The armies
+ */
+static void find_affected(TWEAK *tweak, const ROSTER *roster) {
+    tweak->affected = malloc(sizeof(int) * roster->count);
+    tweak->touched = calloc(roster->count, sizeof(bool));
+    tweak->delta = calloc(roster->count, sizeof(*tweak->delta));
+    if (!tweak->affected || !tweak->touched || !tweak->delta) {
+        error(ERR_MEMORY);
+    }
+
+    for (int a = 0; a < roster->count; a++) {
+        for (int c = 0; c < tweak->change_count && !tweak->touched[a]; c++) {
+            tweak->touched[a] = army_has_item(roster->armies[a], tweak->item[c]);
+        }
+        if (tweak->touched[a]) {
+            tweak->affected[tweak->affected_count++] = a;
+        }
+    }
+
+    const uint64_t m = (uint64_t) tweak->affected_count;
+    tweak->matchups = m * ((uint64_t) roster->count - m) + m * (m - 1) / 2;
+}
+
+/**
+ * Plays every matchup of the roster once with the current catalog and keeps
+ * the winner of each.
+ *
+ * @param analysis The analysis
+ * @param scratch The thread's arena
+ */
+static void run_baseline(ANALYSIS *analysis, ARENA *scratch) {
+    const ROSTER *roster = analysis->roster;
+    while (1) {
+        const uint64_t start = atomic_fetch_add(&analysis->next, SENSITIVITY_CHUNK);
+        if (start >= analysis->matchups) break;
+        const uint64_t end = start + SENSITIVITY_CHUNK < analysis->matchups ? start + SENSITIVITY_CHUNK
+                                                                            : analysis->matchups;
+
+        int a, b;
+        matchup_pair(start, roster->count, &a, &b);
+        for (uint64_t id = start; id < end; id++) {
+            CRESULT result;
+            csimulate(roster->armies[a], roster->armies[b], &combat_catalog, &result, scratch);
+            analysis->baseline[id] = (int8_t) result.winner;
+            if (++b == roster->count) {
+                a++;
+                b = a + 1;
+            }
+        }
+        arena_reset(scratch);
+    }
+}
+
+/**
+ * Adds one battle's result to a tweak's standings changes.
+ *
+ * @param delta Per-army changes of wins, draws and losses
+ * @param a Index of the first army
+ * @param b Index of the second army
+ * @param winner Result code of the battle
+ * @param sign +1 to add the result, -1 to remove it
+ */
+static void add_delta(atomic_int (*delta)[3], int a, int b, int winner, int sign) {
+    const int first = winner == 1 ? 0 : winner == 2 ? 2 : 1;
+    atomic_fetch_add_explicit(&delta[a][first], sign, memory_order_relaxed);
+    atomic_fetch_add_explicit(&delta[b][2 - first], sign, memory_order_relaxed);
+}
+
+/**
+ * Re-simulates the matchups of one affected army under a tweak: against
+ * every untouched army, and against touched armies with a higher index so
+ * each matchup is played once. Only results that differ from the baseline
+ * are recorded.
+ *
+ * @param analysis The analysis
+ * @param tweak The tweak
+ * @param a The affected army
+ * @param scratch The thread's arena
+ */
+static void rerun_army(ANALYSIS *analysis, TWEAK *tweak, int a, ARENA *scratch) {
+    const ROSTER *roster = analysis->roster;
+    uint64_t changed = 0;
+    for (int b = 0; b < roster->count; b++) {
+        if (b == a || (tweak->touched[b] && b < a)) continue;
+
+        const int first = a < b ? a : b;
+        const int second = a < b ? b : a;
+        CRESULT result;
+        csimulate(roster->armies[first], roster->armies[second], &tweak->catalog, &result, scratch);
+        arena_reset(scratch);
+
+        const int old = analysis->baseline[matchup_id(first, second, roster->count)];
+        if (result.winner != old) {
+            add_delta(tweak->delta, first, second, old, -1);
+            add_delta(tweak->delta, first, second, result.winner, 1);
+            changed++;
+        }
+    }
+    atomic_fetch_add_explicit(&tweak->changed, changed, memory_order_relaxed);
+}
+
+/**
+ * Tweak thread body: takes jobs (one affected army of one tweak) until
+ * none are left.
+ *
+ * @param arg Pointer to the ANALYSIS structure
+ * @return Always NULL
+ */
+static void *analysis_main(void *arg) {
+    ANALYSIS *analysis = arg;
+    ARENA scratch;
+    arena_init(&scratch, 0);
+    trace_thread_name("sensitivity worker");
+
+    while (1) {
+        const uint64_t job = atomic_fetch_add(&analysis->next, 1);
+        if (job >= analysis->jobs) break;
+
+        int t = 0;
+        while (t + 1 < analysis->tweak_count && analysis->tweaks[t + 1].first_job <= job) t++;
+        TWEAK *tweak = &analysis->tweaks[t];
+        const uint64_t span = trace_begin();
+        rerun_army(analysis, tweak, tweak->affected[job - tweak->first_job], &scratch);
+        trace_end("tweak job", span);
+    }
+
+    arena_free(&scratch);
+    return NULL;
+}
+
+/**
+ * Starts `threads` threads running `body` and waits for them.
+ *
+ * @param threads Number of threads
+ * @param body Thread function
+ * @param arg Argument passed to every thread
+ */
+static void run_threads(int threads, void *(*body)(void *), void *arg) {
+    pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+    if (!ids) {
+        error(ERR_MEMORY);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_create(&ids[t], NULL, body, arg);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+}
+
+/**
+ * Baseline thread body.
+ *
+ * @param arg Pointer to the ANALYSIS structure
+ * @return Always NULL
+ */
+static void *baseline_main(void *arg) {
+    ARENA scratch;
+    arena_init(&scratch, 0);
+    trace_thread_name("sensitivity worker");
+    run_baseline(arg, &scratch);
+    arena_free(&scratch);
+    return NULL;
+}
+
+/**
+ * Prints the win rate of every item present in the roster before and after
+ * a tweak. An item's win rate is the share of battles won by armies that
+ * carry it.
+ *
+ * @param roster The armies
+ * @param base Baseline standings
+ * @param tweak The tweak
+ * @param out Stream to print to
+ */
+static void print_item_deltas(const ROSTER *roster, uint32_t (*base)[3], TWEAK *tweak, FILE *out) {
+    fprintf(out, "  %-12s %7s %10s %10s %8s\n", "Item", "Armies", "Base win%", "New win%", "Delta");
+    for (int i = 0; i < item_list.count; i++) {
+        uint64_t armies = 0, played = 0, wins = 0;
+        int64_t delta = 0;
+        for (int a = 0; a < roster->count; a++) {
+            if (!army_has_item(roster->armies[a], i)) continue;
+            armies++;
+            played += base[a][0] + base[a][1] + base[a][2];
+            wins += base[a][0];
+            delta += atomic_load(&tweak->delta[a][0]);
+        }
+        if (armies == 0 || played == 0) continue;
+
+        bool tweaked = false;
+        for (int c = 0; c < tweak->change_count; c++) {
+            tweaked |= tweak->item[c] == i;
+        }
+        const double before = 100.0 * (double) wins / (double) played;
+        const double after = 100.0 * (double) ((int64_t) wins + delta) / (double) played;
+        fprintf(out, "%c %-12.12s %7llu %9.2f%% %9.2f%% %+7.2f\n", tweaked ? '*' : ' ', item_list.items[i].name,
+                (unsigned long long) armies, before, after, after - before);
+    }
+}
+
+/**
+ * Analyzes how hypothetical item stat changes shift the results of a
+ * round robin over a reference roster. The baseline round robin is played
+ * once; for each tweak only the matchups involving an army that carries a
+ * changed item are re-simulated, and tweaks are evaluated in parallel.
+ *
+ * @param roster_path Path of the roster file
+ * @param specs Tweaks, each "item.stat=value[,item.stat=value...]"
+ * @param count Number of tweaks
+ * @param threads Number of threads (0 for one per CPU)
+ * @return 0 on success
+ */
+int run_sensitivity(const char *roster_path, const char *const *specs, int count, int threads) {
+    FILE *file = fopen(roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+    if (roster.count < 2 || count < 1) {
+        error(ERR_UNIT_COUNT);
+    }
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    ANALYSIS analysis = {0};
+    analysis.roster = &roster;
+    analysis.matchups = matchup_count(roster.count);
+    analysis.baseline = malloc(analysis.matchups);
+    analysis.tweaks = calloc(count, sizeof(TWEAK));
+    analysis.tweak_count = count;
+    if (!analysis.baseline || !analysis.tweaks) {
+        error(ERR_MEMORY);
+    }
+    for (int t = 0; t < count; t++) {
+        TWEAK *tweak = &analysis.tweaks[t];
+        parse_tweak(specs[t], tweak);
+        find_affected(tweak, &roster);
+        tweak->first_job = analysis.jobs;
+        analysis.jobs += (uint64_t) tweak->affected_count;
+    }
+
+    double started = now_seconds();
+    atomic_init(&analysis.next, 0);
+    run_threads(threads, baseline_main, &analysis);
+    const double baseline_time = now_seconds() - started;
+
+    uint32_t (*base)[3] = calloc(roster.count, sizeof(*base));
+    if (!base) {
+        error(ERR_MEMORY);
+    }
+    int a = 0, b = 1;
+    for (uint64_t id = 0; id < analysis.matchups; id++) {
+        record_score(base, a, b, analysis.baseline[id]);
+        if (++b == roster.count) {
+            a++;
+            b = a + 1;
+        }
+    }
+
+    started = now_seconds();
+    atomic_store(&analysis.next, 0);
+    run_threads(threads, analysis_main, &analysis);
+    const double tweak_time = now_seconds() - started;
+
+    uint64_t resimulated = 0;
+    for (int t = 0; t < count; t++) {
+        TWEAK *tweak = &analysis.tweaks[t];
+        printf("Tweak %d: %s\n", t + 1, tweak->spec);
+        for (int c = 0; c < tweak->change_count; c++) {
+            const ITEM *item = &item_list.items[tweak->item[c]];
+            const int stat = tweak->stat[c];
+            const unsigned int old = stat == STAT_ATT ? item->att
+                                   : stat == STAT_DEF ? item->def
+                                   : stat == STAT_RANGE ? item->range : item->radius;
+            printf("  %s %s: %u -> %d\n", item->name, stat_names[stat], old, tweak->value[c]);
+        }
+        printf("  %d of %d armies affected, %llu of %llu matchups re-simulated (%.1f%%), %llu outcomes changed\n",
+               tweak->affected_count, roster.count, (unsigned long long) tweak->matchups,
+               (unsigned long long) analysis.matchups,
+               analysis.matchups ? 100.0 * tweak->matchups / analysis.matchups : 0.0,
+               (unsigned long long) atomic_load(&tweak->changed));
+        print_item_deltas(&roster, base, tweak, stdout);
+        printf("\n");
+        resimulated += tweak->matchups;
+
+        free(tweak->affected);
+        free(tweak->touched);
+        free(tweak->delta);
+    }
+
+    const double full = (double) analysis.matchups * count;
+    printf("Baseline: %llu battles in %.3f s\n", (unsigned long long) analysis.matchups, baseline_time);
+    printf("%d tweaks: %llu battles in %.3f s on %d threads (%.1f%% of %.0f for full recomputation)\n", count,
+           (unsigned long long) resimulated, tweak_time, threads, full > 0 ? 100.0 * resimulated / full : 0.0, full);
+
+    free(base);
+    free(analysis.baseline);
+    free(analysis.tweaks);
+    free_roster(&roster);
+    return 0;
+}
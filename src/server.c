@@ -0,0 +1,1061 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_READ_CHUNK 65536
+#define SERVER_MAX_FRAME (1 << 20)
+#define SERVER_MAX_INFLIGHT 256
+#define SERVER_MAX_OUTPUT (1 << 20)
+#define SERVER_MAX_TOURNAMENT 1024
+#define SERVER_BATCH 16
+#define LATENCY_LINEAR 16
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKETS (LATENCY_LINEAR + 40 * LATENCY_SUB_BUCKETS)
+
+enum {
+    LANE_INTERACTIVE,
+    LANE_BULK,
+    LANE_COUNT
+};
+
+/**
+ * A client connection. Owned by the event loop thread; workers never touch it
+ * directly, they only carry a pointer back through the completion queue.
+ */
+typedef struct connection {
+    int fd;
+    uint8_t *in;
+    size_t in_len;
+    size_t in_cap;
+    uint8_t *out;
+    size_t out_off;
+    size_t out_len;
+    size_t out_cap;
+    int inflight;
+    bool paused;
+    bool closed;
+    uint32_t events;
+    struct connection *prev;
+    struct connection *next;
+} CONNECTION;
+
+/**
+ * A single decoded request frame travelling from the event loop to a worker
+ * and back again with its encoded response.
+ */
+typedef struct job {
+    CONNECTION *conn;
+    uint32_t id;
+    uint8_t type;
+    uint8_t *payload;
+    size_t payload_len;
+    uint8_t *response;
+    size_t response_len;
+    double received;
+    struct job *next;
+} JOB;
+
+typedef struct {
+    JOB *head;
+    JOB *tail;
+} JOB_LIST;
+
+/**
+ * Counters of one scheduling lane, owned by the event loop thread.
+ * `depth` counts jobs submitted but not yet answered. Latencies run from
+ * the moment a request is framed until its response is queued for the
+ * client, in microseconds, on a log-linear histogram (exact below
+ * LATENCY_LINEAR, then LATENCY_SUB_BUCKETS buckets per power of two).
+ */
+typedef struct {
+    int depth;
+    int peak_depth;
+    uint64_t completed;
+    uint64_t within_target;
+    uint64_t histogram[LATENCY_BUCKETS];
+} LANE;
+
+/**
+ * Shared server state.
+ * Requests are scheduled in two lanes: single matchups are interactive and
+ * tournaments are bulk. Workers always take interactive jobs first, and a
+ * worker busy with a tournament serves waiting interactive jobs between
+ * battles, so a quick question never waits for a sweep to finish.
+ * Each lane is bounded separately: the event loop stops reading from a
+ * client whose next request would exceed `queue_limit` jobs in its lane,
+ * and resumes once a lane has drained below half of it.
+ */
+typedef struct {
+    int epoll_fd;
+    int listen_fd;
+    int event_fd;
+    int signal_fd;
+
+    pthread_mutex_t queue_lock;
+    pthread_cond_t queue_cond;
+    JOB_LIST queue[LANE_COUNT];
+    atomic_int interactive_waiting;
+    atomic_uint_fast64_t yields;
+    bool stopping;
+
+    pthread_mutex_t done_lock;
+    JOB_LIST done;
+
+    int queue_limit;
+    double latency_target;
+    LANE lanes[LANE_COUNT];
+    CONNECTION *connections;
+} SERVER;
+
+static int listen_marker;
+static int event_marker;
+static int signal_marker;
+
+/**
+ * Appends a list of jobs to the end of another list.
+ *
+ * @param list Destination list
+ * @param head First job of the chain to append
+ * @param tail Last job of the chain to append
+ */
+static void list_append(JOB_LIST *list, JOB *head, JOB *tail) {
+    if (!head) return;
+    if (list->tail) {
+        list->tail->next = head;
+    } else {
+        list->head = head;
+    }
+    list->tail = tail;
+    tail->next = NULL;
+}
+
+/**
+ * Frees a job together with its payload and response buffers.
+ *
+ * @param job The job to free
+ */
+static void free_job(JOB *job) {
+    free(job->payload);
+    free(job->response);
+    free(job);
+}
+
+/**
+ * Allocates the response frame for a job and writes its header.
+ *
+ * Response frame layout:
+ *   u32 body length
+ *   u8  request type | 0x80
+ *   u32 request id
+ *   u8  status (RESP_OK or RESP_BAD_REQUEST)
+ *   ... payload
+ *
+ * @param job The job being answered
+ * @param status Status code for the response
+ * @param payload_len Number of payload bytes that will follow the header
+ * @return Pointer to the start of the payload area
+ */
+static uint8_t *begin_response(JOB *job, uint8_t status, size_t payload_len) {
+    const size_t body = 1 + 4 + 1 + payload_len;
+    job->response = malloc(4 + body);
+    if (!job->response) {
+        error(ERR_MEMORY);
+    }
+    job->response_len = 4 + body;
+
+    wire_put_u32(job->response, (uint32_t) body);
+    job->response[4] = job->type | 0x80;
+    wire_put_u32(job->response + 5, job->id);
+    job->response[9] = status;
+    return job->response + 10;
+}
+
+/**
+ * Resolves a single matchup request.
+ * Payload: two encoded armies.
+ * Response payload: i8 result code of battle_round(), u32 rounds, and for each
+ * army u8 surviving units and u32 remaining HP.
+ *
+ * @param job The job to process
+ */
+static void handle_resolve(JOB *job) {
+    ARMY army1, army2;
+    const int used1 = decode_army(job->payload, job->payload_len, &army1);
+    if (used1 < 0) {
+        begin_response(job, RESP_BAD_REQUEST, 0);
+        return;
+    }
+    const int used2 = decode_army(job->payload + used1, job->payload_len - used1, &army2);
+    if (used2 < 0 || (size_t) (used1 + used2) != job->payload_len) {
+        begin_response(job, RESP_BAD_REQUEST, 0);
+        return;
+    }
+
+    int rounds;
+    const int result = simulate_battle(&army1, &army2, &rounds);
+
+    uint8_t *p = begin_response(job, RESP_OK, 1 + 4 + 2 * (1 + 4));
+    *p++ = (uint8_t) (int8_t) result;
+    wire_put_u32(p, (uint32_t) rounds);
+    p += 4;
+
+    const ARMY *armies[2] = {&army1, &army2};
+    for (int s = 0; s < 2; s++) {
+        uint32_t hp = 0;
+        for (int i = 0; i <= armies[s]->top; i++) {
+            hp += (uint32_t) armies[s]->units[i].hp;
+        }
+        *p++ = (uint8_t) (armies[s]->top + 1);
+        wire_put_u32(p, hp);
+        p += 4;
+    }
+}
+
+/**
+ * Hands a chain of answered jobs back to the event loop.
+ *
+ * @param server The server
+ * @param head First job of the chain
+ * @param tail Last job of the chain
+ */
+static void complete_jobs(SERVER *server, JOB *head, JOB *tail) {
+    pthread_mutex_lock(&server->done_lock);
+    list_append(&server->done, head, tail);
+    pthread_mutex_unlock(&server->done_lock);
+
+    const uint64_t one = 1;
+    if (write(server->event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        warning(ERR_SOCKET);
+    }
+}
+
+/**
+ * Takes up to `limit` jobs from the front of a lane. The caller holds the
+ * queue lock and has checked that the lane is not empty.
+ *
+ * @param server The server
+ * @param lane Lane to take from
+ * @param limit Maximum number of jobs
+ * @param tail Output last job of the returned chain
+ * @return First job of the chain
+ */
+static JOB *take_jobs(SERVER *server, int lane, int limit, JOB **tail) {
+    JOB_LIST *queue = &server->queue[lane];
+    JOB *head = queue->head;
+    JOB *last = head;
+    int taken = 1;
+    for (; taken < limit && last->next; taken++) {
+        last = last->next;
+    }
+    queue->head = last->next;
+    if (!queue->head) {
+        queue->tail = NULL;
+    }
+    last->next = NULL;
+    if (lane == LANE_INTERACTIVE) {
+        atomic_fetch_sub(&server->interactive_waiting, taken);
+    }
+    *tail = last;
+    return head;
+}
+
+/**
+ * Answers a job of the interactive lane.
+ *
+ * @param job The job to process
+ */
+static void run_interactive(JOB *job) {
+    const uint64_t span = trace_begin();
+    if (job->type == REQ_RESOLVE) {
+        handle_resolve(job);
+        trace_end("resolve", span);
+    } else {
+        begin_response(job, RESP_BAD_REQUEST, 0);
+    }
+}
+
+/**
+ * Answers every interactive job waiting in the queue. Called by workers
+ * busy with bulk work at battle boundaries, so interactive requests do not
+ * wait for a tournament to finish.
+ *
+ * @param server The server
+ */
+static void serve_interactive(SERVER *server) {
+    while (atomic_load_explicit(&server->interactive_waiting, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&server->queue_lock);
+        if (!server->queue[LANE_INTERACTIVE].head) {
+            pthread_mutex_unlock(&server->queue_lock);
+            return;
+        }
+        JOB *tail;
+        JOB *head = take_jobs(server, LANE_INTERACTIVE, SERVER_BATCH, &tail);
+        pthread_mutex_unlock(&server->queue_lock);
+
+        atomic_fetch_add_explicit(&server->yields, 1, memory_order_relaxed);
+        for (JOB *job = head; job; job = job->next) {
+            run_interactive(job);
+        }
+        complete_jobs(server, head, tail);
+    }
+}
+
+/**
+ * Runs a round-robin tournament request: every army fights every other army once.
+ * Between battles the worker yields to waiting interactive jobs. Battles are
+ * at most MAX_ARMY units a side and take about a microsecond, so this bounds
+ * the wait of an interactive request as well as a check every round would.
+ * Payload: u16 army count followed by that many encoded armies.
+ * Response payload: u16 army count, then per army u32 wins, u32 draws, u32 losses.
+ *
+ * @param server The server
+ * @param job The job to process
+ */
+static void handle_tournament(SERVER *server, JOB *job) {
+    if (job->payload_len < 2) {
+        begin_response(job, RESP_BAD_REQUEST, 0);
+        return;
+    }
+    const int n = wire_get_u16(job->payload);
+    if (n < 2 || n > SERVER_MAX_TOURNAMENT) {
+        begin_response(job, RESP_BAD_REQUEST, 0);
+        return;
+    }
+
+    // Armies are held in compact form, packed back to back at a fixed stride
+    const size_t stride = carmy_size(MAX_ARMY);
+    uint8_t *storage = malloc(stride * n);
+    uint32_t (*score)[3] = calloc(n, sizeof(*score));
+    if (!storage || !score) {
+        error(ERR_MEMORY);
+    }
+
+    size_t off = 2;
+    for (int i = 0; i < n; i++) {
+        ARMY army;
+        const int used = decode_army(job->payload + off, job->payload_len - off, &army);
+        if (used < 0) {
+            free(storage);
+            free(score);
+            begin_response(job, RESP_BAD_REQUEST, 0);
+            return;
+        }
+        compact_army(&army, (CARMY *) (storage + stride * i));
+        off += used;
+    }
+    if (off != job->payload_len) {
+        free(storage);
+        free(score);
+        begin_response(job, RESP_BAD_REQUEST, 0);
+        return;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            const int result = csimulate((CARMY *) (storage + stride * i), (CARMY *) (storage + stride * j),
+                                         &combat_catalog, NULL, NULL);
+            if (result == 1) {
+                score[i][0]++;
+                score[j][2]++;
+            } else if (result == 2) {
+                score[j][0]++;
+                score[i][2]++;
+            } else {
+                score[i][1]++;
+                score[j][1]++;
+            }
+            if (atomic_load_explicit(&server->interactive_waiting, memory_order_relaxed) > 0) {
+                serve_interactive(server);
+            }
+        }
+    }
+
+    uint8_t *p = begin_response(job, RESP_OK, 2 + (size_t) n * 12);
+    wire_put_u16(p, (uint16_t) n);
+    p += 2;
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < 3; k++) {
+            wire_put_u32(p, score[i][k]);
+            p += 4;
+        }
+    }
+
+    free(storage);
+    free(score);
+}
+
+/**
+ * Worker thread: pulls jobs from the queues, computes their responses and
+ * hands them back to the event loop through the completion queue.
+ * Interactive jobs are taken first, in batches; tournaments one at a time,
+ * so every idle worker can pick up the next one.
+ *
+ * @param arg Pointer to the SERVER structure
+ * @return Always NULL
+ */
+static void *worker_main(void *arg) {
+    SERVER *server = arg;
+    trace_thread_name("server worker");
+
+    while (1) {
+        pthread_mutex_lock(&server->queue_lock);
+        while (!server->queue[LANE_INTERACTIVE].head && !server->queue[LANE_BULK].head && !server->stopping) {
+            pthread_cond_wait(&server->queue_cond, &server->queue_lock);
+        }
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->queue_lock);
+            return NULL;
+        }
+
+        JOB *tail;
+        const int lane = server->queue[LANE_INTERACTIVE].head ? LANE_INTERACTIVE : LANE_BULK;
+        JOB *head = take_jobs(server, lane, lane == LANE_INTERACTIVE ? SERVER_BATCH : 1, &tail);
+        pthread_mutex_unlock(&server->queue_lock);
+
+        for (JOB *job = head; job; job = job->next) {
+            if (lane == LANE_INTERACTIVE) {
+                run_interactive(job);
+                continue;
+            }
+            const uint64_t span = trace_begin();
+            handle_tournament(server, job);
+            trace_end("tournament", span);
+        }
+        complete_jobs(server, head, tail);
+    }
+}
+
+/**
+ * Updates the epoll registration of a connection if its interest set changed.
+ *
+ * @param server The server
+ * @param conn The connection
+ * @param events The desired epoll event mask
+ */
+static void set_events(SERVER *server, CONNECTION *conn, uint32_t events) {
+    if (conn->closed || conn->events == events) return;
+
+    struct epoll_event ev = {.events = events, .data.ptr = conn};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->events = events;
+}
+
+/**
+ * Recomputes the epoll interest set of a connection from its state:
+ * reading is disabled while the connection is paused by backpressure and
+ * writing is requested only while output is pending.
+ *
+ * @param server The server
+ * @param conn The connection
+ */
+static void update_events(SERVER *server, CONNECTION *conn) {
+    uint32_t events = 0;
+    if (!conn->paused) events |= EPOLLIN;
+    if (conn->out_len > conn->out_off) events |= EPOLLOUT;
+    set_events(server, conn, events);
+}
+
+/**
+ * Frees every connection that is closed and no longer referenced by a worker job.
+ * Called once per event loop iteration so that events already returned by
+ * epoll_wait() never point to freed memory.
+ *
+ * @param server The server
+ */
+static void sweep_connections(SERVER *server) {
+    CONNECTION *conn = server->connections;
+    while (conn) {
+        CONNECTION *next = conn->next;
+        if (conn->closed && conn->inflight == 0) {
+            if (conn->prev) {
+                conn->prev->next = conn->next;
+            } else {
+                server->connections = conn->next;
+            }
+            if (conn->next) {
+                conn->next->prev = conn->prev;
+            }
+            free(conn->in);
+            free(conn->out);
+            free(conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Closes the socket of a connection. The structure itself survives until all
+ * of its in-flight jobs have come back from the workers and it is swept.
+ *
+ * @param server The server
+ * @param conn The connection
+ */
+static void close_connection(SERVER *server, CONNECTION *conn) {
+    (void) server;
+    if (conn->closed) return;
+
+    close(conn->fd);
+    conn->closed = true;
+}
+
+/**
+ * Returns the scheduling lane of a request type.
+ *
+ * @param type Request type
+ * @return LANE_BULK for tournaments, LANE_INTERACTIVE for everything else
+ */
+static int job_lane(uint8_t type) {
+    return type == REQ_TOURNAMENT ? LANE_BULK : LANE_INTERACTIVE;
+}
+
+/**
+ * Checks whether a connection may accept more requests right now.
+ *
+ * @param server The server
+ * @param conn The connection
+ * @return true if the connection is below its limits and some lane has room
+ */
+static bool has_capacity(const SERVER *server, const CONNECTION *conn) {
+    return (server->lanes[LANE_INTERACTIVE].depth < server->queue_limit ||
+            server->lanes[LANE_BULK].depth < server->queue_limit) &&
+           conn->inflight < SERVER_MAX_INFLIGHT &&
+           conn->out_len - conn->out_off < SERVER_MAX_OUTPUT;
+}
+
+/**
+ * Returns the histogram bucket of a latency.
+ *
+ * @param us Latency in microseconds
+ * @return Bucket index
+ */
+static int latency_bucket(uint64_t us) {
+    if (us < LATENCY_LINEAR) return (int) us;
+    const int exponent = 63 - __builtin_clzll(us);
+    const int index = LATENCY_LINEAR + (exponent - 4) * LATENCY_SUB_BUCKETS +
+                      (int) ((us >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1));
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+/**
+ * Returns the largest latency that falls into a histogram bucket.
+ *
+ * @param index Bucket index
+ * @return Latency in microseconds
+ */
+static uint64_t bucket_latency(int index) {
+    if (index < LATENCY_LINEAR) return (uint64_t) index;
+    const int exponent = 4 + (index - LATENCY_LINEAR) / LATENCY_SUB_BUCKETS;
+    const uint64_t sub = (uint64_t) ((index - LATENCY_LINEAR) % LATENCY_SUB_BUCKETS);
+    return ((LATENCY_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+/**
+ * Returns a latency percentile of a lane, to the resolution of its histogram.
+ *
+ * @param lane The lane
+ * @param fraction Percentile as a fraction, e.g. 0.99
+ * @return Latency in microseconds, or 0 if nothing was completed
+ */
+static uint64_t lane_percentile(const LANE *lane, double fraction) {
+    if (lane->completed == 0) return 0;
+    uint64_t rank = (uint64_t) (fraction * (double) lane->completed + 0.999999);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += lane->histogram[i];
+        if (seen >= rank) return bucket_latency(i);
+    }
+    return bucket_latency(LATENCY_BUCKETS - 1);
+}
+
+/**
+ * Accounts for an answered job in its lane.
+ *
+ * @param server The server
+ * @param job The job
+ * @param now Current time in seconds
+ */
+static void record_latency(SERVER *server, const JOB *job, double now) {
+    LANE *lane = &server->lanes[job_lane(job->type)];
+    const double latency = now - job->received;
+    const uint64_t us = latency > 0 ? (uint64_t) (latency * 1e6) : 0;
+    lane->depth--;
+    lane->completed++;
+    lane->histogram[latency_bucket(us)]++;
+    if (latency <= server->latency_target) {
+        lane->within_target++;
+    }
+}
+
+/**
+ * Answers a statistics request directly from the event loop.
+ * Response payload: u32 interactive latency target in microseconds, u32 bulk
+ * yields to interactive work, then for the interactive and the bulk lane
+ * u32 queue depth, u32 peak depth, u32 completed, u32 completed within the
+ * target, u32 p50 and u32 p99 latency in microseconds.
+ *
+ * @param server The server
+ * @param job The request
+ */
+static void handle_stats(SERVER *server, JOB *job) {
+    uint8_t *p = begin_response(job, RESP_OK, 8 + LANE_COUNT * 24);
+    wire_put_u32(p, (uint32_t) (server->latency_target * 1e6));
+    wire_put_u32(p + 4, (uint32_t) atomic_load(&server->yields));
+    p += 8;
+    for (int l = 0; l < LANE_COUNT; l++) {
+        const LANE *lane = &server->lanes[l];
+        const uint32_t values[6] = {
+            (uint32_t) lane->depth, (uint32_t) lane->peak_depth, (uint32_t) lane->completed,
+            (uint32_t) lane->within_target, (uint32_t) lane_percentile(lane, 0.50),
+            (uint32_t) lane_percentile(lane, 0.99),
+        };
+        for (int k = 0; k < 6; k++) {
+            wire_put_u32(p, values[k]);
+            p += 4;
+        }
+    }
+}
+
+/**
+ * Appends an encoded response to the output buffer of a connection.
+ *
+ * @param conn The connection
+ * @param data Response bytes
+ * @param len Number of bytes
+ */
+static void queue_output(CONNECTION *conn, const uint8_t *data, size_t len) {
+    if (conn->out_cap - conn->out_len < len) {
+        size_t cap = conn->out_cap ? conn->out_cap : 4096;
+        while (cap - conn->out_len < len) cap *= 2;
+        uint8_t *out = realloc(conn->out, cap);
+        if (!out) {
+            error(ERR_MEMORY);
+        }
+        conn->out = out;
+        conn->out_cap = cap;
+    }
+    memcpy(conn->out + conn->out_len, data, len);
+    conn->out_len += len;
+}
+
+/**
+ * Splits the buffered input of a connection into request frames and submits
+ * them to the queues of their lanes, one batch per lane. Statistics requests
+ * are answered on the spot.
+ * Request frame layout: u32 body length, then body = u8 type, u32 id, payload.
+ * Parsing stops early when backpressure limits are reached, for the
+ * connection or for the lane of the next request; the remaining bytes stay
+ * buffered and the connection is paused.
+ *
+ * @param server The server
+ * @param conn The connection
+ */
+static void process_input(SERVER *server, CONNECTION *conn) {
+    JOB_LIST batch[LANE_COUNT] = {{NULL, NULL}, {NULL, NULL}};
+    size_t off = 0;
+    bool bad_frame = false;
+    const double now = now_seconds();
+
+    while (conn->in_len - off >= 4) {
+        if (!has_capacity(server, conn)) {
+            conn->paused = true;
+            break;
+        }
+
+        const uint32_t body = wire_get_u32(conn->in + off);
+        if (body < 5 || body > SERVER_MAX_FRAME) {
+            bad_frame = true;
+            break;
+        }
+        if (conn->in_len - off < 4 + (size_t) body) break;
+
+        const uint8_t type = conn->in[off + 4];
+        if (type == REQ_STATS) {
+            JOB stats = {.type = type, .id = wire_get_u32(conn->in + off + 5)};
+            handle_stats(server, &stats);
+            queue_output(conn, stats.response, stats.response_len);
+            free(stats.response);
+            off += 4 + body;
+            continue;
+        }
+        LANE *lane = &server->lanes[job_lane(type)];
+        if (lane->depth >= server->queue_limit) {
+            conn->paused = true;
+            break;
+        }
+
+        JOB *job = calloc(1, sizeof(JOB));
+        if (!job) {
+            error(ERR_MEMORY);
+        }
+        job->conn = conn;
+        job->type = type;
+        job->id = wire_get_u32(conn->in + off + 5);
+        job->received = now;
+        job->payload_len = body - 5;
+        job->payload = malloc(job->payload_len ? job->payload_len : 1);
+        if (!job->payload) {
+            error(ERR_MEMORY);
+        }
+        memcpy(job->payload, conn->in + off + 9, job->payload_len);
+        list_append(&batch[job_lane(type)], job, job);
+
+        conn->inflight++;
+        if (++lane->depth > lane->peak_depth) {
+            lane->peak_depth = lane->depth;
+        }
+        off += 4 + body;
+    }
+
+    if (off > 0) {
+        memmove(conn->in, conn->in + off, conn->in_len - off);
+        conn->in_len -= off;
+    }
+
+    if (batch[LANE_INTERACTIVE].head || batch[LANE_BULK].head) {
+        int interactive = 0;
+        for (JOB *job = batch[LANE_INTERACTIVE].head; job; job = job->next) interactive++;
+        pthread_mutex_lock(&server->queue_lock);
+        for (int l = 0; l < LANE_COUNT; l++) {
+            list_append(&server->queue[l], batch[l].head, batch[l].tail);
+        }
+        atomic_fetch_add(&server->interactive_waiting, interactive);
+        pthread_cond_broadcast(&server->queue_cond);
+        pthread_mutex_unlock(&server->queue_lock);
+    }
+
+    if (bad_frame) {
+        close_connection(server, conn);
+    } else {
+        update_events(server, conn);
+    }
+}
+
+/**
+ * Reads available bytes from a readable connection and processes them.
+ *
+ * @param server The server
+ * @param conn The connection
+ */
+static void handle_readable(SERVER *server, CONNECTION *conn) {
+    if (conn->in_cap - conn->in_len < SERVER_READ_CHUNK) {
+        const size_t cap = conn->in_cap ? conn->in_cap * 2 : SERVER_READ_CHUNK * 2;
+        uint8_t *in = realloc(conn->in, cap);
+        if (!in) {
+            error(ERR_MEMORY);
+        }
+        conn->in = in;
+        conn->in_cap = cap;
+    }
+
+    const ssize_t n = read(conn->fd, conn->in + conn->in_len, conn->in_cap - conn->in_len);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+        close_connection(server, conn);
+        return;
+    }
+    if (n > 0) {
+        conn->in_len += (size_t) n;
+        process_input(server, conn);
+    }
+}
+
+/**
+ * Writes as much pending output as the socket accepts.
+ *
+ * @param server The server
+ * @param conn The connection
+ */
+static void flush_output(SERVER *server, CONNECTION *conn) {
+    while (conn->out_off < conn->out_len) {
+        const ssize_t n = send(conn->fd, conn->out + conn->out_off, conn->out_len - conn->out_off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) break;
+            close_connection(server, conn);
+            return;
+        }
+        conn->out_off += (size_t) n;
+    }
+    if (conn->out_off == conn->out_len) {
+        conn->out_off = 0;
+        conn->out_len = 0;
+    }
+    if (conn->paused && has_capacity(server, conn)) {
+        conn->paused = false;
+        process_input(server, conn);
+    } else {
+        update_events(server, conn);
+    }
+}
+
+/**
+ * Drains the completion queue: routes responses to their connections and
+ * resumes paused connections once the server has room for more work.
+ *
+ * @param server The server
+ */
+static void handle_completions(SERVER *server) {
+    uint64_t count;
+    if (read(server->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        warning(ERR_SOCKET);
+    }
+
+    pthread_mutex_lock(&server->done_lock);
+    JOB *job = server->done.head;
+    server->done.head = server->done.tail = NULL;
+    pthread_mutex_unlock(&server->done_lock);
+
+    const double now = now_seconds();
+    while (job) {
+        JOB *next = job->next;
+        CONNECTION *conn = job->conn;
+        conn->inflight--;
+        record_latency(server, job, now);
+
+        if (!conn->closed) {
+            queue_output(conn, job->response, job->response_len);
+            flush_output(server, conn);
+        }
+        free_job(job);
+        job = next;
+    }
+
+    if (server->lanes[LANE_INTERACTIVE].depth > server->queue_limit / 2 &&
+        server->lanes[LANE_BULK].depth > server->queue_limit / 2) {
+        return;
+    }
+
+    for (CONNECTION *conn = server->connections; conn; conn = conn->next) {
+        if (conn->paused && !conn->closed && has_capacity(server, conn)) {
+            conn->paused = false;
+            process_input(server, conn);
+        }
+    }
+}
+
+/**
+ * Accepts all pending client connections.
+ *
+ * @param server The server
+ */
+static void handle_accept(SERVER *server) {
+    while (1) {
+        const int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR) {
+                warning(ERR_SOCKET);
+            }
+            return;
+        }
+
+        CONNECTION *conn = calloc(1, sizeof(CONNECTION));
+        if (!conn) {
+            error(ERR_MEMORY);
+        }
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        conn->next = server->connections;
+        if (conn->next) {
+            conn->next->prev = conn;
+        }
+        server->connections = conn;
+
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = conn};
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/**
+ * Registers a file descriptor with the epoll instance.
+ *
+ * @param server The server
+ * @param fd Descriptor to watch for readability
+ * @param marker Pointer identifying the descriptor in epoll events
+ */
+static void watch(SERVER *server, int fd, void *marker) {
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = marker};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        error(ERR_SOCKET);
+    }
+}
+
+/**
+ * Prints the queue and latency counters of both lanes.
+ *
+ * @param server The server
+ * @param out Stream to print to
+ */
+static void print_lanes(const SERVER *server, FILE *out) {
+    static const char *const names[LANE_COUNT] = {"interactive", "bulk"};
+    fprintf(out, "%-12s %10s %10s %10s %10s %10s\n", "Lane", "Requests", "Peak queue", "p50 us", "p99 us",
+            "In target");
+    for (int l = 0; l < LANE_COUNT; l++) {
+        const LANE *lane = &server->lanes[l];
+        fprintf(out, "%-12s %10llu %10d %10llu %10llu %9.1f%%\n", names[l], (unsigned long long) lane->completed,
+                lane->peak_depth, (unsigned long long) lane_percentile(lane, 0.50),
+                (unsigned long long) lane_percentile(lane, 0.99),
+                lane->completed ? 100.0 * (double) lane->within_target / (double) lane->completed : 100.0);
+    }
+    fprintf(out, "Latency target %.1f ms; bulk work yielded to interactive requests %llu times\n",
+            server->latency_target * 1e3, (unsigned long long) atomic_load(&server->yields));
+}
+
+/**
+ * Runs the battle-resolution daemon on a Unix domain socket until SIGINT or SIGTERM.
+ * The catalog in item_list must already be loaded; it is shared read-only by all workers.
+ *
+ * A single epoll thread accepts clients, frames requests and writes responses,
+ * while a bounded pool of workers resolves matchups and tournaments. On
+ * shutdown the latency counters of both lanes are printed.
+ *
+ * @param socket_path Filesystem path of the socket to listen on
+ * @param workers Number of worker threads (0 selects one per online CPU)
+ * @param queue_limit Maximum number of outstanding requests per lane before clients are throttled
+ * @param latency_target Latency goal for interactive requests in milliseconds (0 for the default of 5)
+ * @return 0 on clean shutdown
+ */
+int run_server(const char *socket_path, int workers, int queue_limit, double latency_target) {
+    if (workers <= 0) {
+        workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (workers <= 0) workers = 1;
+    }
+    if (queue_limit <= 0) {
+        queue_limit = 1024;
+    }
+
+    if (latency_target <= 0) {
+        latency_target = 5;
+    }
+
+    SERVER server = {0};
+    server.queue_limit = queue_limit;
+    server.latency_target = latency_target / 1e3;
+    atomic_init(&server.interactive_waiting, 0);
+    atomic_init(&server.yields, 0);
+    pthread_mutex_init(&server.queue_lock, NULL);
+    pthread_cond_init(&server.queue_cond, NULL);
+    pthread_mutex_init(&server.done_lock, NULL);
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        error(ERR_SOCKET);
+    }
+    strcpy(addr.sun_path, socket_path);
+    unlink(socket_path);
+
+    server.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server.listen_fd < 0 ||
+        bind(server.listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(server.listen_fd, SOMAXCONN) < 0) {
+        error(ERR_SOCKET);
+    }
+
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    server.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (server.epoll_fd < 0 || server.event_fd < 0 || server.signal_fd < 0) {
+        error(ERR_SOCKET);
+    }
+    watch(&server, server.listen_fd, &listen_marker);
+    watch(&server, server.event_fd, &event_marker);
+    watch(&server, server.signal_fd, &signal_marker);
+
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    if (!threads) {
+        error(ERR_MEMORY);
+    }
+    for (int i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, worker_main, &server);
+    }
+
+    char message[MAX_NAME + 64];
+    snprintf(message, sizeof(message), "Server listening on %s with %d workers", socket_path, workers);
+    info(message);
+
+    bool running = true;
+    while (running) {
+        struct epoll_event events[SERVER_MAX_EVENTS];
+        const int n = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error(ERR_SOCKET);
+        }
+
+        for (int i = 0; i < n; i++) {
+            void *source = events[i].data.ptr;
+            if (source == &listen_marker) {
+                handle_accept(&server);
+            } else if (source == &event_marker) {
+                handle_completions(&server);
+            } else if (source == &signal_marker) {
+                running = false;
+            } else {
+                CONNECTION *conn = source;
+                if (!conn->closed && (events[i].events & (EPOLLERR | EPOLLHUP)) && !(events[i].events & EPOLLIN)) {
+                    close_connection(&server, conn);
+                }
+                if (!conn->closed && (events[i].events & EPOLLOUT)) {
+                    flush_output(&server, conn);
+                }
+                if (!conn->closed && (events[i].events & EPOLLIN)) {
+                    handle_readable(&server, conn);
+                }
+            }
+        }
+        sweep_connections(&server);
+    }
+
+    pthread_mutex_lock(&server.queue_lock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.queue_cond);
+    pthread_mutex_unlock(&server.queue_lock);
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    for (int l = 0; l < LANE_COUNT; l++) {
+        for (JOB *job = server.queue[l].head, *next; job; job = next) {
+            next = job->next;
+            free_job(job);
+        }
+    }
+    for (JOB *job = server.done.head, *next; job; job = next) {
+        next = job->next;
+        free_job(job);
+    }
+    for (CONNECTION *conn = server.connections; conn; conn = conn->next) {
+        close_connection(&server, conn);
+        conn->inflight = 0;
+    }
+    sweep_connections(&server);
+
+    close(server.listen_fd);
+    close(server.event_fd);
+    close(server.signal_fd);
+    close(server.epoll_fd);
+    unlink(socket_path);
+
+    print_lanes(&server, stdout);
+    info("Server stopped");
+    return 0;
+}
@@ -0,0 +1,642 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define TOURNAMENT_CHUNK 256
+#define TOURNAMENT_TILE_MIN 16
+#define TOURNAMENT_TILE_MAX 256
+#define TOURNAMENT_DEFAULT_CACHE (8 << 20)
+
+/**
+ * A simulated matchup as handed from a worker to the output stage.
+ */
+typedef struct {
+    uint64_t matchup;
+    CRESULT result;
+} MATCH_RESULT;
+
+/**
+ * State shared by all workers of a tournament run.
+ */
+typedef struct {
+    const ROSTER *roster;
+    const BATTLE_LIMITS *limits;
+    OUTCOME_DB *db;
+    DASHBOARD *dashboard;
+    uint64_t first;
+    uint64_t total;
+    atomic_uint_fast64_t next;
+    atomic_uint_fast64_t skipped;
+    const uint8_t *done_before;
+    RESULT_WRITER *output;
+    pthread_mutex_t output_lock;
+    uint32_t (*score)[3];
+    int tile;
+    int tiles_per_side;
+    CACHE_STATS cache;
+    const char *checkpoint_path;
+    double checkpoint_interval;
+    double checkpoint_time;
+    double checkpoint_seconds;
+    int checkpoint_saves;
+    CHECKPOINT checkpoint;
+} TOURNAMENT;
+
+/**
+ * Per-thread state. Each worker owns its arenas, so no allocation in the
+ * simulation loop touches the shared heap.
+ */
+typedef struct {
+    TOURNAMENT *tournament;
+    pthread_t thread;
+    int index;
+    int tile_cursor;
+    ARENA scratch;
+    ARENA blocks;
+    BLOCK_POOL results;
+} WORKER;
+
+/**
+ * Returns the number of distinct matchups in a round robin over n armies.
+ *
+ * @param n Number of armies
+ * @return n * (n - 1) / 2
+ */
+uint64_t matchup_count(int n) {
+    return n < 2 ? 0 : (uint64_t) n * (uint64_t) (n - 1) / 2;
+}
+
+/**
+ * Maps a matchup id to the pair of armies it refers to.
+ * Matchups are numbered row by row: (0,1), (0,2), ..., (0,n-1), (1,2), ...
+ *
+ * @param id Matchup id in [0, matchup_count(n))
+ * @param n Number of armies
+ * @param a Output index of the first army
+ * @param b Output index of the second army (always greater than a)
+ */
+void matchup_pair(uint64_t id, int n, int *a, int *b) {
+    // Rows before row i hold i * (2n - i - 1) / 2 matchups; invert, then correct rounding
+    const double m = 2.0 * n - 1.0;
+    int i = (int) ((m - sqrt(m * m - 8.0 * (double) id)) / 2.0);
+    if (i < 0) i = 0;
+    while (i > 0 && (uint64_t) i * (2 * (uint64_t) n - i - 1) / 2 > id) i--;
+    while ((uint64_t) (i + 1) * (2 * (uint64_t) n - i - 2) / 2 <= id) i++;
+
+    const uint64_t row_start = (uint64_t) i * (2 * (uint64_t) n - i - 1) / 2;
+    *a = i;
+    *b = i + 1 + (int) (id - row_start);
+}
+
+/**
+ * Returns the id of the matchup between two armies (inverse of matchup_pair()).
+ *
+ * @param a Index of the first army
+ * @param b Index of the second army (greater than a)
+ * @param n Number of armies
+ * @return Matchup id
+ */
+uint64_t matchup_id(int a, int b, int n) {
+    return (uint64_t) a * (2 * (uint64_t) n - a - 1) / 2 + (uint64_t) (b - a - 1);
+}
+
+/**
+ * Records the outcome of one matchup in a score table of wins, draws and losses.
+ *
+ * @param score Per-army score table
+ * @param a Index of the first army
+ * @param b Index of the second army
+ * @param winner Result code of the battle (timeouts count as draws)
+ */
+void record_score(uint32_t (*score)[3], int a, int b, int winner) {
+    if (winner == 1) {
+        score[a][0]++;
+        score[b][2]++;
+    } else if (winner == 2) {
+        score[b][0]++;
+        score[a][2]++;
+    } else {
+        score[a][1]++;
+        score[b][1]++;
+    }
+}
+
+/**
+ * Writes a checkpoint of the chunks committed so far. The result file is
+ * synced first, so the checkpoint never refers to rows that are not on disk.
+ * Called with the output lock held.
+ *
+ * @param tournament The tournament
+ */
+static void save_checkpoint(TOURNAMENT *tournament) {
+    const uint64_t span = trace_begin();
+    const double started = now_seconds();
+    CHECKPOINT *cp = &tournament->checkpoint;
+    if (tournament->output) {
+        cp->output_offset = result_writer_sync(tournament->output, &cp->output_rows);
+    }
+    if (!checkpoint_save(tournament->checkpoint_path, cp)) {
+        warning(ERR_FILE);
+    }
+    tournament->checkpoint_time = now_seconds();
+    tournament->checkpoint_seconds += tournament->checkpoint_time - started;
+    tournament->checkpoint_saves++;
+    trace_end("checkpoint", span);
+}
+
+/**
+ * Commits a finished chunk or tile: hands its results to the result writer,
+ * adds them to the standings and marks it complete, all under one lock so
+ * a checkpoint always sees the three in agreement. Saves a checkpoint when
+ * the checkpoint interval has passed.
+ *
+ * @param tournament The tournament
+ * @param block Results of the chunk or tile
+ * @param count Number of results
+ * @param chunk Index of the chunk or tile within the run
+ */
+static void commit_chunk(TOURNAMENT *tournament, const MATCH_RESULT *block, int count, uint64_t chunk) {
+    const int n = tournament->roster->count;
+    int a = 0, b = 0;
+
+    pthread_mutex_lock(&tournament->output_lock);
+    for (int k = 0; k < count; k++) {
+        if (tournament->output) {
+            result_writer_add(tournament->output, block[k].matchup, &block[k].result);
+        }
+        // Chunks are runs of consecutive ids; a tile starts a new run on each row
+        if (k == 0 || block[k].matchup != block[k - 1].matchup + 1) {
+            matchup_pair(block[k].matchup, n, &a, &b);
+        }
+        record_score(tournament->score, a, b, block[k].result.winner);
+        if (++b == n) {
+            a++;
+            b = a + 1;
+        }
+    }
+    if (tournament->checkpoint_path) {
+        tournament->checkpoint.done[chunk / 8] |= (uint8_t) (1u << (chunk % 8));
+        if (now_seconds() - tournament->checkpoint_time >= tournament->checkpoint_interval) {
+            save_checkpoint(tournament);
+        }
+    }
+    pthread_mutex_unlock(&tournament->output_lock);
+}
+
+/**
+ * Returns the rows and columns of the armies in a tile. Tiles cover the
+ * upper triangle of the matchup matrix in blocks of tile x tile armies and
+ * are numbered like matchups, diagonal blocks included: (0,0), (0,1), ...,
+ * (0,k-1), (1,1), ...
+ *
+ * @param tournament The tournament
+ * @param tile Tile id
+ * @param rows Output first and end army of the first armies of the tile
+ * @param cols Output first and end army of the second armies of the tile
+ */
+static void tile_bounds(const TOURNAMENT *tournament, uint64_t tile, int rows[2], int cols[2]) {
+    const int n = tournament->roster->count;
+    int i, j;
+    matchup_pair(tile, tournament->tiles_per_side + 1, &i, &j);
+    rows[0] = i * tournament->tile;
+    cols[0] = (j - 1) * tournament->tile;
+    rows[1] = rows[0] + tournament->tile < n ? rows[0] + tournament->tile : n;
+    cols[1] = cols[0] + tournament->tile < n ? cols[0] + tournament->tile : n;
+}
+
+/**
+ * Returns the number of matchups in a tile.
+ *
+ * @param tournament The tournament
+ * @param tile Tile id
+ * @return Number of matchups
+ */
+static uint64_t tile_matchups(const TOURNAMENT *tournament, uint64_t tile) {
+    int rows[2], cols[2];
+    tile_bounds(tournament, tile, rows, cols);
+    if (rows[0] == cols[0]) {
+        return matchup_count(rows[1] - rows[0]);
+    }
+    return (uint64_t) (rows[1] - rows[0]) * (uint64_t) (cols[1] - cols[0]);
+}
+
+/**
+ * Simulates one matchup into a result slot, or answers it from the outcome
+ * database when it is there.
+ *
+ * @param worker The worker
+ * @param a Index of the first army
+ * @param b Index of the second army
+ * @param slot Output result, its matchup id already set
+ */
+static void play_matchup(WORKER *worker, int a, int b, MATCH_RESULT *slot) {
+    TOURNAMENT *tournament = worker->tournament;
+    const ROSTER *roster = tournament->roster;
+    const uint64_t span = trace_begin();
+    if (!lookup_outcome(tournament->db, tournament->limits, roster->armies[a], roster->armies[b], &slot->result)) {
+        void *tile = dashboard_claim(tournament->dashboard, worker->index, &worker->tile_cursor, a, b);
+        csimulate_observed(roster->armies[a], roster->armies[b], &combat_catalog, &slot->result,
+                           &worker->scratch, tournament->limits, tile ? dashboard_observe : NULL, tile);
+        store_outcome(tournament->db, tournament->limits, roster->armies[a], roster->armies[b], &slot->result);
+    }
+    trace_end("battle", span);
+}
+
+/**
+ * Simulates a chunk of consecutive matchup ids and commits it.
+ *
+ * @param worker The worker
+ * @param start First matchup id
+ * @param end End of the chunk
+ */
+static void play_chunk(WORKER *worker, uint64_t start, uint64_t end) {
+    TOURNAMENT *tournament = worker->tournament;
+    const int n = tournament->roster->count;
+    MATCH_RESULT *block = pool_get(&worker->results);
+    int a, b;
+    matchup_pair(start, n, &a, &b);
+    for (uint64_t id = start; id < end; id++) {
+        MATCH_RESULT *slot = &block[id - start];
+        slot->matchup = id;
+        play_matchup(worker, a, b, slot);
+        if (++b == n) {
+            a++;
+            b = a + 1;
+        }
+    }
+    arena_reset(&worker->scratch);
+
+    const uint64_t span = trace_begin();
+    commit_chunk(tournament, block, (int) (end - start), (start - tournament->first) / TOURNAMENT_CHUNK);
+    trace_end("commit_chunk", span);
+    dashboard_progress(tournament->dashboard, end - start);
+    pool_put(&worker->results, block);
+}
+
+/**
+ * Simulates every matchup of a tile and commits the tile as a whole, so the
+ * result file and checkpoints only ever hold complete tiles. A tile's
+ * armies are few enough to stay in cache while each is reused against the
+ * whole other side of the tile.
+ *
+ * @param worker The worker
+ * @param tile Tile id
+ */
+static void play_tile(WORKER *worker, uint64_t tile) {
+    TOURNAMENT *tournament = worker->tournament;
+    const int n = tournament->roster->count;
+    int rows[2], cols[2];
+    tile_bounds(tournament, tile, rows, cols);
+    MATCH_RESULT *block = pool_get(&worker->results);
+    int count = 0;
+    for (int a = rows[0]; a < rows[1]; a++) {
+        for (int b = a + 1 > cols[0] ? a + 1 : cols[0]; b < cols[1]; b++) {
+            MATCH_RESULT *slot = &block[count++];
+            slot->matchup = matchup_id(a, b, n);
+            play_matchup(worker, a, b, slot);
+        }
+        arena_reset(&worker->scratch);
+    }
+
+    const uint64_t span = trace_begin();
+    commit_chunk(tournament, block, count, tile - tournament->first);
+    trace_end("commit_chunk", span);
+    dashboard_progress(tournament->dashboard, count);
+    pool_put(&worker->results, block);
+}
+
+/**
+ * Worker thread: claims chunks of matchup ids, or tiles in tiled order,
+ * simulates them into a pooled result block and hands the block to the
+ * output stage. Matchups already in the outcome database are answered from
+ * it instead of being simulated, and chunks completed before a resumed run
+ * are skipped.
+ * When the dashboard is on, a battle is observed round by round only if one
+ * of the worker's tiles is waiting for a new frame.
+ *
+ * @param arg Pointer to the WORKER structure
+ * @return Always NULL
+ */
+static void *worker_main(void *arg) {
+    WORKER *worker = arg;
+    TOURNAMENT *tournament = worker->tournament;
+    const uint64_t step = tournament->tile ? 1 : TOURNAMENT_CHUNK;
+    trace_thread_name("tournament worker");
+    CACHE_COUNTERS counters;
+    cache_counters_open(&counters);
+
+    while (1) {
+        const uint64_t start = atomic_fetch_add(&tournament->next, step);
+        if (start >= tournament->total) break;
+        const uint64_t end = start + step < tournament->total ? start + step : tournament->total;
+        const uint64_t chunk = (start - tournament->first) / step;
+        if (tournament->done_before && (tournament->done_before[chunk / 8] >> (chunk % 8) & 1)) {
+            const uint64_t skipped = tournament->tile ? tile_matchups(tournament, start) : end - start;
+            atomic_fetch_add(&tournament->skipped, skipped);
+            dashboard_progress(tournament->dashboard, skipped);
+            continue;
+        }
+        if (tournament->tile) {
+            play_tile(worker, start);
+        } else {
+            play_chunk(worker, start, end);
+        }
+    }
+
+    pthread_mutex_lock(&tournament->output_lock);
+    cache_counters_close(&counters, &tournament->cache);
+    pthread_mutex_unlock(&tournament->output_lock);
+    return NULL;
+}
+
+/**
+ * Chooses the tile size for a roster: the largest whose armies, two sides
+ * of a tile for every thread, fill half of the last-level cache, within
+ * TOURNAMENT_TILE_MIN and TOURNAMENT_TILE_MAX (which bounds the result
+ * block a tile is committed from).
+ *
+ * @param roster The armies
+ * @param threads Number of worker threads
+ * @return Armies per tile side
+ */
+static int auto_tile(const ROSTER *roster, int threads) {
+    long cache = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (cache <= 0) cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (cache <= 0) cache = TOURNAMENT_DEFAULT_CACHE;
+    const double army = (double) roster->arena.in_use / roster->count + sizeof(CARMY *);
+    const double tile = (double) cache / 2 / threads / (2 * army);
+    if (tile < TOURNAMENT_TILE_MIN) return TOURNAMENT_TILE_MIN;
+    return tile > TOURNAMENT_TILE_MAX ? TOURNAMENT_TILE_MAX : (int) tile;
+}
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ *
+ * @return Seconds since an arbitrary fixed point
+ */
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/**
+ * Prints the per-army standings of a tournament.
+ *
+ * @param roster The armies
+ * @param score Per-army wins, draws and losses
+ * @param out Stream to print to
+ */
+void print_standings(const ROSTER *roster, uint32_t (*score)[3], FILE *out) {
+    fprintf(out, "%-6s %-16s %6s %8s %8s %8s %7s\n", "Army", "Leader", "Units", "Wins", "Draws", "Losses", "Win%");
+    for (int i = 0; i < roster->count; i++) {
+        const uint32_t played = score[i][0] + score[i][1] + score[i][2];
+        fprintf(out, "%-6d %-16.16s %6d %8u %8u %8u %6.1f%%\n", i + 1,
+                interned_name(roster->armies[i]->units[0].name), roster->armies[i]->count,
+                score[i][0], score[i][1], score[i][2], played ? 100.0 * score[i][0] / played : 0.0);
+    }
+}
+
+/**
+ * Sets up checkpointing for a run. With config->resume and an existing
+ * checkpoint, the standings and completed chunks are restored from it and
+ * the result file is reopened at the checkpointed size; the checkpoint must
+ * come from the same roster, item catalog, shard and battle limits.
+ *
+ * @param tournament The tournament (range, roster and score table set)
+ * @param config Tournament options
+ * @return Number of chunks restored from the checkpoint
+ */
+static uint64_t start_checkpoint(TOURNAMENT *tournament, const TOURNAMENT_CONFIG *config) {
+    const ROSTER *roster = tournament->roster;
+    uint64_t hash = roster_hash(roster);
+    if (config->limits.max_rounds > 0 || config->limits.decide_early) {
+        // Results depend on the limits; checkpoints without them keep the plain roster hash
+        hash = mix64(hash ^ mix64((uint64_t) config->limits.max_rounds << 1 | config->limits.decide_early));
+    }
+    if (tournament->tile) {
+        // Tiles are committed whole, so a checkpoint only resumes the same tiling
+        hash = mix64(hash ^ mix64((uint64_t) tournament->tile << 32));
+    }
+    const uint64_t version = catalog_version(&item_list);
+    const uint64_t chunks = tournament->tile ? tournament->total - tournament->first
+                                             : (tournament->total - tournament->first + TOURNAMENT_CHUNK - 1) /
+                                               TOURNAMENT_CHUNK;
+    CHECKPOINT *cp = &tournament->checkpoint;
+
+    uint64_t restored = 0;
+    if (config->resume && checkpoint_load(config->checkpoint_path, cp)) {
+        if (cp->roster_hash != hash || cp->catalog_version != version || cp->first != tournament->first ||
+            cp->total != tournament->total || cp->chunks != chunks || cp->armies != roster->count) {
+            error(ERR_BAD_VALUE);
+        }
+        for (uint64_t c = 0; c < chunks; c++) {
+            restored += cp->done[c / 8] >> (c % 8) & 1;
+        }
+        if (config->output_path && restored > 0 && cp->output_offset == 0) {
+            // The interrupted run wrote no result file, so earlier rows are missing
+            error(ERR_BAD_VALUE);
+        }
+        memcpy(tournament->score, cp->score, sizeof(*cp->score) * roster->count);
+        uint8_t *done_before = malloc(checkpoint_bitmap_size(chunks));
+        if (!done_before) {
+            error(ERR_MEMORY);
+        }
+        memcpy(done_before, cp->done, checkpoint_bitmap_size(chunks));
+        tournament->done_before = done_before;
+        free(cp->score);
+    } else {
+        cp->roster_hash = hash;
+        cp->catalog_version = version;
+        cp->first = tournament->first;
+        cp->total = tournament->total;
+        cp->chunks = chunks;
+        cp->armies = roster->count;
+        cp->done = calloc(checkpoint_bitmap_size(chunks) ? checkpoint_bitmap_size(chunks) : 1, 1);
+        if (!cp->done) {
+            error(ERR_MEMORY);
+        }
+    }
+    // The checkpoint shares the live score table; it is only read under the output lock
+    cp->score = tournament->score;
+    tournament->checkpoint_path = config->checkpoint_path;
+    tournament->checkpoint_interval = config->checkpoint_interval;
+    tournament->checkpoint_time = now_seconds();
+    return restored;
+}
+
+/**
+ * Runs a round-robin tournament over every army of a roster file.
+ * Matchups are distributed in chunks over a pool of worker threads; each
+ * worker simulates with the compact engine using its own arena for battle
+ * scratch memory (reset after each chunk) and a pool of result blocks.
+ * With config->watch set, the calling thread renders a live dashboard of the
+ * running battles; ncurses must already be initialized.
+ * With config->shards > 1 only shard config->shard of the matchup ids is
+ * played: the ids are split into that many contiguous ranges, so shards can
+ * run as separate processes and be combined with merge_results().
+ * With config->checkpoint_path set, the standings, completed chunks and
+ * result file size are checkpointed every config->checkpoint_interval
+ * seconds, and config->resume continues an interrupted run from there.
+ * With config->tile set, workers take square tiles of config->tile armies
+ * per side (at most TOURNAMENT_TILE_MAX) instead of chunks of consecutive
+ * ids; a negative value sizes tiles from the cache (see auto_tile()).
+ * Results are written a tile at a time, so rows are in tile order, and
+ * shards split the tiles.
+ *
+ * @param config Tournament options
+ * @return 0 on success
+ */
+int run_tournament(const TOURNAMENT_CONFIG *config) {
+    FILE *file = fopen(config->roster_path, "r");
+    if (!file) {
+        error(ERR_FILE);
+    }
+    ROSTER roster;
+    load_roster(file, &roster);
+    fclose(file);
+    if (roster.count < 2) {
+        error(ERR_UNIT_COUNT);
+    }
+
+    int threads = config->threads;
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    TOURNAMENT tournament = {0};
+    tournament.roster = &roster;
+    tournament.limits = &config->limits;
+    if (config->tile != 0) {
+        tournament.tile = config->tile > 0 ? config->tile : auto_tile(&roster, threads);
+        if (tournament.tile > TOURNAMENT_TILE_MAX) tournament.tile = TOURNAMENT_TILE_MAX;
+        tournament.tiles_per_side = (roster.count + tournament.tile - 1) / tournament.tile;
+    }
+    // A shard owns one contiguous range of matchup ids, or of tiles in tiled
+    // order; tournament.total is its end
+    const uint64_t matchups = matchup_count(roster.count);
+    const uint64_t units = tournament.tile ? matchup_count(tournament.tiles_per_side + 1) : matchups;
+    const int shards = config->shards > 0 ? config->shards : 1;
+    tournament.first = units * (uint64_t) config->shard / (uint64_t) shards;
+    tournament.total = units * (uint64_t) (config->shard + 1) / (uint64_t) shards;
+    uint64_t covered = tournament.total - tournament.first;
+    if (tournament.tile) {
+        covered = 0;
+        for (uint64_t tile = tournament.first; tile < tournament.total; tile++) {
+            covered += tile_matchups(&tournament, tile);
+        }
+    }
+    atomic_init(&tournament.next, tournament.first);
+    atomic_init(&tournament.skipped, 0);
+    pthread_mutex_init(&tournament.output_lock, NULL);
+    if (config->db_path) {
+        tournament.db = outcome_db_open(config->db_path, catalog_version(&item_list),
+                                        config->db_slots ? config->db_slots : OUTCOME_DB_DEFAULT_SLOTS, true);
+    }
+    if (config->watch) {
+        tournament.dashboard = dashboard_new(DASHBOARD_TILES, threads, covered);
+    }
+    tournament.score = calloc(roster.count, sizeof(*tournament.score));
+    if (!tournament.score) {
+        error(ERR_MEMORY);
+    }
+    uint64_t restored = 0;
+    if (config->checkpoint_path) {
+        restored = start_checkpoint(&tournament, config);
+    }
+    if (config->output_path) {
+        tournament.output = restored > 0
+                          ? result_writer_resume(config->output_path, config->format, roster.count,
+                                                 tournament.checkpoint.output_offset, tournament.checkpoint.output_rows)
+                          : result_writer_open(config->output_path, config->format, roster.count);
+    }
+
+    WORKER *workers = calloc(threads, sizeof(WORKER));
+    if (!workers) {
+        error(ERR_MEMORY);
+    }
+
+    const double started = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        WORKER *worker = &workers[t];
+        worker->tournament = &tournament;
+        worker->index = t;
+        arena_init(&worker->scratch, 0);
+        arena_init(&worker->blocks, 0);
+        pool_init(&worker->results, &worker->blocks,
+                  sizeof(MATCH_RESULT) * (tournament.tile ? tournament.tile * tournament.tile : TOURNAMENT_CHUNK));
+        pthread_create(&worker->thread, NULL, worker_main, worker);
+    }
+
+    if (tournament.dashboard) {
+        dashboard_watch(tournament.dashboard);
+    }
+
+    ALLOC_STATS stats = {0};
+    alloc_stats_add(&stats, &roster.arena, NULL);
+    for (int t = 0; t < threads; t++) {
+        WORKER *worker = &workers[t];
+        pthread_join(worker->thread, NULL);
+        alloc_stats_add(&stats, &worker->scratch, NULL);
+        alloc_stats_add(&stats, &worker->blocks, &worker->results);
+        arena_free(&worker->scratch);
+        arena_free(&worker->blocks);
+    }
+    const double elapsed = now_seconds() - started;
+
+    if (tournament.checkpoint_path) {
+        save_checkpoint(&tournament);
+        tournament.checkpoint.score = NULL;
+        checkpoint_free(&tournament.checkpoint);
+        free((void *) tournament.done_before);
+    }
+    if (tournament.output) {
+        result_writer_close(tournament.output);
+    }
+    if (tournament.dashboard) {
+        dashboard_free(tournament.dashboard);
+        cleanup_gui();
+    }
+
+    const uint64_t battles = covered - atomic_load(&tournament.skipped);
+    print_standings(&roster, tournament.score, stdout);
+    if (shards > 1) {
+        printf("\nShard %d/%d: %s %llu to %llu of %llu\n", config->shard, shards,
+               tournament.tile ? "tiles" : "matchups", (unsigned long long) tournament.first,
+               (unsigned long long) tournament.total - 1, (unsigned long long) units);
+    }
+    if (restored > 0) {
+        printf("\nResumed from checkpoint: %llu of %llu %s already complete\n", (unsigned long long) restored,
+               (unsigned long long) tournament.checkpoint.chunks, tournament.tile ? "tiles" : "chunks");
+    }
+    if (tournament.tile) {
+        printf("\nTiled order: %d x %d armies per tile, %llu tiles\n", tournament.tile, tournament.tile,
+               (unsigned long long) (tournament.total - tournament.first));
+    } else {
+        printf("\nRow order: chunks of %d consecutive matchups\n", TOURNAMENT_CHUNK);
+    }
+    printf("%llu battles on %d threads in %.3f s (%.0f battles/s)\n",
+           (unsigned long long) battles, threads, elapsed, elapsed > 0 ? battles / elapsed : 0.0);
+    if (tournament.checkpoint_saves > 0) {
+        printf("Checkpoints: %d saved in %.3f s (%.2f%% of the run)\n", tournament.checkpoint_saves,
+               tournament.checkpoint_seconds, elapsed > 0 ? 100.0 * tournament.checkpoint_seconds / elapsed : 0.0);
+    }
+    print_cache_stats(&tournament.cache, battles, stdout);
+    print_alloc_stats(&stats, stdout);
+    if (tournament.db) {
+        outcome_db_report(tournament.db, stdout);
+        outcome_db_close(tournament.db);
+    }
+
+    free(tournament.score);
+    free(workers);
+    free_roster(&roster);
+    return 0;
+}
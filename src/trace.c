@@ -0,0 +1,218 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/battle-arena.h"
+
+#define TRACE_CHUNK_EVENTS 4096
+#define TRACE_MAX_EVENTS (1 << 20)
+
+/**
+ * One completed span. Names are string literals and are stored by pointer.
+ */
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+} TRACE_EVENT;
+
+/**
+ * A fixed-size run of events; a thread's buffer is a list of these.
+ */
+typedef struct trace_chunk {
+    struct trace_chunk *next;
+    int used;
+    TRACE_EVENT events[TRACE_CHUNK_EVENTS];
+} TRACE_CHUNK;
+
+/**
+ * Events recorded by one thread. Only the owning thread appends to it, so
+ * recording takes no lock; buffers are only read when the trace is written.
+ */
+typedef struct trace_buffer {
+    struct trace_buffer *next;
+    int tid;
+    const char *name;
+    TRACE_CHUNK *first;
+    TRACE_CHUNK *last;
+    size_t count;
+    size_t dropped;
+} TRACE_BUFFER;
+
+static bool enabled = false;
+static char *trace_path = NULL;
+static uint64_t origin;
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static TRACE_BUFFER *buffers = NULL;
+static int next_tid = 1;
+static _Thread_local TRACE_BUFFER *local = NULL;
+
+/**
+ * Returns a monotonic timestamp in nanoseconds.
+ *
+ * @return Nanoseconds since an arbitrary fixed point
+ */
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Returns the calling thread's buffer, registering a new one on first use.
+ *
+ * @return The buffer
+ */
+static TRACE_BUFFER *thread_buffer(void) {
+    if (local) return local;
+
+    local = calloc(1, sizeof(TRACE_BUFFER));
+    if (!local) {
+        error(ERR_MEMORY);
+    }
+    pthread_mutex_lock(&registry_lock);
+    local->tid = next_tid++;
+    local->next = buffers;
+    buffers = local;
+    pthread_mutex_unlock(&registry_lock);
+    return local;
+}
+
+/**
+ * Writes a string as a JSON string literal.
+ *
+ * @param out Destination stream
+ * @param s The string
+ */
+static void write_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+/**
+ * Writes every recorded event to the trace file and stops tracing.
+ * Registered with atexit() by trace_open(), so a trace is also produced when
+ * the program leaves through error().
+ */
+void trace_close(void) {
+    if (!enabled) return;
+    enabled = false;
+
+    FILE *out = fopen(trace_path, "w");
+    if (!out) {
+        warning(ERR_FILE);
+        return;
+    }
+
+    pthread_mutex_lock(&registry_lock);
+    size_t dropped = 0;
+    bool first = true;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (TRACE_BUFFER *buffer = buffers; buffer; buffer = buffer->next) {
+        if (buffer->name) {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                    first ? "" : ",\n", buffer->tid);
+            write_json_string(out, buffer->name);
+            fprintf(out, "}}");
+            first = false;
+        }
+        for (TRACE_CHUNK *chunk = buffer->first; chunk; chunk = chunk->next) {
+            for (int i = 0; i < chunk->used; i++) {
+                const TRACE_EVENT *event = &chunk->events[i];
+                fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+                write_json_string(out, event->name);
+                fprintf(out, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->tid,
+                        (double) (event->start - origin) / 1000.0, (double) (event->end - event->start) / 1000.0);
+                first = false;
+            }
+        }
+        dropped += buffer->dropped;
+    }
+    fprintf(out, "\n]}\n");
+    pthread_mutex_unlock(&registry_lock);
+    fclose(out);
+
+    if (dropped > 0) {
+        fprintf(stderr, "Trace: %zu events dropped (limit %d per thread)\n", dropped, TRACE_MAX_EVENTS);
+    }
+}
+
+/**
+ * Starts recording spans. The trace is written in Chrome trace-event format
+ * when the program exits (or when trace_close() is called).
+ *
+ * @param path Output path of the trace JSON file
+ */
+void trace_open(const char *path) {
+    trace_path = strdup(path);
+    if (!trace_path) {
+        error(ERR_MEMORY);
+    }
+    origin = now_ns();
+    enabled = true;
+    atexit(trace_close);
+}
+
+/**
+ * Names the calling thread in the trace. Ignored while tracing is off.
+ *
+ * @param name Thread name (string literal)
+ */
+void trace_thread_name(const char *name) {
+    if (!enabled) return;
+    thread_buffer()->name = name;
+}
+
+/**
+ * Marks the start of a span.
+ *
+ * @return Start timestamp to pass to trace_end(), or 0 while tracing is off
+ */
+uint64_t trace_begin(void) {
+    return enabled ? now_ns() : 0;
+}
+
+/**
+ * Records a span that started at `start` and ends now, in the calling
+ * thread's buffer. Spans beyond TRACE_MAX_EVENTS per thread are counted
+ * but not stored.
+ *
+ * @param name Span name (string literal)
+ * @param start Value returned by trace_begin(); 0 records nothing
+ */
+void trace_end(const char *name, uint64_t start) {
+    if (!start || !enabled) return;
+    const uint64_t end = now_ns();
+
+    TRACE_BUFFER *buffer = thread_buffer();
+    if (buffer->count >= TRACE_MAX_EVENTS) {
+        buffer->dropped++;
+        return;
+    }
+
+    TRACE_CHUNK *chunk = buffer->last;
+    if (!chunk || chunk->used == TRACE_CHUNK_EVENTS) {
+        chunk = malloc(sizeof(TRACE_CHUNK));
+        if (!chunk) {
+            error(ERR_MEMORY);
+        }
+        chunk->next = NULL;
+        chunk->used = 0;
+        if (buffer->last) {
+            buffer->last->next = chunk;
+        } else {
+            buffer->first = chunk;
+        }
+        buffer->last = chunk;
+    }
+
+    chunk->events[chunk->used++] = (TRACE_EVENT) {name, start, end};
+    buffer->count++;
+}
@@ -0,0 +1,713 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/battle-arena.h"
+
+#define VERIFY_CHUNK 1024
+#define VERIFY_LOADOUTS (NUMBER_OF_ITEMS * (NUMBER_OF_ITEMS + 1))
+#define VERIFY_CAPS 64
+
+/**
+ * An engine that can be checked against the reference, one round at a time.
+ * Rounds follow the conventions of cbattle_round(). An engine without a
+ * round function checks whole battles instead (see verify_decision()).
+ */
+typedef struct {
+    const char *name;
+    void *(*open)(void);
+    int (*round)(void *context, CUNIT **army1, int *count1, CUNIT **army2, int *count2);
+    void (*close)(void *context);
+} ENGINE;
+
+/**
+ * State shared by the threads of a verification run.
+ */
+typedef struct {
+    const VERIFY_CONFIG *config;
+    const ENGINE *engine;
+    ARMY *recorded;
+    bool *fits;
+    int armies;
+    uint8_t loadouts[VERIFY_LOADOUTS][2];
+    int loadout_count;
+    uint64_t total;
+    atomic_uint_fast64_t next;
+    atomic_uint_fast64_t first_failure;
+    atomic_uint_fast64_t scenarios;
+    atomic_uint_fast64_t rounds;
+    atomic_uint_fast64_t skipped;
+} VERIFY;
+
+/**
+ * Per-thread buffers of the early decision check.
+ */
+typedef struct {
+    CARMY *army1;
+    CARMY *army2;
+} DECISION;
+
+/**
+ * Per-thread state of a verification run.
+ */
+typedef struct {
+    VERIFY *verify;
+    pthread_t thread;
+    void *context;
+} VERIFIER;
+
+/**
+ * Runs one round of the compact engine.
+ *
+ * @param context Unused
+ * @param army1 In/out pointer to the units of the first army
+ * @param count1 In/out number of units of the first army
+ * @param army2 In/out pointer to the units of the second army
+ * @param count2 In/out number of units of the second army
+ * @return Same result codes as battle_round()
+ */
+static int compact_round(void *context, CUNIT **army1, int *count1, CUNIT **army2, int *count2) {
+    (void) context;
+    return cbattle_round(army1, count1, army2, count2, &combat_catalog);
+}
+
+/**
+ * Creates the two-thread engine pool a verifier runs the parallel engine on.
+ *
+ * @return The pool
+ */
+static void *parallel_open(void) {
+    return engine_pool_new(2, &combat_catalog);
+}
+
+/**
+ * Runs one round of the parallel engine. Every round goes through the pool,
+ * however small, so the parallel attack phase is what gets checked.
+ *
+ * @param context The verifier's engine pool
+ * @param army1 In/out pointer to the units of the first army
+ * @param count1 In/out number of units of the first army
+ * @param army2 In/out pointer to the units of the second army
+ * @param count2 In/out number of units of the second army
+ * @return Same result codes as battle_round()
+ */
+static int parallel_round(void *context, CUNIT **army1, int *count1, CUNIT **army2, int *count2) {
+    return cparallel_round(context, army1, count1, army2, count2, &combat_catalog, 0);
+}
+
+/**
+ * Frees a verifier's engine pool.
+ *
+ * @param context The pool
+ */
+static void parallel_close(void *context) {
+    engine_pool_free(context);
+}
+
+/**
+ * Allocates a verifier's compact armies for the early decision check.
+ *
+ * @return The DECISION buffers
+ */
+static void *decision_open(void) {
+    DECISION *decision = malloc(sizeof(DECISION));
+    if (!decision) {
+        error(ERR_MEMORY);
+    }
+    decision->army1 = carmy_new(MAX_ARMY);
+    decision->army2 = carmy_new(MAX_ARMY);
+    return decision;
+}
+
+/**
+ * Frees a verifier's early decision buffers.
+ *
+ * @param context The DECISION buffers
+ */
+static void decision_close(void *context) {
+    DECISION *decision = context;
+    free(decision->army1);
+    free(decision->army2);
+    free(decision);
+}
+
+static const ENGINE engines[] = {
+    {"compact", NULL, compact_round, NULL},
+    {"parallel", parallel_open, parallel_round, parallel_close},
+    {"decide", decision_open, NULL, decision_close},
+};
+
+/**
+ * Returns the checksum term of one unit. Positions are counted from the back
+ * of the army, which does not change when units in front of it die, so a
+ * round only changes the terms of the units it can reach.
+ *
+ * @param item1 Id of the first item, or CITEM_NONE
+ * @param item2 Id of the second item, or CITEM_NONE
+ * @param hp Hit points
+ * @param from_back Position counted from the last unit (0 for the last one)
+ * @return 64-bit term
+ */
+uint64_t unit_checksum(int item1, int item2, int hp, int from_back) {
+    const uint64_t packed = (uint64_t) (item1 & 0xFF) | (uint64_t) (item2 & 0xFF) << 8 |
+                            (uint64_t) (uint32_t) hp << 16;
+    return mix64(packed ^ (uint64_t) from_back * 0x9E3779B97F4A7C15ull);
+}
+
+/**
+ * Computes the checksum of an army's state (order, items and HP of its units)
+ * from scratch, as the sum of its unit terms.
+ *
+ * @param units The units, front first
+ * @param count Number of units
+ * @return 64-bit checksum
+ */
+uint64_t army_checksum(const CUNIT *units, int count) {
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += unit_checksum(units[i].item1, units[i].item2, units[i].hp, count - 1 - i);
+    }
+    return sum;
+}
+
+/**
+ * Updates an army checksum after a round in O(front_count) instead of
+ * rehashing the army. Valid for engines that only change and remove units
+ * among the first front_count, like cbattle_round() with a window of the
+ * catalog's widest radius plus one.
+ *
+ * @param sum Checksum before the round
+ * @param front Copy of the first front_count units taken before the round
+ * @param front_count Number of units copied (at most count_before)
+ * @param count_before Number of units before the round
+ * @param units The units after the round
+ * @param count Number of units after the round
+ * @return Checksum after the round
+ */
+uint64_t army_checksum_update(uint64_t sum, const CUNIT *front, int front_count, int count_before,
+                              const CUNIT *units, int count) {
+    for (int j = 0; j < front_count; j++) {
+        sum -= unit_checksum(front[j].item1, front[j].item2, front[j].hp, count_before - 1 - j);
+    }
+    const int survivors = front_count - (count_before - count);
+    for (int j = 0; j < survivors; j++) {
+        sum += unit_checksum(units[j].item1, units[j].item2, units[j].hp, count - 1 - j);
+    }
+    return sum;
+}
+
+/**
+ * Combines the checksums of both armies into the state checksum of a round.
+ *
+ * @param army1 Checksum of the first army
+ * @param army2 Checksum of the second army
+ * @return 64-bit state checksum
+ */
+uint64_t round_checksum(uint64_t army1, uint64_t army2) {
+    return mix64(army1 ^ mix64(army2 + 1));
+}
+
+/**
+ * Returns the catalog id of an item of the global item list.
+ *
+ * @param item The item, or NULL
+ * @return Index into item_list, or CITEM_NONE
+ */
+static int item_id(const ITEM *item) {
+    return item ? (int) (item - item_list.items) : CITEM_NONE;
+}
+
+/**
+ * Computes the checksum of an army of the reference engine.
+ *
+ * @param army The army
+ * @return Same checksum army_checksum() gives for its compact form
+ */
+static uint64_t reference_checksum(const ARMY *army) {
+    uint64_t sum = 0;
+    for (int i = 0; i <= army->top; i++) {
+        const UNIT *unit = &army->units[i];
+        sum += unit_checksum(item_id(unit->item1), item_id(unit->item2), unit->hp, army->top - i);
+    }
+    return sum;
+}
+
+/**
+ * Copies an army into compact units without interning names.
+ *
+ * @param army The army
+ * @param units Destination with room for army->top + 1 units
+ * @return Number of units
+ */
+static int to_units(const ARMY *army, CUNIT *units) {
+    for (int i = 0; i <= army->top; i++) {
+        units[i].item1 = (uint8_t) item_id(army->units[i].item1);
+        units[i].item2 = (uint8_t) item_id(army->units[i].item2);
+        units[i].hp = (int16_t) army->units[i].hp;
+        units[i].name = 0;
+    }
+    return army->top + 1;
+}
+
+/**
+ * Prints the units of an army of the reference engine.
+ *
+ * @param out Stream to print to
+ * @param label Line prefix
+ * @param army The army
+ */
+static void print_reference(FILE *out, const char *label, const ARMY *army) {
+    fprintf(out, "  %s", label);
+    for (int i = 0; i <= army->top; i++) {
+        const UNIT *unit = &army->units[i];
+        fprintf(out, " [%s%s%s %d]", unit->item1 ? unit->item1->name : "-", unit->item2 ? "+" : "",
+                unit->item2 ? unit->item2->name : "", unit->hp);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Prints compact units.
+ *
+ * @param out Stream to print to
+ * @param label Line prefix
+ * @param units The units
+ * @param count Number of units
+ */
+static void print_units(FILE *out, const char *label, const CUNIT *units, int count) {
+    fprintf(out, "  %s", label);
+    for (int i = 0; i < count; i++) {
+        const CUNIT *unit = &units[i];
+        fprintf(out, " [%s%s%s %d]", unit->item1 != CITEM_NONE ? item_list.items[unit->item1].name : "-",
+                unit->item2 != CITEM_NONE ? "+" : "",
+                unit->item2 != CITEM_NONE ? item_list.items[unit->item2].name : "", unit->hp);
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Prints an army in roster format, so a scenario can be replayed with --verify.
+ *
+ * @param out Stream to print to
+ * @param army The army
+ * @param side 1 or 2, used in the unit names
+ */
+static void print_roster_army(FILE *out, const ARMY *army, int side) {
+    for (int i = 0; i <= army->top; i++) {
+        const UNIT *unit = &army->units[i];
+        fprintf(out, "A%dU%d: %s", side, i, unit->item1->name);
+        if (unit->item2) {
+            fprintf(out, ", %s", unit->item2->name);
+        }
+        fprintf(out, "\n");
+    }
+    fprintf(out, "\n");
+}
+
+/**
+ * Fights one scenario with the reference battle_round() and with an engine
+ * side by side, comparing the result code and the state checksum after
+ * every round. The engine's checksum is maintained incrementally over the
+ * units a round can reach and the reference's is computed from scratch, so
+ * both ways of computing it are checked as well. The engine's armies are
+ * also rehashed in full every round: a write outside the window would
+ * otherwise go unnoticed until the unit reaches the front.
+ *
+ * @param engine The engine
+ * @param context The engine's per-thread context
+ * @param army1 The first army (at most MAX_ARMY units)
+ * @param army2 The second army (at most MAX_ARMY units)
+ * @param rounds Output for the number of rounds compared
+ * @param report Stream to describe a divergence on (may be NULL)
+ * @return The first round whose state differs, or 0 if the engines agree
+ */
+static int verify_scenario(const ENGINE *engine, void *context, const ARMY *army1, const ARMY *army2, int *rounds,
+                           FILE *report) {
+    ARMY r1 = *army1;
+    ARMY r2 = *army2;
+    CUNIT units[2 * MAX_ARMY];
+    CUNIT front1[MAX_ARMY];
+    CUNIT front2[MAX_ARMY];
+    CUNIT *a = units;
+    int count1 = to_units(army1, a);
+    CUNIT *b = units + count1;
+    int count2 = to_units(army2, b);
+    uint64_t sum1 = army_checksum(a, count1);
+    uint64_t sum2 = army_checksum(b, count2);
+    const int window = combat_catalog.max_radius + 1;
+
+    int round = 0;
+    int expected = -1;
+    while (expected == -1) {
+        round++;
+        const int front_count1 = count1 < window ? count1 : window;
+        const int front_count2 = count2 < window ? count2 : window;
+        const int before1 = count1;
+        const int before2 = count2;
+        memcpy(front1, a, sizeof(CUNIT) * front_count1);
+        memcpy(front2, b, sizeof(CUNIT) * front_count2);
+
+        expected = battle_round(&r1, &r2);
+        const int actual = engine->round(context, &a, &count1, &b, &count2);
+        sum1 = army_checksum_update(sum1, front1, front_count1, before1, a, count1);
+        sum2 = army_checksum_update(sum2, front2, front_count2, before2, b, count2);
+
+        const uint64_t want = round_checksum(reference_checksum(&r1), reference_checksum(&r2));
+        const uint64_t got = round_checksum(sum1, sum2);
+        const uint64_t full = round_checksum(army_checksum(a, count1), army_checksum(b, count2));
+        if (want != got || got != full || expected != actual) {
+            if (report) {
+                fprintf(report, "First divergence in round %d\n", round);
+                fprintf(report, "  result     reference %2d   %-8s %2d\n", expected, engine->name, actual);
+                fprintf(report, "  checksum   reference %016llx   %-8s %016llx (full %016llx)\n",
+                        (unsigned long long) want, engine->name, (unsigned long long) got, (unsigned long long) full);
+                print_reference(report, "reference army 1:", &r1);
+                print_reference(report, "reference army 2:", &r2);
+                print_units(report, "engine    army 1:", a, count1);
+                print_units(report, "engine    army 2:", b, count2);
+            }
+            *rounds = round;
+            return round;
+        }
+    }
+    *rounds = round;
+    return 0;
+}
+
+/**
+ * Ignores the state of a battle. Observed battles take other paths through
+ * csimulate_observed() (no duel table shortcut), which the decision check
+ * covers as well.
+ *
+ * @param context Unused
+ * @param round Unused
+ * @param winner Unused
+ * @param a Unused
+ * @param count1 Unused
+ * @param b Unused
+ * @param count2 Unused
+ */
+static void ignore_round(void *context, int round, int winner, const CUNIT *a, int count1, const CUNIT *b,
+                         int count2) {
+    (void) context;
+    (void) round;
+    (void) winner;
+    (void) a;
+    (void) count1;
+    (void) b;
+    (void) count2;
+}
+
+/**
+ * Fights one scenario under a round cap with and without decide_early, the
+ * latter both unobserved and observed, and compares the winners: an early
+ * decision must never turn a timeout into a victory, or change the winner.
+ * Without a --max-rounds cap, scenario k is capped at 1 + k % VERIFY_CAPS
+ * rounds, so battles end on both sides of it.
+ *
+ * @param verify The run
+ * @param decision The verifier's buffers
+ * @param k Scenario index
+ * @param army1 The first army (at most MAX_ARMY units)
+ * @param army2 The second army (at most MAX_ARMY units)
+ * @param rounds Output for the number of rounds of the capped battle
+ * @param report Stream to describe a divergence on (may be NULL)
+ * @return The round the battle was decided in if the winners differ, or 0
+ */
+static int verify_decision(const VERIFY *verify, DECISION *decision, uint64_t k, const ARMY *army1,
+                           const ARMY *army2, int *rounds, FILE *report) {
+    decision->army1->count = (uint16_t) to_units(army1, decision->army1->units);
+    decision->army2->count = (uint16_t) to_units(army2, decision->army2->units);
+    const int cap = verify->config->max_rounds > 0 ? verify->config->max_rounds : 1 + (int) (k % VERIFY_CAPS);
+    const BATTLE_LIMITS capped = {cap, false};
+    const BATTLE_LIMITS decided = {cap, true};
+
+    CRESULT want, got, watched;
+    csimulate_observed(decision->army1, decision->army2, &combat_catalog, &want, NULL, &capped, NULL, NULL);
+    csimulate_observed(decision->army1, decision->army2, &combat_catalog, &got, NULL, &decided, NULL, NULL);
+    csimulate_observed(decision->army1, decision->army2, &combat_catalog, &watched, NULL, &decided, ignore_round,
+                       NULL);
+    *rounds = want.rounds;
+    if (want.winner == got.winner && want.winner == watched.winner) return 0;
+
+    if (report) {
+        fprintf(report, "Capped at %d rounds: result %d after %d rounds, decided %d after %d rounds, "
+                "observed %d after %d rounds\n", cap, want.winner, want.rounds, got.winner, got.rounds,
+                watched.winner, watched.rounds);
+    }
+    if (want.winner != got.winner) return got.rounds > 0 ? got.rounds : 1;
+    return watched.rounds > 0 ? watched.rounds : 1;
+}
+
+/**
+ * Checks one scenario with the engine of the run.
+ *
+ * @param verify The run
+ * @param context The engine's per-thread context
+ * @param k Scenario index
+ * @param army1 The first army (at most MAX_ARMY units)
+ * @param army2 The second army (at most MAX_ARMY units)
+ * @param rounds Output for the number of rounds compared
+ * @param report Stream to describe a divergence on (may be NULL)
+ * @return Nonzero if the scenario diverges
+ */
+static int check_scenario(const VERIFY *verify, void *context, uint64_t k, const ARMY *army1, const ARMY *army2,
+                          int *rounds, FILE *report) {
+    if (!verify->engine->round) {
+        return verify_decision(verify, context, k, army1, army2, rounds, report);
+    }
+    return verify_scenario(verify->engine, context, army1, army2, rounds, report);
+}
+
+/**
+ * Returns a random value below a bound.
+ *
+ * @param state SplitMix64 stream state
+ * @param bound Exclusive upper bound
+ * @return Value in [0, bound)
+ */
+static int random_below(uint64_t *state, int bound) {
+    *state += 0x9E3779B97F4A7C15ull;
+    return (int) (mix64(*state) % (uint64_t) bound);
+}
+
+/**
+ * Generates one random army: 1 to MAX_ARMY units at full HP with random
+ * item combinations that pass check_slots(). Full HP keeps every scenario
+ * expressible in roster format; battles reach the other states anyway.
+ *
+ * @param verify The run
+ * @param state Random stream
+ * @param army Destination
+ */
+static void generate_army(const VERIFY *verify, uint64_t *state, ARMY *army) {
+    init_army(army);
+    const int count = 1 + random_below(state, MAX_ARMY);
+    for (int i = 0; i < count; i++) {
+        const uint8_t *loadout = verify->loadouts[random_below(state, verify->loadout_count)];
+        UNIT unit = {0};
+        unit.item1 = &item_list.items[loadout[0]];
+        unit.item2 = loadout[1] != CITEM_NONE ? &item_list.items[loadout[1]] : NULL;
+        unit.hp = UNIT_HP;
+        push(army, unit);
+    }
+}
+
+/**
+ * Produces scenario k of the run: a matchup of the recorded roster, or two
+ * armies generated from the seed and k alone, so every scenario can be
+ * reproduced regardless of which thread ran it.
+ *
+ * @param verify The run
+ * @param k Scenario index
+ * @param army1 Destination for the first army
+ * @param army2 Destination for the second army
+ * @return false if the scenario cannot run on the reference engine
+ */
+static bool load_scenario(const VERIFY *verify, uint64_t k, ARMY *army1, ARMY *army2) {
+    if (verify->recorded) {
+        int a, b;
+        matchup_pair(k, verify->armies, &a, &b);
+        if (!verify->fits[a] || !verify->fits[b]) return false;
+        *army1 = verify->recorded[a];
+        *army2 = verify->recorded[b];
+        return true;
+    }
+
+    uint64_t state = mix64(verify->config->seed ^ mix64(k + 1));
+    generate_army(verify, &state, army1);
+    generate_army(verify, &state, army2);
+    return true;
+}
+
+/**
+ * Verifier thread: checks chunks of scenarios until all are done or a
+ * divergence at a lower index makes the rest unnecessary.
+ *
+ * @param arg The thread's VERIFIER
+ * @return Always NULL
+ */
+static void *verifier_main(void *arg) {
+    VERIFIER *verifier = arg;
+    VERIFY *verify = verifier->verify;
+    uint64_t scenarios = 0, rounds = 0, skipped = 0;
+
+    while (1) {
+        const uint64_t first = atomic_fetch_add(&verify->next, VERIFY_CHUNK);
+        if (first >= verify->total || first >= atomic_load(&verify->first_failure)) break;
+        const uint64_t last = first + VERIFY_CHUNK < verify->total ? first + VERIFY_CHUNK : verify->total;
+
+        for (uint64_t k = first; k < last; k++) {
+            ARMY army1, army2;
+            if (!load_scenario(verify, k, &army1, &army2)) {
+                skipped++;
+                continue;
+            }
+            int fought;
+            const int diverged = check_scenario(verify, verifier->context, k, &army1, &army2, &fought, NULL);
+            scenarios++;
+            rounds += (uint64_t) fought;
+            if (diverged) {
+                uint_fast64_t seen = atomic_load(&verify->first_failure);
+                while (k < seen && !atomic_compare_exchange_weak(&verify->first_failure, &seen, k)) {
+                }
+                break;
+            }
+        }
+    }
+
+    atomic_fetch_add(&verify->scenarios, scenarios);
+    atomic_fetch_add(&verify->rounds, rounds);
+    atomic_fetch_add(&verify->skipped, skipped);
+    return NULL;
+}
+
+/**
+ * Lists the item combinations generated units may carry.
+ *
+ * @param verify The run
+ */
+static void build_loadouts(VERIFY *verify) {
+    for (int i = 0; i < item_list.count; i++) {
+        for (int j = -1; j < item_list.count; j++) {
+            UNIT unit = {0};
+            unit.item1 = &item_list.items[i];
+            unit.item2 = j >= 0 ? &item_list.items[j] : NULL;
+            if (!check_slots(unit)) continue;
+            verify->loadouts[verify->loadout_count][0] = (uint8_t) i;
+            verify->loadouts[verify->loadout_count][1] = j >= 0 ? (uint8_t) j : CITEM_NONE;
+            verify->loadout_count++;
+        }
+    }
+    if (verify->loadout_count == 0) {
+        error(ERR_ITEM_COUNT);
+    }
+}
+
+/**
+ * Checks an alternative engine against the reference battle_round() round
+ * by round, on every matchup of a recorded roster or on scenarios generated
+ * from a seed, using all threads. Stops at the lowest-numbered diverging
+ * scenario, describes its first diverging round and prints the scenario in
+ * roster format for replay.
+ *
+ * @param config Scenario source, engine, seed and thread count
+ * @return 0 if no scenario diverged, 1 otherwise
+ */
+int run_verify(const VERIFY_CONFIG *config) {
+    const ENGINE *engine = NULL;
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        if (strcmp(engines[i].name, config->engine) == 0) {
+            engine = &engines[i];
+        }
+    }
+    if (!engine) {
+        fprintf(stderr, "Unknown engine '%s' (available: compact, parallel, decide)\n", config->engine);
+        error(ERR_BAD_VALUE);
+    }
+
+    VERIFY verify;
+    memset(&verify, 0, sizeof(verify));
+    verify.config = config;
+    verify.engine = engine;
+    atomic_init(&verify.next, 0);
+    atomic_init(&verify.first_failure, UINT64_MAX);
+    atomic_init(&verify.scenarios, 0);
+    atomic_init(&verify.rounds, 0);
+    atomic_init(&verify.skipped, 0);
+
+    ROSTER roster = {0};
+    if (config->roster_path) {
+        FILE *file = fopen(config->roster_path, "r");
+        if (!file) {
+            error(ERR_FILE);
+        }
+        load_roster(file, &roster);
+        fclose(file);
+
+        verify.armies = roster.count;
+        verify.recorded = malloc(sizeof(ARMY) * (size_t) roster.count);
+        verify.fits = malloc(sizeof(bool) * (size_t) roster.count);
+        if (!verify.recorded || !verify.fits) {
+            error(ERR_MEMORY);
+        }
+        for (int i = 0; i < roster.count; i++) {
+            verify.fits[i] = expand_army(roster.armies[i], &verify.recorded[i]);
+        }
+        verify.total = matchup_count(roster.count);
+    } else {
+        build_loadouts(&verify);
+        verify.total = config->scenarios;
+    }
+
+    int threads = config->threads;
+    if (threads <= 0) {
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        if (threads <= 0) threads = 1;
+    }
+
+    if (!engine->round) {
+        printf("Checking early decisions against capped battles on %llu %s, %d threads\n",
+               (unsigned long long) verify.total, config->roster_path ? "matchups" : "generated scenarios", threads);
+    } else if (config->roster_path) {
+        printf("Verifying the %s engine against battle_round() on %llu matchups of %s, %d threads\n",
+               engine->name, (unsigned long long) verify.total, config->roster_path, threads);
+    } else {
+        printf("Verifying the %s engine against battle_round() on %llu generated scenarios (seed %llu), %d threads\n",
+               engine->name, (unsigned long long) verify.total, (unsigned long long) config->seed, threads);
+    }
+
+    VERIFIER *verifiers = calloc((size_t) threads, sizeof(VERIFIER));
+    if (!verifiers) {
+        error(ERR_MEMORY);
+    }
+    const double started = now_seconds();
+    for (int t = 0; t < threads; t++) {
+        verifiers[t].verify = &verify;
+        verifiers[t].context = engine->open ? engine->open() : NULL;
+        pthread_create(&verifiers[t].thread, NULL, verifier_main, &verifiers[t]);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(verifiers[t].thread, NULL);
+    }
+    const double elapsed = now_seconds() - started;
+
+    const uint64_t scenarios = atomic_load(&verify.scenarios);
+    printf("%llu scenarios, %llu rounds compared in %.3f s (%.2f million scenarios/min)",
+           (unsigned long long) scenarios, (unsigned long long) atomic_load(&verify.rounds), elapsed,
+           elapsed > 0 ? scenarios / elapsed * 60 / 1e6 : 0.0);
+    if (atomic_load(&verify.skipped) > 0) {
+        printf(", %llu skipped (armies of more than %d units)", (unsigned long long) atomic_load(&verify.skipped),
+               MAX_ARMY);
+    }
+    printf("\n");
+
+    const uint64_t failure = atomic_load(&verify.first_failure);
+    if (failure != UINT64_MAX) {
+        ARMY army1, army2;
+        load_scenario(&verify, failure, &army1, &army2);
+        printf("\nScenario %llu diverges\n", (unsigned long long) failure);
+        int fought;
+        check_scenario(&verify, verifiers[0].context, failure, &army1, &army2, &fought, stdout);
+        printf("\nScenario in roster format:\n");
+        print_roster_army(stdout, &army1, 1);
+        print_roster_army(stdout, &army2, 2);
+    } else {
+        printf("No divergence\n");
+    }
+
+    for (int t = 0; t < threads; t++) {
+        if (engine->close) {
+            engine->close(verifiers[t].context);
+        }
+    }
+    free(verifiers);
+    free(verify.recorded);
+    free(verify.fits);
+    if (config->roster_path) {
+        free_roster(&roster);
+    }
+    return failure != UINT64_MAX ? 1 : 0;
+}